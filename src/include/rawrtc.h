@@ -46,6 +46,7 @@ enum rawrtc_code {
     RAWRTC_CODE_TRY_AGAIN_LATER,
     RAWRTC_CODE_STOP_ITERATION,
     RAWRTC_CODE_NOT_PERMITTED,
+    RAWRTC_CODE_IO_ERROR,
 }; // IMPORTANT: Add translations for new return codes in `utils.c`!
 
 /*
@@ -53,7 +54,9 @@ enum rawrtc_code {
  */
 enum rawrtc_certificate_key_type {
     RAWRTC_CERTIFICATE_KEY_TYPE_RSA = TLS_KEYTYPE_RSA,
-    RAWRTC_CERTIFICATE_KEY_TYPE_EC = TLS_KEYTYPE_EC
+    RAWRTC_CERTIFICATE_KEY_TYPE_EC = TLS_KEYTYPE_EC,
+    RAWRTC_CERTIFICATE_KEY_TYPE_ED25519 = TLS_KEYTYPE_EC + 1,
+    RAWRTC_CERTIFICATE_KEY_TYPE_ED448 = TLS_KEYTYPE_EC + 2
 };
 
 /*
@@ -133,6 +136,14 @@ enum rawrtc_ice_role {
     RAWRTC_ICE_ROLE_CONTROLLED = ROLE_CONTROLLED
 };
 
+/*
+ * ICE nomination mode (controlling side only).
+ */
+enum rawrtc_ice_nomination {
+    RAWRTC_ICE_NOMINATION_AGGRESSIVE, // every check carries USE-CANDIDATE
+    RAWRTC_ICE_NOMINATION_REGULAR // nominate the best valid pair once all checks are done
+};
+
 /*
  * ICE transport state.
  */
@@ -291,6 +302,9 @@ enum rawrtc_ice_server_transport {
  */
 struct rawrtc_ice_server_url_context;
 struct rawrtc_ice_candidate;
+struct rawrtc_ice_gatherer_pool;
+struct rawrtc_tcp_framing;
+struct rawrtc_timer_wheel_timer;
 struct rawrtc_data_channel;
 struct rawrtc_dtls_transport;
 struct rawrtc_dtls_parameters;
@@ -331,6 +345,15 @@ typedef void (rawrtc_ice_gatherer_local_candidate_handler)(
     void* const arg
 );
 
+/*
+ * ICE gatherer interface change handler.
+ * Called when local interface addresses changed after gathering has
+ * been completed (e.g. to re-gather or to start an ICE restart).
+ */
+typedef void (rawrtc_ice_gatherer_interface_change_handler)(
+    void* const arg
+);
+
 /*
  * ICE transport state change handler.
  */
@@ -467,7 +490,6 @@ typedef enum rawrtc_code (rawrtc_data_transport_channel_send_handler)(
  * TODO: Add to a constructor... somewhere
  */
 struct rawrtc_config {
-    uint32_t pacing_interval;
     bool ipv4_enable;
     bool ipv6_enable;
     bool udp_enable;
@@ -507,10 +529,15 @@ struct rawrtc_certificate_options {
  * TODO: private
  */
 struct rawrtc_certificate {
-    struct le le;
+    struct le le; // used by the certificate pool only
     X509* certificate;
     EVP_PKEY* key;
     enum rawrtc_certificate_key_type key_type;
+    uint8_t* der; // certificate and private key
+    size_t der_length;
+    uint8_t fingerprints[RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA512 + 1][EVP_MAX_MD_SIZE];
+    size_t fingerprint_lengths[RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA512 + 1];
+    char* fingerprints_hex[RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA512 + 1];
 };
 
 /*
@@ -520,6 +547,20 @@ struct rawrtc_certificate {
 struct rawrtc_ice_gather_options {
     enum rawrtc_ice_gather_policy gather_policy;
     struct list ice_servers;
+    uint16_t udp_mux_port; // 0 if disabled
+    uint16_t udp_mux_shards; // 0 if SO_REUSEPORT is disabled
+    uint16_t udp_mux_shard;
+    bool ice_lite;
+};
+
+/*
+ * ICE transport options.
+ * TODO: private
+ */
+struct rawrtc_ice_transport_options {
+    uint32_t pacing_interval; // in milliseconds
+    enum rawrtc_ice_nomination nomination;
+    struct stun_conf stun_config; // connectivity check retransmissions
 };
 
 /*
@@ -540,25 +581,27 @@ struct rawrtc_ice_server {
  */
 struct rawrtc_ice_server_url {
     struct le le;
+    struct rawrtc_ice_server* server; // not referenced (owns the URL)
     char* url; // copied
     struct pl host; // points inside `url`
     enum rawrtc_ice_server_type type;
     enum rawrtc_ice_server_transport transport;
     struct sa ipv4_address;
-    struct rawrtc_ice_server_url_dns_context* dns_a_context;
     struct sa ipv6_address;
-    struct rawrtc_ice_server_url_dns_context* dns_aaaa_context;
 };
 
 /*
- * ICE server URL DNS resolve context.
+ * ICE server URL DNS resolve context. (list element)
+ * Pending DNS queries are tracked per gatherer as the URLs are shared
+ * by all gatherers using the same options.
  * TODO: private -> ice_gatherer.h
  */
 struct rawrtc_ice_server_url_dns_context {
+    struct le le;
     uint_fast16_t dns_type;
     struct rawrtc_ice_server_url* url;
     struct rawrtc_ice_gatherer* gatherer;
-    struct dns_query* dns_query;
+    struct rawrtc_dns_cache_request* dns_request;
 };
 
 /*
@@ -600,6 +643,34 @@ struct rawrtc_ice_parameters {
     bool ice_lite;
 };
 
+/*
+ * Received packet counters (classified by the first byte, RFC 7983).
+ */
+struct rawrtc_packet_counters {
+    uint64_t stun;
+    uint64_t dtls;
+    uint64_t rtp;
+    uint64_t turn_channel;
+    uint64_t dropped;
+    uint64_t misclassified;
+};
+
+/*
+ * Connection setup timeline.
+ * Timestamps are in milliseconds (see `tmr_jiffies`) and zero if the
+ * event did not happen, yet.
+ */
+struct rawrtc_setup_timeline {
+    uint64_t gathering_started;
+    uint64_t first_local_candidate;
+    uint64_t checks_started; // ICE lite: first binding request received
+    uint64_t nominated;
+    uint64_t dtls_client_hello; // sent (client) or received (server)
+    uint64_t dtls_connected;
+    uint64_t sctp_established;
+    uint64_t first_data_channel_open;
+};
+
 /*
  * ICE gatherer.
  * TODO: private
@@ -612,12 +683,21 @@ struct rawrtc_ice_gatherer {
     rawrtc_ice_gatherer_local_candidate_handler* local_candidate_handler; // nullable
     void* arg; // nullable
     struct list buffered_messages; // TODO: Can this be added to the candidates list?
-    struct list local_candidates; // TODO: Hash list instead?
+    struct list local_candidates;
+    struct hash* local_candidates_by_re_candidate; // not referenced
+    struct hash* re_candidates_by_attributes; // type, component id, protocol, address, base
     char ice_username_fragment[9];
     char ice_password[33];
     struct trice* ice;
+    struct trice* previous_ice; // nullable, kept during an ICE restart
+    struct list previous_local_candidates; // kept during an ICE restart
+    struct list dns_contexts; // pending ICE server URL DNS queries
     struct trice_conf ice_config;
-    struct dnsc* dns_client;
+    struct rawrtc_packet_counters packet_counters;
+    struct rawrtc_ice_transport* lite_transport; // not referenced, nullable
+    struct rawrtc_interface_cache_listener* interface_listener; // nullable
+    rawrtc_ice_gatherer_interface_change_handler* interface_change_handler; // nullable
+    struct rawrtc_setup_timeline timeline; // gathering events only
 };
 
 /*
@@ -632,6 +712,17 @@ struct rawrtc_ice_transport {
     void* arg; // nullable
     struct rawrtc_ice_parameters* remote_parameters; // referenced
     struct rawrtc_dtls_transport* dtls_transport; // referenced, nullable
+    struct list lite_candidate_pairs; // ICE lite only, selected candidate pair first
+    struct tmr lite_timer;
+    struct rawrtc_ice_transport_options* options; // referenced, nullable
+    bool nomination_sent; // regular nomination only
+    struct rawrtc_timer_wheel_timer* consent_timer; // consent freshness (RFC 7675)
+    struct rawrtc_setup_timeline timeline; // gathering events are in the gatherer's timeline
+    char local_username_fragment[9]; // of the last start, detects a restarted gatherer
+    struct ice_candpair* selected_candidate_pair; // referenced, nullable, not used if ICE lite
+    struct ice_candpair* nominating_candidate_pair; // referenced, nullable, re-nomination
+    uint64_t selection_time; // in milliseconds
+    struct list candidate_pair_rtts; // RTT and consent of valid candidate pairs
 };
 
 /*
@@ -642,6 +733,8 @@ struct rawrtc_dtls_fingerprint {
     struct le le;
     enum rawrtc_certificate_sign_algorithm algorithm;
     char* value; // copied
+    uint8_t value_binary[EVP_MAX_MD_SIZE];
+    size_t value_binary_length; // 0 if invalid or unsupported
 };
 
 /*
@@ -660,7 +753,8 @@ struct rawrtc_dtls_parameters {
 struct rawrtc_dtls_transport {
     enum rawrtc_dtls_transport_state state;
     struct rawrtc_ice_transport* ice_transport; // referenced
-    struct list certificates; // deep-copied
+    struct rawrtc_certificate** certificates; // referenced (each item)
+    size_t n_certificates;
     rawrtc_dtls_transport_state_change_handler* state_change_handler; // nullable
     rawrtc_dtls_transport_error_handler* error_handler; // nullable
     void* arg; // nullable
@@ -670,9 +764,12 @@ struct rawrtc_dtls_transport {
     struct list buffered_messages_in;
     struct list buffered_messages_out;
     struct list fingerprints;
-    struct tls* context;
+    struct rawrtc_dtls_context* context; // referenced
     struct dtls_sock* socket;
     struct tls_conn* connection;
+    struct udp_sock* route_socket; // referenced, nullable
+    struct rawrtc_tcp_framing* route_framing; // referenced, nullable
+    struct sa route_address;
     rawrtc_dtls_transport_receive_handler* receive_handler;
     void* receive_handler_arg;
 };
@@ -794,7 +891,9 @@ enum {
     RAWRTC_LAYER_DTLS_SRTP_STUN = 10, // TODO: Pretty sure we are able to detect STUN earlier
     RAWRTC_LAYER_ICE = 0,
     RAWRTC_LAYER_STUN = -10,
-    RAWRTC_LAYER_TURN = -10
+    RAWRTC_LAYER_TURN = -10,
+    RAWRTC_LAYER_CLASSIFIER = -20,
+    RAWRTC_LAYER_UDP_MUX = -30
 };
 
 
@@ -858,15 +957,70 @@ enum rawrtc_code rawrtc_certificate_options_create(
  *
  * Sane and safe default options will be applied if `options` is
  * `NULL`.
+ *
+ * A pre-generated certificate will be used if the certificate pool
+ * has been started with equivalent options and is not exhausted.
  */
 enum rawrtc_code rawrtc_certificate_generate(
     struct rawrtc_certificate** const certificatep,
     struct rawrtc_certificate_options* options // nullable
 );
 
+/*
+ * Start pre-generating certificates on a worker thread.
+ */
+enum rawrtc_code rawrtc_certificate_pool_start(
+    struct rawrtc_certificate_options* const options, // nullable, referenced
+    size_t const size
+);
+
+/*
+ * Stop the certificate pool and free pre-generated certificates.
+ */
+enum rawrtc_code rawrtc_certificate_pool_stop();
+
+/*
+ * Create a certificate from PEM encoded data containing both the
+ * certificate and the private key.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_from_pem(
+    struct rawrtc_certificate** const certificatep, // de-referenced
+    char const* const pem,
+    size_t const pem_length
+);
+
+/*
+ * Create a certificate from DER encoded data containing the
+ * certificate followed by the private key.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_from_der(
+    struct rawrtc_certificate** const certificatep, // de-referenced
+    uint8_t const* const der,
+    size_t const der_length
+);
+
+/*
+ * Load a certificate from a PEM file or generate a new certificate
+ * and store it in that file.
+ *
+ * A new certificate will be generated if the file does not exist,
+ * cannot be parsed, the key type does not match the options or if
+ * the stored certificate expires within a day.
+ *
+ * Sane and safe default options will be applied if `options` is
+ * `NULL`.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_load_or_generate(
+    struct rawrtc_certificate** const certificatep, // de-referenced
+    char const* const path,
+    struct rawrtc_certificate_options* options // nullable
+);
+
 /*
  * TODO http://draft.ortc.org/#dom-rtccertificate
- * rawrtc_certificate_from_bytes
  * rawrtc_certificate_get_expires
  * rawrtc_certificate_get_fingerprint
  * rawrtc_certificate_get_algorithm
@@ -1030,6 +1184,53 @@ enum rawrtc_code rawrtc_ice_gather_options_add_server(
     enum rawrtc_ice_credential_type const credential_type
 );
 
+/*
+ * Let host candidates share one UDP socket per interface on a fixed
+ * port with other ICE gatherers using the same port.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_set_udp_mux_port(
+    struct rawrtc_ice_gather_options* const options,
+    uint16_t const port
+);
+
+/*
+ * Bind the UDP mux sockets with SO_REUSEPORT so that `n_shards`
+ * processes (each running its own event loop) can share the UDP mux
+ * port. `shard` is the index of the calling process' shard.
+ *
+ * If `n_shards` is greater than 1 (Linux only), the shard is encoded in
+ * the local username fragment so that incoming connectivity checks are
+ * steered to the shard owning the gatherer. Other packets are steered
+ * by remote address once the ICE agent checks it.
+ * Note: Shards must bind their UDP mux sockets in the order of their
+ *       index (before any traffic arrives) and keep them bound.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_set_udp_mux_shards(
+    struct rawrtc_ice_gather_options* const options,
+    uint16_t const n_shards,
+    uint16_t const shard
+);
+
+/*
+ * Run as an ICE lite agent (RFC 8445, section 2.5): Only host
+ * candidates will be gathered, `iceLite` will be advertised in the local
+ * ICE parameters and the ICE transport will only respond to connectivity
+ * checks.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_set_ice_lite(
+    struct rawrtc_ice_gather_options* const options,
+    bool const ice_lite
+);
+
+/*
+ * Resolve the ICE servers' hostnames ahead of gathering (e.g. at
+ * startup). Resolved addresses are being cached process-wide, so ICE
+ * gatherers do not have to wait for DNS queries.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_resolve_servers(
+    struct rawrtc_ice_gather_options* const options
+);
+
 /*
  * TODO (from RTCIceServer interface)
  * rawrtc_ice_server_set_username
@@ -1071,12 +1272,42 @@ enum rawrtc_code rawrtc_ice_gatherer_gather(
     struct rawrtc_ice_gather_options* const options // referenced, nullable
 );
 
+/*
+ * Restart the ICE gatherer (ICE restart, RFC 8445, section 9).
+ * A new username fragment and password will be generated and all local
+ * candidates will be gathered again. Hand the new local parameters and
+ * candidates to the remote peer and restart the ICE transport with the
+ * remote peer's new parameters by calling `rawrtc_ice_transport_start`
+ * again.
+ * The previous local candidates are being kept (and used for sending)
+ * until the restarted ICE transport selected a candidate pair.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_restart(
+    struct rawrtc_ice_gatherer* const gatherer
+);
+
 /*
  * TODO (from RTCIceGatherer interface)
  * rawrtc_ice_gatherer_get_component
  * rawrtc_ice_gatherer_get_state
  */
 
+/*
+ * Get the received packet counters of an ICE gatherer.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_get_packet_counters(
+    struct rawrtc_packet_counters* const countersp, // de-referenced
+    struct rawrtc_ice_gatherer* const gatherer
+);
+
+/*
+ * Set the ICE gatherer's interface change handler.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_set_interface_change_handler(
+    struct rawrtc_ice_gatherer* const gatherer,
+    rawrtc_ice_gatherer_interface_change_handler* const interface_change_handler // nullable
+);
+
 /*
  * Get local ICE parameters of an ICE gatherer.
  */
@@ -1101,6 +1332,27 @@ enum rawrtc_code rawrtc_ice_gatherer_get_local_candidates(
  * rawrtc_ice_gatherer_set_local_candidate_handler
  */
 
+/*
+ * Create a pool of pre-gathered ICE gatherers.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_pool_create(
+    struct rawrtc_ice_gatherer_pool** const poolp, // de-referenced
+    struct rawrtc_ice_gather_options* const options, // referenced
+    uint_fast16_t const size
+);
+
+/*
+ * Claim an ICE gatherer from the pool.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_pool_claim(
+    struct rawrtc_ice_gatherer** const gathererp, // de-referenced
+    struct rawrtc_ice_gatherer_pool* const pool,
+    rawrtc_ice_gatherer_state_change_handler* const state_change_handler, // nullable
+    rawrtc_ice_gatherer_error_handler* const error_handler, // nullable
+    rawrtc_ice_gatherer_local_candidate_handler* const local_candidate_handler, // nullable
+    void* const arg // nullable
+);
+
 /*
  * Get the corresponding name for an ICE transport state.
  */
@@ -1108,6 +1360,41 @@ char const * const rawrtc_ice_transport_state_to_name(
     enum rawrtc_ice_transport_state const state
 );
 
+/*
+ * Create new ICE transport options (using the default values).
+ */
+enum rawrtc_code rawrtc_ice_transport_options_create(
+    struct rawrtc_ice_transport_options** const optionsp // de-referenced
+);
+
+/*
+ * Set the interval between two connectivity checks.
+ */
+enum rawrtc_code rawrtc_ice_transport_options_set_pacing_interval(
+    struct rawrtc_ice_transport_options* const options,
+    uint32_t const pacing_interval // in milliseconds
+);
+
+/*
+ * Set the nomination mode.
+ */
+enum rawrtc_code rawrtc_ice_transport_options_set_nomination(
+    struct rawrtc_ice_transport_options* const options,
+    enum rawrtc_ice_nomination const nomination
+);
+
+/*
+ * Set the retransmission parameters of connectivity checks (RFC 5389,
+ * section 7.2.1).
+ */
+enum rawrtc_code rawrtc_ice_transport_options_set_check_retransmission(
+    struct rawrtc_ice_transport_options* const options,
+    uint32_t const rto, // in milliseconds
+    uint32_t const rc,
+    uint32_t const rm,
+    uint32_t const ti // in milliseconds
+);
+
 /*
  * Create a new ICE transport.
  */
@@ -1121,6 +1408,10 @@ enum rawrtc_code rawrtc_ice_transport_create(
 
 /*
  * Start the ICE transport.
+ * Calling this again with different remote parameters after the ICE
+ * gatherer has been restarted does an ICE restart. The DTLS and SCTP
+ * transports on top are being kept and migrate to the new selected
+ * candidate pair.
  */
 enum rawrtc_code rawrtc_ice_transport_start(
     struct rawrtc_ice_transport* const transport,
@@ -1149,6 +1440,24 @@ enum rawrtc_code rawrtc_ice_transport_get_role(
     struct rawrtc_ice_transport* const transport
 );
 
+/*
+ * Set the ICE transport's options. Must be called before the ICE
+ * transport has been started.
+ */
+enum rawrtc_code rawrtc_ice_transport_set_options(
+    struct rawrtc_ice_transport* const transport,
+    struct rawrtc_ice_transport_options* const options // referenced
+);
+
+/*
+ * Get the connection setup timeline of an ICE transport (including the
+ * DTLS and SCTP transports on top of it).
+ */
+enum rawrtc_code rawrtc_ice_transport_get_setup_timeline(
+    struct rawrtc_setup_timeline* const timelinep, // de-referenced
+    struct rawrtc_ice_transport* const transport
+);
+
 /*
  * TODO
  * rawrtc_ice_transport_get_component
@@ -1256,7 +1565,7 @@ char const * const rawrtc_dtls_transport_state_to_name(
 enum rawrtc_code rawrtc_dtls_transport_create(
     struct rawrtc_dtls_transport** const transportp, // de-referenced
     struct rawrtc_ice_transport* const ice_transport, // referenced
-    struct rawrtc_certificate* const certificates[], // copied (each item)
+    struct rawrtc_certificate* const certificates[], // referenced (each item)
     size_t const n_certificates,
     rawrtc_dtls_transport_state_change_handler* const state_change_handler, // nullable
     rawrtc_dtls_transport_error_handler* const error_handler, // nullable
@@ -1278,6 +1587,25 @@ enum rawrtc_code rawrtc_dtls_transport_stop(
     struct rawrtc_dtls_transport* const transport
 );
 
+/*
+ * Set the cipher suites (OpenSSL names, in order of preference) to be
+ * used by the DTLS transport. Must be called before the transport is
+ * being started.
+ */
+enum rawrtc_code rawrtc_dtls_transport_set_cipher_suites(
+    struct rawrtc_dtls_transport* const transport,
+    char const* cipher_suites[], // copied
+    size_t const n_cipher_suites
+);
+
+/*
+ * Get the amount of resumed (hits) and full (misses) DTLS handshakes.
+ */
+enum rawrtc_code rawrtc_dtls_session_cache_get_counters(
+    uint64_t* const hitsp, // de-referenced
+    uint64_t* const missesp // de-referenced
+);
+
 /*
  * TODO (from RTCIceTransport interface)
  * rawrtc_certificate_list_*
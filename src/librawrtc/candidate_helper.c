@@ -1,5 +1,164 @@
 #include <rawrtc.h>
 #include "candidate_helper.h"
+#include "ice_transport.h"
+#include "udp_mux.h"
+
+/*
+ * Packet classes (RFC 7983, section 7).
+ */
+enum packet_class {
+    PACKET_CLASS_UNKNOWN = 0,
+    PACKET_CLASS_STUN,
+    PACKET_CLASS_DTLS,
+    PACKET_CLASS_TURN_CHANNEL,
+    PACKET_CLASS_RTP,
+};
+
+/*
+ * Packet class by first byte (RFC 7983, section 7).
+ */
+static uint8_t const packet_classes[256] = {
+    [0 ... 3] = PACKET_CLASS_STUN,
+    [20 ... 63] = PACKET_CLASS_DTLS,
+    [64 ... 79] = PACKET_CLASS_TURN_CHANNEL,
+    [128 ... 191] = PACKET_CLASS_RTP,
+};
+
+/*
+ * Classify a packet by its first byte.
+ */
+static inline enum packet_class classify_packet(
+        struct mbuf* const buffer
+) {
+    if (mbuf_get_left(buffer) < 1) {
+        return PACKET_CLASS_UNKNOWN;
+    }
+    return (enum packet_class) packet_classes[mbuf_buf(buffer)[0]];
+}
+
+/*
+ * Inspect a received STUN message before it is being handed to the
+ * ICE agent. Used by the classifier and by the UDP mux.
+ */
+void rawrtc_candidate_helper_inspect_stun(
+        struct rawrtc_candidate_helper* const candidate_helper,
+        struct sa* const source,
+        struct mbuf* const buffer
+) {
+    struct rawrtc_ice_gatherer* const gatherer = candidate_helper->gatherer;
+
+    // Look for nominations (if ICE lite)
+    // Note: An ICE lite agent does not send checks, so the UDP mux learns the (authenticated)
+    //       remote address from the nomination.
+    if (gatherer->lite_transport && rawrtc_ice_transport_lite_receive(
+            gatherer->lite_transport, candidate_helper->candidate, source, buffer)) {
+        rawrtc_udp_mux_learn_route(candidate_helper->udp_mux_entry, source);
+    }
+}
+
+/*
+ * Classify received packets before any other UDP helper is being
+ * called. DTLS packets are dispatched directly to the candidate
+ * helper's receive handler, STUN and TURN packets continue through the
+ * helper chain (ICE, STUN and TURN), everything else is dropped.
+ */
+static bool classifier_receive_handler(
+        struct sa* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_candidate_helper* const candidate_helper = arg;
+    struct rawrtc_ice_gatherer* const gatherer = candidate_helper->gatherer;
+    struct rawrtc_packet_counters* const counters = &gatherer->packet_counters;
+
+    switch (classify_packet(buffer)) {
+        case PACKET_CLASS_DTLS:
+            ++counters->dtls;
+            if (!candidate_helper->receive_handler) {
+                ++counters->dropped;
+                return true;
+            }
+            return candidate_helper->receive_handler(
+                    source, buffer, candidate_helper->receive_handler_arg);
+        case PACKET_CLASS_STUN:
+            ++counters->stun;
+            rawrtc_candidate_helper_inspect_stun(candidate_helper, source, buffer);
+            return false; // continue with ICE, STUN and TURN helpers
+        case PACKET_CLASS_TURN_CHANNEL:
+            ++counters->turn_channel;
+            return false; // continue with TURN helpers
+        case PACKET_CLASS_RTP:
+            // TODO: Dispatch to SRTP once supported
+            ++counters->rtp;
+            ++counters->dropped;
+            return true;
+        default:
+            ++counters->dropped;
+            return true;
+    }
+}
+
+/*
+ * Receive a packet demultiplexed by a UDP mux.
+ */
+bool rawrtc_candidate_helper_receive(
+        struct rawrtc_candidate_helper* const candidate_helper,
+        struct sa* const source,
+        struct mbuf* const buffer
+) {
+    return classifier_receive_handler(source, buffer, candidate_helper);
+}
+
+/*
+ * Handle packets that passed through the helper chain (e.g. unwrapped
+ * by a TURN helper).
+ */
+static bool udp_receive_handler(
+        struct sa* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_candidate_helper* const candidate_helper = arg;
+
+    // Anything other than DTLS should have been consumed by other helpers
+    if (classify_packet(buffer) != PACKET_CLASS_DTLS) {
+        ++candidate_helper->gatherer->packet_counters.misclassified;
+        ++candidate_helper->gatherer->packet_counters.dropped;
+        return true;
+    }
+
+    // No receive handler?
+    if (!candidate_helper->receive_handler) {
+        ++candidate_helper->gatherer->packet_counters.dropped;
+        return true;
+    }
+
+    // Receive
+    return candidate_helper->receive_handler(
+            source, buffer, candidate_helper->receive_handler_arg);
+}
+
+/*
+ * Handle frames the ICE agent received on an ICE-TCP connection that
+ * has no framing attached yet (e.g. DTLS records of a peer whose
+ * checks succeeded first). They pass through the classifier, so they
+ * are being buffered until a transport attaches, like on UDP.
+ */
+static bool tcp_frame_receive_handler(
+        struct ice_lcand* candidate,
+        int protocol,
+        void* socket,
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_candidate_helper* const candidate_helper = arg;
+    struct sa peer_address;
+    (void) candidate; (void) protocol; (void) socket;
+
+    sa_cpy(&peer_address, source);
+    return classifier_receive_handler(&peer_address, buffer, candidate_helper);
+}
 
 /*
  * Destructor for an existing candidate helper.
@@ -9,9 +168,22 @@ static void rawrtc_candidate_helper_destroy(
 ) {
     struct rawrtc_candidate_helper* const local_candidate = arg;
 
+    // Detach TCP frame handler
+    if (local_candidate->candidate && local_candidate->candidate->arg == local_candidate) {
+        local_candidate->candidate->recvh = NULL;
+        local_candidate->candidate->arg = NULL;
+    }
+
+    // Remove from lookup table
+    hash_unlink(&local_candidate->lookup_le);
+
     // Un-reference
+    list_flush(&local_candidate->tcp_framings);
+    list_flush(&local_candidate->turn_sessions);
     list_flush(&local_candidate->stun_sessions);
     mem_deref(local_candidate->udp_helper);
+    mem_deref(local_candidate->classifier_helper);
+    mem_deref(local_candidate->udp_mux_entry);
     mem_deref(local_candidate->candidate);
     mem_deref(local_candidate->gatherer);
 }
@@ -46,8 +218,43 @@ enum rawrtc_code rawrtc_candidate_helper_create(
     candidate_helper->srflx_pending_count = 0;
     candidate_helper->relay_pending_count = 0;
 
-    // Set receive handler
-    error = rawrtc_candidate_helper_set_receive_handler(candidate_helper, receive_handler, arg);
+    candidate_helper->receive_handler = receive_handler;
+    candidate_helper->receive_handler_arg = arg;
+
+    // TCP? Framing is being attached to each connection once it is in use. Until then, the ICE
+    // agent hands frames other than STUN to the frame handler.
+    if (candidate->attr.proto == IPPROTO_TCP) {
+        candidate->recvh = tcp_frame_receive_handler;
+        candidate->arg = candidate_helper;
+        error = RAWRTC_CODE_SUCCESS;
+        goto out;
+    }
+
+    // Get local candidate's UDP socket
+    struct udp_sock* const udp_socket = trice_lcand_sock(gatherer->ice, candidate);
+    if (!udp_socket) {
+        error = RAWRTC_CODE_NO_SOCKET;
+        goto out;
+    }
+
+    // Using a UDP mux? The mux dispatches to this helper, no UDP helpers required.
+    // Note: Relay candidates use their own socket and always need UDP helpers.
+    if (gatherer->options->udp_mux_port != 0 && candidate->attr.type == ICE_CAND_TYPE_HOST) {
+        error = RAWRTC_CODE_SUCCESS;
+        goto out;
+    }
+
+    // Create UDP helpers
+    // Note: The classifier is called first as helpers with a lower layer receive first.
+    error = rawrtc_error_to_code(udp_register_helper(
+            &candidate_helper->classifier_helper, udp_socket, RAWRTC_LAYER_CLASSIFIER, NULL,
+            classifier_receive_handler, candidate_helper));
+    if (error) {
+        goto out;
+    }
+    error = rawrtc_error_to_code(udp_register_helper(
+            &candidate_helper->udp_helper, udp_socket, RAWRTC_LAYER_DTLS_SRTP_STUN, NULL,
+            udp_receive_handler, candidate_helper));
     if (error) {
         goto out;
     }
@@ -70,37 +277,99 @@ enum rawrtc_code rawrtc_candidate_helper_set_receive_handler(
         udp_helper_recv_h* const receive_handler,
         void* const arg
 ) {
+    // Check arguments
+    if (!candidate_helper || !receive_handler) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Replace receive handler
+    // Note: The UDP helpers stay registered and call the current handler.
+    candidate_helper->receive_handler = receive_handler;
+    candidate_helper->receive_handler_arg = arg;
+
+    // Done
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Unset a candidate helper's receive handler. Received DTLS packets
+ * will be dropped.
+ */
+enum rawrtc_code rawrtc_candidate_helper_unset_receive_handler(
+        struct rawrtc_candidate_helper* const candidate_helper
+) {
+    // Check arguments
+    if (!candidate_helper) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Unset receive handler
+    candidate_helper->receive_handler = NULL;
+    candidate_helper->receive_handler_arg = NULL;
+
+    // Done
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Get the framing of an ICE-TCP connection of a candidate helper
+ * (attaches framing to the connection if not attached yet).
+ * Received frames pass through the candidate helper's classifier.
+ */
+enum rawrtc_code rawrtc_candidate_helper_get_tcp_framing(
+        struct rawrtc_tcp_framing** const framingp, // de-referenced
+        struct rawrtc_candidate_helper* const candidate_helper,
+        struct tcp_conn* const connection
+) {
+    struct le* le;
+    struct rawrtc_tcp_framing* framing;
     enum rawrtc_code error;
-    struct udp_helper* udp_helper;
 
     // Check arguments
-    if (!candidate_helper || !receive_handler) {
+    if (!framingp || !candidate_helper || !connection) {
         return RAWRTC_CODE_INVALID_ARGUMENT;
     }
 
-    // Get local candidate's UDP socket
-    struct udp_sock* const udp_socket = trice_lcand_sock(
-            candidate_helper->gatherer->ice, candidate_helper->candidate);
-    if (!udp_socket) {
-        return RAWRTC_CODE_NO_SOCKET;
+    // Already attached?
+    for (le = list_head(&candidate_helper->tcp_framings); le != NULL; le = le->next) {
+        framing = le->data;
+        if (framing->connection == connection) {
+            *framingp = framing;
+            return RAWRTC_CODE_SUCCESS;
+        }
     }
 
-    // Create UDP helper
-    error = rawrtc_error_to_code(udp_register_helper(
-            &udp_helper, udp_socket, RAWRTC_LAYER_DTLS_SRTP_STUN, NULL,
-            receive_handler, arg));
+    // Attach framing
+    error = rawrtc_tcp_framing_create(
+            &framing, connection, classifier_receive_handler, candidate_helper);
     if (error) {
         return error;
     }
 
-    // Unset current helper (if any) and set new helper
-    mem_deref(candidate_helper->udp_helper);
-    candidate_helper->udp_helper = udp_helper;
+    // Add to list, set pointer & done
+    list_append(&candidate_helper->tcp_framings, &framing->le, framing);
+    *framingp = framing;
+    return RAWRTC_CODE_SUCCESS;
+}
 
-    // TODO: What about TCP helpers?
+/*
+ * Get the lookup key of a candidate helper by re candidate.
+ */
+uint32_t rawrtc_candidate_helper_key(
+        struct ice_lcand const* const re_candidate
+) {
+    return hash_joaat((uint8_t const*) &re_candidate, sizeof(re_candidate));
+}
 
-    // Done
-    return RAWRTC_CODE_SUCCESS;
+/*
+ * Candidate helper lookup handler (by re candidate).
+ */
+static bool candidate_helper_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_candidate_helper* const candidate_helper = le->data;
+    return candidate_helper->candidate == arg;
 }
 
 /*
@@ -108,10 +377,10 @@ enum rawrtc_code rawrtc_candidate_helper_set_receive_handler(
  */
 enum rawrtc_code rawrtc_candidate_helper_find(
         struct rawrtc_candidate_helper** const candidate_helperp,
-        struct list* const candidate_helpers,
+        struct hash* const candidate_helpers,
         struct ice_lcand* re_candidate
 ) {
-    struct le* le;
+    struct rawrtc_candidate_helper* candidate_helper;
 
     // Check arguments
     if (!candidate_helperp || !candidate_helpers || !re_candidate) {
@@ -119,17 +388,16 @@ enum rawrtc_code rawrtc_candidate_helper_find(
     }
 
     // Lookup candidate helper
-    for (le = list_head(candidate_helpers); le != NULL; le = le->next) {
-        struct rawrtc_candidate_helper* const candidate_helper = le->data;
-        if (candidate_helper->candidate == re_candidate) {
-            // Found
-            *candidate_helperp = candidate_helper;
-            return RAWRTC_CODE_SUCCESS;
-        }
+    candidate_helper = list_ledata(hash_lookup(
+            candidate_helpers, rawrtc_candidate_helper_key(re_candidate),
+            candidate_helper_lookup_handler, re_candidate));
+    if (!candidate_helper) {
+        return RAWRTC_CODE_NO_VALUE;
     }
 
-    // Not found
-    return RAWRTC_CODE_NO_VALUE;
+    // Found
+    *candidate_helperp = candidate_helper;
+    return RAWRTC_CODE_SUCCESS;
 }
 
 static void rawrtc_candidate_helper_stun_session_destroy(
@@ -137,8 +405,9 @@ static void rawrtc_candidate_helper_stun_session_destroy(
 ) {
     struct rawrtc_candidate_helper_stun_session* const session = arg;
 
-    // Remove from list
+    // Remove from list & stop keep-alives
     list_unlink(&session->le);
+    rawrtc_timer_wheel_cancel(&session->keepalive_timer);
 
     // Un-reference
     mem_deref(session->url);
@@ -198,17 +467,91 @@ enum rawrtc_code rawrtc_candidate_helper_stun_session_add(
     return RAWRTC_CODE_SUCCESS;
 }
 
+static void rawrtc_candidate_helper_turn_session_destroy(
+        void* arg
+) {
+    struct rawrtc_candidate_helper_turn_session* const session = arg;
+
+    // Remove from list
+    list_unlink(&session->le);
+
+    // Un-reference
+    // Note: The TURN client needs to be removed before its socket.
+    mem_deref(session->turn_client);
+    mem_deref(session->socket);
+    mem_deref(session->url);
+    mem_deref(session->candidate_helper);
+}
+
+/*
+ * Create a TURN session.
+ */
+enum rawrtc_code rawrtc_candidate_helper_turn_session_create(
+        struct rawrtc_candidate_helper_turn_session** const sessionp, // de-referenced
+        struct rawrtc_ice_server_url* const url
+) {
+    struct rawrtc_candidate_helper_turn_session* session;
+
+    // Check arguments
+    if (!sessionp || !url) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    session = mem_zalloc(sizeof(*session), rawrtc_candidate_helper_turn_session_destroy);
+    if (!session) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/reference
+    session->url = mem_ref(url);
+    sa_init(&session->relay_address, AF_UNSPEC);
+    session->pending = true;
+
+    // Set pointer & done
+    *sessionp = session;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Add a TURN session to a candidate helper.
+ */
+enum rawrtc_code rawrtc_candidate_helper_turn_session_add(
+        struct rawrtc_candidate_helper_turn_session* const session,
+        struct rawrtc_candidate_helper* const candidate_helper,
+        struct udp_sock* const socket,
+        struct turnc* const turn_client
+) {
+    // Check arguments
+    if (!session || !candidate_helper || !socket || !turn_client) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set fields/reference
+    session->candidate_helper = mem_ref(candidate_helper);
+    session->socket = mem_ref(socket);
+    session->turn_client = mem_ref(turn_client);
+
+    // Append to TURN sessions
+    list_append(&candidate_helper->turn_sessions, &session->le, session);
+
+    // Done
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
- * Remove STUN sessions list handler (for candidate helper lists).
+ * Remove STUN and TURN sessions list handler (for candidate helper
+ * lists).
  */
-bool rawrtc_candidate_helper_remove_stun_sessions_handler(
+bool rawrtc_candidate_helper_remove_sessions_handler(
         struct le* le,
         void* arg
 ) {
     struct rawrtc_candidate_helper* const candidate_helper = le->data;
     (void) arg;
 
-    // Flush STUN sessions
+    // Flush TURN and STUN sessions
+    list_flush(&candidate_helper->turn_sessions);
     list_flush(&candidate_helper->stun_sessions);
 
     return false; // continue traversing
@@ -1,13 +1,37 @@
 #pragma once
+#include "timer_wheel.h"
+#include "tcp_framing.h"
 
 /*
  * STUN keep-alive session.
+ * Note: Once the server reflexive address is known, keep-alives are
+ *       being sent from the timer wheel. Every nth keep-alive is a
+ *       binding request, the others are binding indications.
  */
 struct rawrtc_candidate_helper_stun_session {
     struct le le;
     struct rawrtc_candidate_helper* candidate_helper;
     struct stun_keepalive* stun_keepalive;
     struct rawrtc_ice_server_url* url;
+    struct sa server_address;
+    struct rawrtc_timer_wheel_timer keepalive_timer;
+    uint_fast16_t n_keepalives;
+    bool mapped; // server reflexive address known
+};
+
+/*
+ * TURN allocation session.
+ * Note: Each allocation uses its own UDP socket bound to the host
+ *       candidate's interface which becomes the relay candidate's socket.
+ */
+struct rawrtc_candidate_helper_turn_session {
+    struct le le;
+    struct rawrtc_candidate_helper* candidate_helper;
+    struct rawrtc_ice_server_url* url;
+    struct udp_sock* socket;
+    struct turnc* turn_client;
+    struct sa relay_address; // unset until allocated
+    bool pending;
 };
 
 /*
@@ -15,12 +39,19 @@ struct rawrtc_candidate_helper_stun_session {
  */
 struct rawrtc_candidate_helper {
     struct le le;
+    struct le lookup_le;
     struct rawrtc_ice_gatherer* gatherer;
     struct ice_lcand* candidate;
+    struct udp_helper* classifier_helper;
     struct udp_helper* udp_helper;
+    udp_helper_recv_h* receive_handler; // nullable
+    void* receive_handler_arg; // nullable
     uint_fast8_t srflx_pending_count;
     struct list stun_sessions;
     uint_fast8_t relay_pending_count;
+    struct list turn_sessions;
+    struct list tcp_framings; // ICE-TCP connections
+    struct rawrtc_udp_mux_entry* udp_mux_entry; // referenced, nullable
 };
 
 enum rawrtc_code rawrtc_candidate_helper_create(
@@ -37,9 +68,35 @@ enum rawrtc_code rawrtc_candidate_helper_set_receive_handler(
     void* const arg
 );
 
+bool rawrtc_candidate_helper_receive(
+    struct rawrtc_candidate_helper* const candidate_helper,
+    struct sa* const source,
+    struct mbuf* const buffer
+);
+
+void rawrtc_candidate_helper_inspect_stun(
+    struct rawrtc_candidate_helper* const candidate_helper,
+    struct sa* const source,
+    struct mbuf* const buffer
+);
+
+enum rawrtc_code rawrtc_candidate_helper_unset_receive_handler(
+    struct rawrtc_candidate_helper* const candidate_helper
+);
+
+enum rawrtc_code rawrtc_candidate_helper_get_tcp_framing(
+    struct rawrtc_tcp_framing** const framingp, // de-referenced
+    struct rawrtc_candidate_helper* const candidate_helper,
+    struct tcp_conn* const connection
+);
+
+uint32_t rawrtc_candidate_helper_key(
+    struct ice_lcand const* const re_candidate
+);
+
 enum rawrtc_code rawrtc_candidate_helper_find(
     struct rawrtc_candidate_helper** const candidate_helperp,
-    struct list* const candidate_helpers,
+    struct hash* const candidate_helpers,
     struct ice_lcand* re_candidate
 );
 
@@ -54,7 +111,19 @@ enum rawrtc_code rawrtc_candidate_helper_stun_session_add(
     struct stun_keepalive* const stun_keepalive
 );
 
-bool rawrtc_candidate_helper_remove_stun_sessions_handler(
+enum rawrtc_code rawrtc_candidate_helper_turn_session_create(
+    struct rawrtc_candidate_helper_turn_session** const sessionp, // de-referenced
+    struct rawrtc_ice_server_url* const url
+);
+
+enum rawrtc_code rawrtc_candidate_helper_turn_session_add(
+    struct rawrtc_candidate_helper_turn_session* const session,
+    struct rawrtc_candidate_helper* const candidate_helper,
+    struct udp_sock* const socket,
+    struct turnc* const turn_client
+);
+
+bool rawrtc_candidate_helper_remove_sessions_handler(
     struct le* le,
     void* arg
 );
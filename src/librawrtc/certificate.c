@@ -12,8 +12,15 @@
 #include <openssl/pem.h>
 #include <string.h>
 #include <limits.h>
+#include <stdio.h> // fopen, ...
+#include <errno.h> // errno
+#include <fcntl.h> // open
+#include <unistd.h> // write, close, unlink
+#include <sys/stat.h> // S_IRUSR, S_IWUSR
+#include <time.h> // time
 #include <rawrtc.h>
 #include "certificate.h"
+#include "certificate_pool.h"
 #include "utils.h"
 
 #define DEBUG_MODULE "certificate"
@@ -184,6 +191,87 @@ out:
     return error;
 }
 
+/*
+ * Generates an EdDSA (Ed25519 or Ed448) key pair.
+ * Caller must call `EVP_PKEY_free(*keyp)` when done.
+ */
+static enum rawrtc_code generate_key_eddsa(
+        EVP_PKEY** const keyp, // de-referenced
+        enum rawrtc_certificate_key_type const key_type
+) {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    enum rawrtc_code error = RAWRTC_CODE_UNKNOWN_ERROR;
+    EVP_PKEY* key = NULL;
+    EVP_PKEY_CTX* context = NULL;
+    int id;
+
+    // Check arguments
+    if (!keyp) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Get key type ID
+    switch (key_type) {
+        case RAWRTC_CERTIFICATE_KEY_TYPE_ED25519:
+            id = EVP_PKEY_ED25519;
+            break;
+        case RAWRTC_CERTIFICATE_KEY_TYPE_ED448:
+            id = EVP_PKEY_ED448;
+            break;
+        default:
+            return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Create key generation context
+    context = EVP_PKEY_CTX_new_id(id, NULL);
+    if (!context) {
+        DEBUG_WARNING("Could not create EVP_PKEY_CTX structure\n");
+        goto out;
+    }
+
+    // Generate the EdDSA key pair
+    if (EVP_PKEY_keygen_init(context) <= 0 || EVP_PKEY_keygen(context, &key) <= 0) {
+        DEBUG_WARNING("Could not generate EdDSA key pair\n");
+        goto out;
+    }
+
+    // Done
+    error = RAWRTC_CODE_SUCCESS;
+
+out:
+    if (context) {
+        EVP_PKEY_CTX_free(context);
+    }
+    if (error) {
+        if (key) {
+            EVP_PKEY_free(key);
+        }
+        ERR_print_errors_cb(print_openssl_error, NULL);
+    } else {
+        *keyp = key;
+    }
+    return error;
+#else
+    (void) keyp; (void) key_type;
+    return RAWRTC_CODE_UNSUPPORTED_ALGORITHM;
+#endif
+}
+
+/*
+ * Check whether a key is an EdDSA key.
+ */
+static bool is_eddsa_key(
+        EVP_PKEY* const key
+) {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    int const id = EVP_PKEY_base_id(key);
+    return id == EVP_PKEY_ED25519 || id == EVP_PKEY_ED448;
+#else
+    (void) key;
+    return false;
+#endif
+}
+
 /*
  * Generates a self-signed certificate.
  * Caller must call `X509_free(*certificatep)` when done.
@@ -272,7 +360,8 @@ static enum rawrtc_code generate_self_signed_certificate(
     }
 
     // Sign the certificate
-    if (!X509_sign(certificate, key, sign_function)) {
+    // Note: EdDSA has a built-in hash function and requires no digest to be provided
+    if (!X509_sign(certificate, key, is_eddsa_key(key) ? NULL : sign_function)) {
         DEBUG_WARNING("Could not sign the certificate\n");
         goto out;
     }
@@ -385,6 +474,13 @@ enum rawrtc_code rawrtc_certificate_options_create(
 
             break;
 
+        case RAWRTC_CERTIFICATE_KEY_TYPE_ED25519:
+        case RAWRTC_CERTIFICATE_KEY_TYPE_ED448:
+            // Unset RSA and ECC vars
+            named_curve = NULL;
+            modulus_length = 0;
+            break;
+
         default:
             return RAWRTC_CODE_INVALID_STATE;
     }
@@ -431,6 +527,14 @@ static void rawrtc_certificate_destroy(
 ) {
     struct rawrtc_certificate* const certificate = arg;
 
+    size_t i;
+
+    // Un-reference
+    for (i = 0; i < ARRAY_SIZE(certificate->fingerprints_hex); ++i) {
+        mem_deref(certificate->fingerprints_hex[i]);
+    }
+    mem_deref(certificate->der);
+
     // Free
     if (certificate->certificate) {
         X509_free(certificate->certificate);
@@ -440,13 +544,18 @@ static void rawrtc_certificate_destroy(
     }
 }
 
+static enum rawrtc_code cache_encodings(
+        struct rawrtc_certificate* const certificate
+);
+
 /*
- * Create and generate a self-signed certificate.
+ * Create and generate a self-signed certificate on the calling thread
+ * (bypasses the certificate pool).
  *
  * Sane and safe default options will be applied if `options` is
  * `NULL`.
  */
-enum rawrtc_code rawrtc_certificate_generate(
+enum rawrtc_code rawrtc_certificate_generate_sync(
         struct rawrtc_certificate** const certificatep,
         struct rawrtc_certificate_options* options // nullable
 ) {
@@ -477,8 +586,13 @@ enum rawrtc_code rawrtc_certificate_generate(
         case RAWRTC_CERTIFICATE_KEY_TYPE_EC:
             error = generate_key_ecc(&certificate->key, options->named_curve);
             break;
+        case RAWRTC_CERTIFICATE_KEY_TYPE_ED25519:
+        case RAWRTC_CERTIFICATE_KEY_TYPE_ED448:
+            error = generate_key_eddsa(&certificate->key, options->key_type);
+            break;
         default:
-            return RAWRTC_CODE_INVALID_STATE;
+            error = RAWRTC_CODE_INVALID_STATE;
+            break;
     }
     if (error) {
         goto out;
@@ -495,6 +609,12 @@ enum rawrtc_code rawrtc_certificate_generate(
     // Set key type
     certificate->key_type = options->key_type;
 
+    // Cache DER encoding and fingerprints
+    error = cache_encodings(certificate);
+    if (error) {
+        goto out;
+    }
+
 out:
     if (error) {
         mem_deref(certificate);
@@ -506,62 +626,30 @@ out:
 }
 
 /*
- * Copy a certificate.
- * References the x509 certificate and private key.
+ * Create and generate a self-signed certificate.
+ *
+ * Sane and safe default options will be applied if `options` is
+ * `NULL`.
+ *
+ * A pre-generated certificate will be used if the certificate pool
+ * has been started with equivalent options and is not exhausted.
  */
-enum rawrtc_code rawrtc_certificate_copy(
-        struct rawrtc_certificate** const certificatep, // de-referenced
-        struct rawrtc_certificate* const source_certificate
+enum rawrtc_code rawrtc_certificate_generate(
+        struct rawrtc_certificate** const certificatep,
+        struct rawrtc_certificate_options* options // nullable
 ) {
-    enum rawrtc_code error = RAWRTC_CODE_UNKNOWN_ERROR;
-    struct rawrtc_certificate *certificate;
-
     // Check arguments
-    if (!certificatep || !source_certificate) {
+    if (!certificatep) {
         return RAWRTC_CODE_INVALID_ARGUMENT;
     }
 
-    // Allocate
-    certificate = mem_zalloc(sizeof(*certificate), rawrtc_certificate_destroy);
-    if (!certificate) {
-        return RAWRTC_CODE_NO_MEMORY;
+    // Take from pool (if possible)
+    if (rawrtc_certificate_pool_take(certificatep, options) == RAWRTC_CODE_SUCCESS) {
+        return RAWRTC_CODE_SUCCESS;
     }
 
-    // Increment reference count of certificate and private key, copy the pointers
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-    if (!X509_up_ref(source_certificate->certificate)) {
-        goto out;
-    }
-#else
-    if (!CRYPTO_add(&source_certificate->certificate->references, 1, CRYPTO_LOCK_X509)) {
-        goto out;
-    }
-#endif
-    certificate->certificate = source_certificate->certificate;
-#if OPENSSL_VERSION_NUMBER >= 0x10100000L
-    if (!EVP_PKEY_up_ref(source_certificate->key)) {
-        goto out;
-    }
-#else
-    if (!CRYPTO_add(&source_certificate->key->references, 1, CRYPTO_LOCK_EVP_PKEY)) {
-        goto out;
-    }
-#endif
-    certificate->key = source_certificate->key;
-    certificate->key_type = source_certificate->key_type;
-
-    // Done
-    error = RAWRTC_CODE_SUCCESS;
-
-out:
-    if (error) {
-        mem_deref(certificate);
-        ERR_print_errors_cb(print_openssl_error, NULL);
-    } else {
-        // Set pointer
-        *certificatep = certificate;
-    }
-    return error;
+    // Generate
+    return rawrtc_certificate_generate_sync(certificatep, options);
 }
 
 static enum rawrtc_code what_to_encode(
@@ -673,10 +761,9 @@ out:
 }
 
 /*
- * Get DER of the certificate and/or the private key if requested.
- * *derp will NOT be null-terminated!
+ * Encode the certificate and/or the private key to DER.
  */
-enum rawrtc_code rawrtc_certificate_get_der(
+static enum rawrtc_code encode_der(
         uint8_t** const derp,  // de-referenced
         size_t* const der_lengthp,  // de-referenced
         struct rawrtc_certificate* const certificate,
@@ -749,39 +836,522 @@ out:
     return error;
 }
 
+/*
+ * Get DER of the certificate and/or the private key if requested.
+ * *derp will NOT be null-terminated!
+ */
+enum rawrtc_code rawrtc_certificate_get_der(
+        uint8_t** const derp,  // de-referenced
+        size_t* const der_lengthp,  // de-referenced
+        struct rawrtc_certificate* const certificate,
+        enum rawrtc_certificate_encode const to_encode
+) {
+    // Check arguments
+    if (!derp || !der_lengthp || !certificate) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Use cached encoding (if both certificate and private key are requested)
+    if (to_encode == RAWRTC_CERTIFICATE_ENCODE_BOTH && certificate->der) {
+        *derp = mem_ref(certificate->der);
+        *der_lengthp = certificate->der_length;
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Encode
+    return encode_der(derp, der_lengthp, certificate, to_encode);
+}
+
+/*
+ * Encode the certificate to DER and calculate its fingerprints once.
+ * Certificates are immutable afterwards and may be shared by reference.
+ */
+static enum rawrtc_code cache_encodings(
+        struct rawrtc_certificate* const certificate
+) {
+    enum rawrtc_code error;
+    size_t i;
+    EVP_MD const * sign_function;
+    unsigned int length;
+
+    // Encode certificate and private key
+    error = encode_der(
+            &certificate->der, &certificate->der_length, certificate,
+            RAWRTC_CERTIFICATE_ENCODE_BOTH);
+    if (error) {
+        return error;
+    }
+
+    // Calculate fingerprints for each supported sign algorithm
+    for (i = 0; i < ARRAY_SIZE(certificate->fingerprints); ++i) {
+        sign_function = rawrtc_get_sign_function((enum rawrtc_certificate_sign_algorithm) i);
+        if (!sign_function) {
+            continue;
+        }
+
+        // Generate certificate fingerprint
+        if (!X509_digest(certificate->certificate, sign_function,
+                         certificate->fingerprints[i], &length) || length < 1) {
+            ERR_print_errors_cb(print_openssl_error, NULL);
+            return RAWRTC_CODE_UNKNOWN_ERROR;
+        }
+        certificate->fingerprint_lengths[i] = (size_t) length;
+
+        // Convert bytes to hex
+        error = rawrtc_bin_to_colon_hex(
+                &certificate->fingerprints_hex[i], certificate->fingerprints[i], (size_t) length);
+        if (error) {
+            return error;
+        }
+    }
+
+    // Done
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Get the binary fingerprint of a certificate.
+ * `fingerprint` must be able to hold `RAWRTC_FINGERPRINT_MAX_SIZE` bytes.
+ */
+enum rawrtc_code rawrtc_certificate_get_fingerprint_bin(
+        uint8_t* const fingerprint, // de-referenced
+        size_t* const fingerprint_lengthp, // de-referenced
+        struct rawrtc_certificate* const certificate,
+        enum rawrtc_certificate_sign_algorithm const algorithm
+) {
+    // Check arguments
+    if (!fingerprint || !fingerprint_lengthp || !certificate
+            || (size_t) algorithm >= ARRAY_SIZE(certificate->fingerprints)) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Supported algorithm?
+    if (!certificate->fingerprint_lengths[algorithm]) {
+        return RAWRTC_CODE_UNSUPPORTED_ALGORITHM;
+    }
+
+    // Copy cached fingerprint
+    memcpy(fingerprint, certificate->fingerprints[algorithm],
+           certificate->fingerprint_lengths[algorithm]);
+    *fingerprint_lengthp = certificate->fingerprint_lengths[algorithm];
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Get certificate's fingerprint.
- * Caller must ensure that `buffer` has space for
- * `RAWRTC_FINGERPRINT_MAX_SIZE_HEX` bytes
+ * `*fingerprint` must be unreferenced.
  */
 enum rawrtc_code rawrtc_certificate_get_fingerprint(
         char** const fingerprint, // de-referenced
         struct rawrtc_certificate* const certificate,
         enum rawrtc_certificate_sign_algorithm const algorithm
 ) {
-    EVP_MD const * sign_function;
-    uint8_t bytes_buffer[RAWRTC_FINGERPRINT_MAX_SIZE_HEX];
-    uint_least32_t length;
+    // Check arguments
+    if (!fingerprint || !certificate
+            || (size_t) algorithm >= ARRAY_SIZE(certificate->fingerprints_hex)) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Supported algorithm?
+    if (!certificate->fingerprints_hex[algorithm]) {
+        return RAWRTC_CODE_UNSUPPORTED_ALGORITHM;
+    }
+
+    // Copy cached fingerprint (so the cache cannot be modified)
+    return rawrtc_strdup(fingerprint, certificate->fingerprints_hex[algorithm]);
+}
+
+/*
+ * Translate an OpenSSL private key to the corresponding key type.
+ */
+static enum rawrtc_code key_to_key_type(
+        enum rawrtc_certificate_key_type* const key_typep, // de-referenced
+        EVP_PKEY* const key
+) {
+    switch (EVP_PKEY_base_id(key)) {
+        case EVP_PKEY_RSA:
+            *key_typep = RAWRTC_CERTIFICATE_KEY_TYPE_RSA;
+            return RAWRTC_CODE_SUCCESS;
+        case EVP_PKEY_EC:
+            *key_typep = RAWRTC_CERTIFICATE_KEY_TYPE_EC;
+            return RAWRTC_CODE_SUCCESS;
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        case EVP_PKEY_ED25519:
+            *key_typep = RAWRTC_CERTIFICATE_KEY_TYPE_ED25519;
+            return RAWRTC_CODE_SUCCESS;
+        case EVP_PKEY_ED448:
+            *key_typep = RAWRTC_CERTIFICATE_KEY_TYPE_ED448;
+            return RAWRTC_CODE_SUCCESS;
+#endif
+        default:
+            return RAWRTC_CODE_UNSUPPORTED_ALGORITHM;
+    }
+}
+
+/*
+ * Create a certificate from an x509 certificate and a private key.
+ * Takes ownership of `x509` and `key` (even on failure).
+ */
+static enum rawrtc_code certificate_create_from_openssl(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        X509* const x509,
+        EVP_PKEY* const key
+) {
+    struct rawrtc_certificate* certificate;
+    enum rawrtc_certificate_key_type key_type;
+    enum rawrtc_code error;
+
+    // Check that the private key belongs to the certificate
+    if (!X509_check_private_key(x509, key)) {
+        DEBUG_WARNING("Private key does not match certificate\n");
+        error = RAWRTC_CODE_INVALID_CERTIFICATE;
+        goto error;
+    }
+
+    // Get key type
+    error = key_to_key_type(&key_type, key);
+    if (error) {
+        goto error;
+    }
+
+    // Allocate
+    certificate = mem_zalloc(sizeof(*certificate), rawrtc_certificate_destroy);
+    if (!certificate) {
+        error = RAWRTC_CODE_NO_MEMORY;
+        goto error;
+    }
+
+    // Set fields
+    certificate->certificate = x509;
+    certificate->key = key;
+    certificate->key_type = key_type;
+
+    // Cache DER encoding and fingerprints
+    error = cache_encodings(certificate);
+    if (error) {
+        mem_deref(certificate);
+        return error;
+    }
+
+    // Set pointer
+    *certificatep = certificate;
+    return RAWRTC_CODE_SUCCESS;
+
+error:
+    X509_free(x509);
+    EVP_PKEY_free(key);
+    ERR_print_errors_cb(print_openssl_error, NULL);
+    return error;
+}
+
+/*
+ * Create a certificate from PEM encoded data containing both the
+ * certificate and the private key.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_from_pem(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        char const* const pem,
+        size_t const pem_length
+) {
+    BIO* bio;
+    X509* x509;
+    EVP_PKEY* key;
 
     // Check arguments
-    if (!fingerprint || !certificate) {
+    if (!certificatep || !pem || !pem_length || pem_length > INT_MAX) {
         return RAWRTC_CODE_INVALID_ARGUMENT;
     }
 
-    // Get sign function for algorithm
-    sign_function = rawrtc_get_sign_function(algorithm);
-    if (!sign_function) {
+    // Create bio structure
+    bio = BIO_new_mem_buf(pem, (int) pem_length);
+    if (!bio) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Read certificate and private key
+    x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    if (!x509 || !key) {
+        DEBUG_WARNING("Could not read certificate and private key from PEM\n");
+        X509_free(x509);
+        EVP_PKEY_free(key);
+        ERR_print_errors_cb(print_openssl_error, NULL);
+        return RAWRTC_CODE_INVALID_CERTIFICATE;
+    }
+
+    // Create certificate
+    return certificate_create_from_openssl(certificatep, x509, key);
+}
+
+/*
+ * Create a certificate from DER encoded data containing the
+ * certificate followed by the private key.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_from_der(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        uint8_t const* const der,
+        size_t const der_length
+) {
+    uint8_t const* der_d2i = der;
+    X509* x509;
+    EVP_PKEY* key;
+
+    // Check arguments
+    if (!certificatep || !der || !der_length || der_length > LONG_MAX) {
         return RAWRTC_CODE_INVALID_ARGUMENT;
     }
 
-    // Generate certificate fingerprint
-    if (!X509_digest(certificate->certificate, sign_function, bytes_buffer, &length)) {
-        return RAWRTC_CODE_NO_VALUE;
+    // Read certificate
+    x509 = d2i_X509(NULL, &der_d2i, (long) der_length);
+    if (!x509) {
+        DEBUG_WARNING("Could not read certificate from DER\n");
+        ERR_print_errors_cb(print_openssl_error, NULL);
+        return RAWRTC_CODE_INVALID_CERTIFICATE;
+    }
+
+    // Read private key (follows the certificate)
+    key = d2i_AutoPrivateKey(NULL, &der_d2i, (long) (der_length - (size_t) (der_d2i - der)));
+    if (!key) {
+        DEBUG_WARNING("Could not read private key from DER\n");
+        X509_free(x509);
+        ERR_print_errors_cb(print_openssl_error, NULL);
+        return RAWRTC_CODE_INVALID_CERTIFICATE;
+    }
+
+    // Create certificate
+    return certificate_create_from_openssl(certificatep, x509, key);
+}
+
+/*
+ * Read a whole file into a buffer.
+ * `*bufferp` must be unreferenced.
+ */
+static enum rawrtc_code read_file(
+        char** const bufferp, // de-referenced
+        size_t* const lengthp, // de-referenced
+        char const* const path
+) {
+    FILE* file;
+    long length;
+    char* buffer = NULL;
+    enum rawrtc_code error;
+
+    // Open file
+    file = fopen(path, "rb");
+    if (!file) {
+        return errno == ENOENT ? RAWRTC_CODE_NO_VALUE : rawrtc_error_to_code(errno);
+    }
+
+    // Get length
+    if (fseek(file, 0, SEEK_END) || (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET)) {
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+
+    // Empty?
+    if (length == 0) {
+        error = RAWRTC_CODE_INVALID_ARGUMENT;
+        goto out;
+    }
+
+    // Allocate & read
+    buffer = mem_alloc((size_t) length, NULL);
+    if (!buffer) {
+        error = RAWRTC_CODE_NO_MEMORY;
+        goto out;
     }
-    if (length < 1) {
-        return RAWRTC_CODE_UNKNOWN_ERROR;
+    if (fread(buffer, 1, (size_t) length, file) != (size_t) length) {
+        error = RAWRTC_CODE_IO_ERROR;
+        goto out;
     }
 
-    // Convert bytes to hex
-    return rawrtc_bin_to_colon_hex(fingerprint, bytes_buffer, (size_t) length);
+    // Done
+    error = RAWRTC_CODE_SUCCESS;
+
+out:
+    fclose(file);
+    if (error) {
+        mem_deref(buffer);
+    } else {
+        // Set pointers
+        *bufferp = buffer;
+        *lengthp = (size_t) length;
+    }
+    return error;
+}
+
+/*
+ * Write a buffer to a file atomically (write to a temporary file, flush
+ * it to disk and rename it). The file will only be accessible by the
+ * owner.
+ */
+static enum rawrtc_code write_file(
+        char const* const path,
+        char const* const buffer,
+        size_t const length
+) {
+    char* temporary_path;
+    int fd;
+    size_t offset;
+    ssize_t written;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!buffer || length == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Create temporary path
+    error = rawrtc_sdprintf(&temporary_path, "%s.tmp", path);
+    if (error) {
+        return error;
+    }
+
+    // Open temporary file
+    fd = open(temporary_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd == -1) {
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+
+    // Write (until everything has been written)
+    for (offset = 0; offset < length; offset += (size_t) written) {
+        written = write(fd, buffer + offset, length - offset);
+        if (written < 0 && errno == EINTR) {
+            written = 0;
+            continue;
+        }
+        if (written <= 0) {
+            error = written < 0 ? rawrtc_error_to_code(errno) : RAWRTC_CODE_IO_ERROR;
+            close(fd);
+            unlink(temporary_path);
+            goto out;
+        }
+    }
+
+    // Flush to disk & close
+    if (fsync(fd)) {
+        error = rawrtc_error_to_code(errno);
+        close(fd);
+        unlink(temporary_path);
+        goto out;
+    }
+    if (close(fd)) {
+        error = rawrtc_error_to_code(errno);
+        unlink(temporary_path);
+        goto out;
+    }
+
+    // Replace file
+    if (rename(temporary_path, path)) {
+        error = rawrtc_error_to_code(errno);
+        unlink(temporary_path);
+        goto out;
+    }
+
+out:
+    mem_deref(temporary_path);
+    return error;
+}
+
+/*
+ * Check whether a certificate is still valid for at least the given
+ * amount of seconds.
+ */
+static bool certificate_valid_for(
+        struct rawrtc_certificate* const certificate,
+        uint32_t const seconds
+) {
+    time_t expires = time(NULL) + (time_t) seconds;
+    return X509_cmp_time(X509_get_notAfter(certificate->certificate), &expires) > 0;
+}
+
+/*
+ * Load a certificate from a PEM file or generate a new certificate
+ * and store it in that file.
+ *
+ * A new certificate will be generated if the file does not exist,
+ * cannot be parsed, the key type does not match the options or if
+ * the stored certificate expires within
+ * `RAWRTC_CERTIFICATE_RENEW_MARGIN` seconds.
+ *
+ * Sane and safe default options will be applied if `options` is
+ * `NULL`.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_load_or_generate(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        char const* const path,
+        struct rawrtc_certificate_options* options // nullable
+) {
+    char* pem = NULL;
+    size_t pem_length;
+    struct rawrtc_certificate* certificate = NULL;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!certificatep || !path) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Default options
+    if (!options) {
+        options = &rawrtc_default_certificate_options;
+    }
+
+    // Load stored certificate (if any)
+    error = read_file(&pem, &pem_length, path);
+    if (!error) {
+        error = rawrtc_certificate_from_pem(&certificate, pem, pem_length);
+        pem = mem_deref(pem);
+    }
+    if (!error) {
+        // Usable?
+        if (certificate->key_type != options->key_type) {
+            DEBUG_NOTICE("Stored certificate has a different key type, renewing\n");
+            certificate = mem_deref(certificate);
+        } else if (!certificate_valid_for(certificate, RAWRTC_CERTIFICATE_RENEW_MARGIN)) {
+            DEBUG_NOTICE("Stored certificate expires soon, renewing\n");
+            certificate = mem_deref(certificate);
+        } else {
+            DEBUG_PRINTF("Loaded certificate from %s\n", path);
+            goto out;
+        }
+    } else if (error != RAWRTC_CODE_NO_VALUE) {
+        DEBUG_WARNING("Could not load stored certificate from %s, reason: %s\n",
+                      path, rawrtc_code_to_str(error));
+    }
+
+    // Generate certificate
+    error = rawrtc_certificate_generate(&certificate, options);
+    if (error) {
+        goto out;
+    }
+
+    // Store certificate
+    error = rawrtc_certificate_get_pem(
+            &pem, &pem_length, certificate, RAWRTC_CERTIFICATE_ENCODE_BOTH);
+    if (error) {
+        goto out;
+    }
+    error = write_file(path, pem, pem_length);
+    mem_deref(pem);
+    if (error) {
+        DEBUG_WARNING("Could not store certificate in %s, reason: %s\n",
+                      path, rawrtc_code_to_str(error));
+        // Note: Not fatal, the generated certificate can still be used
+        error = RAWRTC_CODE_SUCCESS;
+    }
+
+out:
+    if (error) {
+        mem_deref(certificate);
+    } else {
+        // Set pointer
+        *certificatep = certificate;
+    }
+    return error;
 }
@@ -9,9 +9,17 @@ enum {
     RAWRTC_FINGERPRINT_MAX_SIZE_HEX = (EVP_MAX_MD_SIZE * 2)
 };
 
-enum rawrtc_code rawrtc_certificate_copy(
-    struct rawrtc_certificate** const certificatep, // de-referenced
-    struct rawrtc_certificate* const source_certificate
+/*
+ * Stored certificates expiring within this amount of seconds will be
+ * renewed.
+ */
+enum {
+    RAWRTC_CERTIFICATE_RENEW_MARGIN = 3600 * 24
+};
+
+enum rawrtc_code rawrtc_certificate_generate_sync(
+    struct rawrtc_certificate** const certificatep,
+    struct rawrtc_certificate_options* options // nullable
 );
 
 enum rawrtc_code rawrtc_certificate_get_pem(
@@ -28,6 +36,13 @@ enum rawrtc_code rawrtc_certificate_get_der(
     enum rawrtc_certificate_encode const to_encode
 );
 
+enum rawrtc_code rawrtc_certificate_get_fingerprint_bin(
+    uint8_t* const fingerprint, // de-referenced
+    size_t* const fingerprint_lengthp, // de-referenced
+    struct rawrtc_certificate* const certificate,
+    enum rawrtc_certificate_sign_algorithm const algorithm
+);
+
 enum rawrtc_code rawrtc_certificate_get_fingerprint(
     char** const fingerprint, // de-referenced
     struct rawrtc_certificate* const certificate,
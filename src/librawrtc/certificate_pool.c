@@ -0,0 +1,325 @@
+#include <pthread.h> // pthread_*
+#include <rawrtc.h>
+#include "certificate.h"
+#include "certificate_pool.h"
+#include "main.h"
+#include "utils.h"
+
+#define DEBUG_MODULE "certificate-pool"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+/*
+ * Compare two (nullable) strings.
+ */
+static bool strings_equal(
+        char const* const a, // nullable
+        char const* const b // nullable
+) {
+    if (!a || !b) {
+        return a == b;
+    }
+    return str_cmp(a, b) == 0;
+}
+
+/*
+ * Check whether two sets of certificate options would generate
+ * equivalent certificates.
+ */
+static bool options_equal(
+        struct rawrtc_certificate_options* const a,
+        struct rawrtc_certificate_options* const b
+) {
+    return a == b || (a->key_type == b->key_type
+        && strings_equal(a->common_name, b->common_name)
+        && a->valid_until == b->valid_until
+        && a->sign_algorithm == b->sign_algorithm
+        && strings_equal(a->named_curve, b->named_curve)
+        && a->modulus_length == b->modulus_length);
+}
+
+/*
+ * Get the options certificates of a pool are being generated with.
+ */
+static struct rawrtc_certificate_options* pool_options(
+        struct rawrtc_certificate_pool* const pool
+) {
+    return pool->options ? pool->options : &rawrtc_default_certificate_options;
+}
+
+/*
+ * Refill the pool until it is full or the pool is being stopped.
+ */
+static void* pool_worker(
+        void* arg
+) {
+    struct rawrtc_certificate_pool* const pool = arg;
+    struct rawrtc_certificate* certificate;
+    enum rawrtc_code error;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!pool->stop) {
+        // Wait until a certificate has been taken
+        if (list_count(&pool->certificates) >= pool->size) {
+            pthread_cond_wait(&pool->condition, &pool->mutex);
+            continue;
+        }
+
+        // Generate certificate (unlocked)
+        pthread_mutex_unlock(&pool->mutex);
+        error = rawrtc_certificate_generate_sync(&certificate, pool_options(pool));
+        pthread_mutex_lock(&pool->mutex);
+        if (error) {
+            // Stop refilling (callers will generate certificates synchronously)
+            DEBUG_WARNING("Could not generate certificate, stopping worker, reason: %s\n",
+                          rawrtc_code_to_str(error));
+            pool->error = error;
+            break;
+        }
+
+        // Add to pool
+        list_append(&pool->certificates, &certificate->le, certificate);
+        DEBUG_PRINTF("Generated certificate (%u available)\n", list_count(&pool->certificates));
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    // Notify event loop
+    mqueue_push(pool->mqueue, 0, NULL);
+    return NULL;
+}
+
+/*
+ * Handle a finished worker thread (on the event loop thread).
+ */
+static void pool_worker_finished_handler(
+        int id,
+        void* data,
+        void* arg
+) {
+    struct rawrtc_certificate_pool* const pool = arg;
+    (void) id; (void) data;
+
+    // Join worker thread
+    // Note: The worker returns right after notifying us, so this does not block.
+    if (pool->thread_running) {
+        pthread_join(pool->thread, NULL);
+        pool->thread_running = false;
+    }
+
+    // Release retired pool
+    if (pool->stop) {
+        list_unlink(&pool->le);
+        mem_deref(pool);
+    }
+}
+
+/*
+ * Destructor for an existing certificate pool.
+ *
+ * Note: The worker thread must have finished unless rawrtc is being
+ *       closed (see `retire_pool`).
+ */
+static void rawrtc_certificate_pool_destroy(
+        void* arg
+) {
+    struct rawrtc_certificate_pool* const pool = arg;
+
+    // Stop and join worker thread
+    // Note: This only happens on close and blocks until the current generation finished.
+    if (pool->thread_running) {
+        pthread_mutex_lock(&pool->mutex);
+        pool->stop = true;
+        pthread_cond_signal(&pool->condition);
+        pthread_mutex_unlock(&pool->mutex);
+        pthread_join(pool->thread, NULL);
+    }
+
+    // Destroy mutex & condition
+    pthread_cond_destroy(&pool->condition);
+    pthread_mutex_destroy(&pool->mutex);
+
+    // Un-reference
+    list_flush(&pool->certificates);
+    mem_deref(pool->mqueue);
+    mem_deref(pool->options);
+}
+
+/*
+ * Stop the worker thread of a pool without blocking the event loop.
+ * The pool will be released once the worker has finished.
+ */
+static void retire_pool(
+        struct rawrtc_certificate_pool* const pool // nullable
+) {
+    if (!pool) {
+        return;
+    }
+
+    // Release right away if the worker is not running
+    if (!pool->thread_running) {
+        mem_deref(pool);
+        return;
+    }
+
+    // Stop worker (the completion handler releases the pool)
+    pthread_mutex_lock(&pool->mutex);
+    pool->stop = true;
+    pthread_cond_signal(&pool->condition);
+    pthread_mutex_unlock(&pool->mutex);
+    list_append(&rawrtc_global.retired_certificate_pools, &pool->le, pool);
+}
+
+/*
+ * Start pre-generating certificates on a worker thread.
+ *
+ * Up to `size` certificates will be kept ready. Sane and safe default
+ * options will be applied if `options` is `NULL`.
+ * `rawrtc_certificate_generate` takes certificates from the pool if
+ * the requested options are equivalent to the pool's options.
+ *
+ * An existing pool will be replaced.
+ */
+enum rawrtc_code rawrtc_certificate_pool_start(
+        struct rawrtc_certificate_options* const options, // nullable, referenced
+        size_t const size
+) {
+    struct rawrtc_certificate_pool* pool;
+    int err;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!size) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    pool = mem_zalloc(sizeof(*pool), rawrtc_certificate_pool_destroy);
+    if (!pool) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/reference
+    pool->options = mem_ref(options);
+    pool->size = size;
+    pool->thread_running = false;
+    pool->stop = false;
+    pool->error = RAWRTC_CODE_SUCCESS;
+    list_init(&pool->certificates);
+
+    // Initialise mutex & condition
+    err = pthread_mutex_init(&pool->mutex, NULL);
+    if (err) {
+        DEBUG_WARNING("Failed to initialise mutex, reason: %m\n", err);
+        error = rawrtc_error_to_code(err);
+        goto out;
+    }
+    err = pthread_cond_init(&pool->condition, NULL);
+    if (err) {
+        DEBUG_WARNING("Failed to initialise condition, reason: %m\n", err);
+        error = rawrtc_error_to_code(err);
+        goto out;
+    }
+
+    // Create message queue (worker completion)
+    err = mqueue_alloc(&pool->mqueue, pool_worker_finished_handler, pool);
+    if (err) {
+        DEBUG_WARNING("Failed to create message queue, reason: %m\n", err);
+        error = rawrtc_error_to_code(err);
+        goto out;
+    }
+
+    // Start worker thread
+    err = pthread_create(&pool->thread, NULL, pool_worker, pool);
+    if (err) {
+        DEBUG_WARNING("Failed to start worker thread, reason: %m\n", err);
+        error = rawrtc_error_to_code(err);
+        goto out;
+    }
+    pool->thread_running = true;
+    error = RAWRTC_CODE_SUCCESS;
+
+out:
+    if (error) {
+        mem_deref(pool);
+    } else {
+        // Replace existing pool
+        retire_pool(rawrtc_global.certificate_pool);
+        rawrtc_global.certificate_pool = pool;
+    }
+    return error;
+}
+
+/*
+ * Stop the certificate pool and free pre-generated certificates.
+ * Does not block: a certificate still being generated will be discarded
+ * once the worker finished.
+ */
+enum rawrtc_code rawrtc_certificate_pool_stop() {
+    retire_pool(rawrtc_global.certificate_pool);
+    rawrtc_global.certificate_pool = NULL;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Stop the certificate pool and release retired pools.
+ * Blocks until their workers finished (the event loop is not running
+ * any more at this point).
+ */
+void rawrtc_certificate_pool_close() {
+    rawrtc_certificate_pool_stop();
+    list_flush(&rawrtc_global.retired_certificate_pools);
+}
+
+/*
+ * Take a pre-generated certificate from the pool.
+ * Return `RAWRTC_CODE_NO_VALUE` in case there is no pool, the pool is
+ * empty (or its worker failed) or the pool's options do not match.
+ * `*certificatep` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_certificate_pool_take(
+        struct rawrtc_certificate** const certificatep, // de-referenced
+        struct rawrtc_certificate_options* options // nullable
+) {
+    struct rawrtc_certificate_pool* const pool = rawrtc_global.certificate_pool;
+    struct rawrtc_certificate* certificate;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!certificatep) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Pool available with equivalent options?
+    if (!options) {
+        options = &rawrtc_default_certificate_options;
+    }
+    if (!pool || !options_equal(pool_options(pool), options)) {
+        return RAWRTC_CODE_NO_VALUE;
+    }
+
+    // Take certificate & wake up worker
+    pthread_mutex_lock(&pool->mutex);
+    certificate = list_ledata(list_head(&pool->certificates));
+    if (certificate) {
+        list_unlink(&certificate->le);
+        pthread_cond_signal(&pool->condition);
+    }
+    error = pool->error;
+    pthread_mutex_unlock(&pool->mutex);
+
+    // Empty?
+    if (!certificate) {
+        if (error) {
+            DEBUG_NOTICE("Certificate pool worker failed, reason: %s\n",
+                         rawrtc_code_to_str(error));
+        } else {
+            DEBUG_NOTICE("Certificate pool exhausted\n");
+        }
+        return RAWRTC_CODE_NO_VALUE;
+    }
+
+    // Set pointer
+    DEBUG_PRINTF("Took certificate from pool\n");
+    *certificatep = certificate;
+    return RAWRTC_CODE_SUCCESS;
+}
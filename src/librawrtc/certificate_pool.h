@@ -0,0 +1,28 @@
+#pragma once
+#include <pthread.h> // pthread_*
+#include <rawrtc.h>
+
+/*
+ * Pool of pre-generated certificates.
+ * Refilled by a worker thread.
+ */
+struct rawrtc_certificate_pool {
+    struct le le; // while retired
+    struct rawrtc_certificate_options* options; // referenced, nullable
+    size_t size;
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+    pthread_t thread;
+    struct mqueue* mqueue; // notifies the event loop once the worker finished
+    bool thread_running;
+    bool stop;
+    enum rawrtc_code error; // set once the worker failed
+    struct list certificates; // protected by mutex
+};
+
+enum rawrtc_code rawrtc_certificate_pool_take(
+    struct rawrtc_certificate** const certificatep, // de-referenced
+    struct rawrtc_certificate_options* const options // nullable
+);
+
+void rawrtc_certificate_pool_close();
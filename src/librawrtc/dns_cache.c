@@ -0,0 +1,414 @@
+#include <errno.h> // ENOENT
+#include <rawrtc.h>
+#include "dns_cache.h"
+#include "main.h"
+
+#define DEBUG_MODULE "dns-cache"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+/*
+ * Lookup key of a DNS cache entry.
+ */
+static uint32_t entry_key(
+        struct pl const* const host,
+        uint16_t const dns_type
+) {
+    return hash_joaat_ci(host->p, host->l) ^ dns_type;
+}
+
+/*
+ * DNS cache entry lookup arguments.
+ */
+struct entry_lookup {
+    struct pl const* host;
+    uint16_t dns_type;
+};
+
+/*
+ * DNS cache entry lookup handler.
+ */
+static bool entry_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_dns_cache_entry* const entry = le->data;
+    struct entry_lookup* const lookup = arg;
+    return entry->dns_type == lookup->dns_type && pl_strcasecmp(lookup->host, entry->host) == 0;
+}
+
+/*
+ * Find a DNS cache entry.
+ */
+static struct rawrtc_dns_cache_entry* entry_find(
+        struct rawrtc_dns_cache* const cache,
+        struct pl const* const host,
+        uint16_t const dns_type
+) {
+    struct entry_lookup lookup = {
+        .host = host,
+        .dns_type = dns_type,
+    };
+    return list_ledata(hash_lookup(
+            cache->entries, entry_key(host, dns_type), entry_lookup_handler, &lookup));
+}
+
+/*
+ * Destructor for an existing DNS cache entry.
+ */
+static void rawrtc_dns_cache_entry_destroy(
+        void* arg
+) {
+    struct rawrtc_dns_cache_entry* const entry = arg;
+
+    // Remove from cache
+    hash_unlink(&entry->le);
+
+    // Un-reference
+    mem_deref(entry->query);
+    mem_deref(entry->host);
+}
+
+/*
+ * Create a DNS cache entry and add it to the cache.
+ */
+static enum rawrtc_code entry_create(
+        struct rawrtc_dns_cache_entry** const entryp, // de-referenced
+        struct rawrtc_dns_cache* const cache,
+        struct pl const* const host,
+        uint16_t const dns_type
+) {
+    struct rawrtc_dns_cache_entry* entry;
+    enum rawrtc_code error;
+
+    // Allocate
+    entry = mem_zalloc(sizeof(*entry), rawrtc_dns_cache_entry_destroy);
+    if (!entry) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/copy
+    error = rawrtc_error_to_code(pl_strdup(&entry->host, host));
+    if (error) {
+        mem_deref(entry);
+        return error;
+    }
+    entry->dns_type = dns_type;
+    sa_init(&entry->address, AF_UNSPEC);
+    list_init(&entry->requests);
+
+    // Add to cache (owns the entry)
+    hash_append(cache->entries, entry_key(host, dns_type), &entry->le, entry);
+
+    // Set pointer
+    *entryp = entry;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Check if a DNS cache entry is expired.
+ */
+static inline bool entry_expired(
+        struct rawrtc_dns_cache_entry* const entry
+) {
+    return tmr_jiffies() >= entry->expires;
+}
+
+/*
+ * DNS A or AAAA record handler.
+ */
+static bool record_handler(
+        struct dnsrr* resource_record,
+        void* arg
+) {
+    struct rawrtc_dns_cache_entry* const entry = arg;
+    int64_t ttl;
+    DEBUG_PRINTF("DNS resource record: %H\n", dns_rr_print, resource_record);
+
+    // Set IP address
+    switch (resource_record->type) {
+        case DNS_TYPE_A:
+            sa_set_in(&entry->address, resource_record->rdata.a.addr, 0);
+            break;
+        case DNS_TYPE_AAAA:
+            sa_set_in6(&entry->address, resource_record->rdata.aaaa.addr, 0);
+            break;
+        default:
+            DEBUG_WARNING("Invalid DNS resource record, expected A/AAAA record, got: %H\n",
+                          dns_rr_print, resource_record);
+            return false; // continue traversing
+    }
+
+    // Set expiration (clamped TTL)
+    ttl = resource_record->ttl;
+    if (ttl < RAWRTC_DNS_CACHE_MIN_TTL) {
+        ttl = RAWRTC_DNS_CACHE_MIN_TTL;
+    } else if (ttl > RAWRTC_DNS_CACHE_MAX_TTL) {
+        ttl = RAWRTC_DNS_CACHE_MAX_TTL;
+    }
+    entry->err = 0;
+    entry->expires = tmr_jiffies() + (uint64_t) ttl * 1000;
+
+    // Done, stop traversing, one IP is sufficient
+    return true;
+}
+
+/*
+ * DNS query result handler.
+ */
+static void query_handler(
+        int err,
+        struct dnshdr const* header,
+        struct list* answer_records,
+        struct list* authoritive_records,
+        struct list* additional_records,
+        void* arg
+) {
+    struct rawrtc_dns_cache_entry* const entry = arg;
+    struct dnsrr* resource_record = NULL;
+    struct le* le;
+    (void) header; (void) authoritive_records; (void) additional_records;
+
+    // Handle A or AAAA record
+    if (!err) {
+        resource_record = dns_rrlist_apply2(
+                answer_records, NULL, DNS_TYPE_A, DNS_TYPE_AAAA, DNS_CLASS_IN, true,
+                record_handler, entry);
+    }
+
+    // No record?
+    if (!resource_record) {
+        err = err ? err : ENOENT;
+        DEBUG_NOTICE("Could not resolve %s (%s), reason: %m\n",
+                     entry->host, dns_rr_typename(entry->dns_type), err);
+
+        // Keep serving the previous address (if any), otherwise cache the failure
+        if (sa_af(&entry->address) == AF_UNSPEC) {
+            entry->err = err;
+        }
+        entry->expires = tmr_jiffies() + RAWRTC_DNS_CACHE_NEGATIVE_TTL * 1000;
+    }
+
+    // Notify waiting requests
+    // Note: The handlers may un-reference their own or other requests.
+    mem_ref(entry);
+    while ((le = list_head(&entry->requests)) != NULL) {
+        struct rawrtc_dns_cache_request* const request = le->data;
+        list_unlink(le);
+        if (entry->err) {
+            request->handler(entry->err, NULL, request->arg);
+        } else {
+            request->handler(0, &entry->address, request->arg);
+        }
+    }
+    mem_deref(entry);
+}
+
+/*
+ * Start a DNS query for an entry (unless one is in flight).
+ */
+static enum rawrtc_code entry_query(
+        struct rawrtc_dns_cache* const cache,
+        struct rawrtc_dns_cache_entry* const entry
+) {
+    int err;
+    struct sa servers[RAWRTC_DNS_CACHE_DNS_SERVERS];
+    uint32_t n_servers = ARRAY_SIZE(servers);
+
+    // Already in flight?
+    if (entry->query) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Create DNS client (if not created yet)
+    if (!cache->client) {
+        err = dns_srv_get(NULL, 0, servers, &n_servers);
+        if (err) {
+            DEBUG_WARNING("Unable to retrieve local DNS servers, reason: %m\n", err);
+            return rawrtc_error_to_code(err);
+        }
+        if (n_servers == 0) {
+            DEBUG_NOTICE("No DNS servers found\n");
+        }
+        err = dnsc_alloc(&cache->client, NULL, servers, n_servers);
+        if (err) {
+            DEBUG_WARNING("Unable to create DNS client instance, reason: %m\n", err);
+            return rawrtc_error_to_code(err);
+        }
+    }
+
+    // Query A or AAAA record
+    DEBUG_PRINTF("Querying %s (%s)\n", entry->host, dns_rr_typename(entry->dns_type));
+    return rawrtc_error_to_code(dnsc_query(
+            &entry->query, cache->client, entry->host, entry->dns_type, DNS_CLASS_IN, true,
+            query_handler, entry));
+}
+
+/*
+ * Initialise the DNS cache.
+ */
+enum rawrtc_code rawrtc_dns_cache_init() {
+    struct rawrtc_dns_cache* cache;
+    int err;
+
+    // Allocate
+    cache = mem_zalloc(sizeof(*cache), NULL);
+    if (!cache) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Create entry hash table
+    err = hash_alloc(&cache->entries, 16);
+    if (err) {
+        mem_deref(cache);
+        return rawrtc_error_to_code(err);
+    }
+
+    // Set pointer
+    rawrtc_global.dns_cache = cache;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Close the DNS cache and cancel queries in flight.
+ */
+void rawrtc_dns_cache_close() {
+    struct rawrtc_dns_cache* const cache = rawrtc_global.dns_cache;
+    if (!cache) {
+        return;
+    }
+
+    // Free entries
+    hash_flush(cache->entries);
+    mem_deref(cache->entries);
+    mem_deref(cache->client);
+
+    // Un-reference
+    rawrtc_global.dns_cache = mem_deref(cache);
+}
+
+/*
+ * Get the cached address of a hostname.
+ * Return `RAWRTC_CODE_NO_VALUE` in case no address has been cached.
+ * An expired address is still being returned but a query is being
+ * started in the background to refresh it.
+ */
+enum rawrtc_code rawrtc_dns_cache_lookup(
+        struct sa* const addressp, // de-referenced
+        struct pl const* const host,
+        uint16_t const dns_type
+) {
+    struct rawrtc_dns_cache* const cache = rawrtc_global.dns_cache;
+    struct rawrtc_dns_cache_entry* entry;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!addressp || !host) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Find entry with an address
+    entry = cache ? entry_find(cache, host, dns_type) : NULL;
+    if (!entry || sa_af(&entry->address) == AF_UNSPEC) {
+        return RAWRTC_CODE_NO_VALUE;
+    }
+
+    // Refresh (if expired)
+    if (entry_expired(entry)) {
+        error = entry_query(cache, entry);
+        if (error) {
+            DEBUG_WARNING("Could not refresh %s, reason: %s\n",
+                          entry->host, rawrtc_code_to_str(error));
+        }
+    }
+
+    // Set pointer
+    sa_cpy(addressp, &entry->address);
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Destructor for an existing DNS cache request.
+ */
+static void rawrtc_dns_cache_request_destroy(
+        void* arg
+) {
+    struct rawrtc_dns_cache_request* const request = arg;
+
+    // Remove from entry
+    list_unlink(&request->le);
+
+    // Un-reference
+    mem_deref(request->entry);
+}
+
+/*
+ * Resolve a hostname. Queries in flight for the same hostname and DNS
+ * type are being shared. The handler will be called once the query
+ * completed unless the request has been un-referenced before.
+ * Return the cached error in case a previous query failed recently.
+ * If `requestp` is NULL, the result will only be cached.
+ */
+enum rawrtc_code rawrtc_dns_cache_query(
+        struct rawrtc_dns_cache_request** const requestp, // de-referenced, nullable
+        struct pl const* const host,
+        uint16_t const dns_type,
+        rawrtc_dns_cache_handler* const handler, // nullable if `requestp` is NULL
+        void* const arg
+) {
+    struct rawrtc_dns_cache* const cache = rawrtc_global.dns_cache;
+    struct rawrtc_dns_cache_entry* entry;
+    struct rawrtc_dns_cache_request* request;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!host || (requestp && !handler)) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (!cache) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Get or create entry
+    entry = entry_find(cache, host, dns_type);
+    if (!entry) {
+        error = entry_create(&entry, cache, host, dns_type);
+        if (error) {
+            return error;
+        }
+    } else if (entry->err && !entry->query && !entry_expired(entry)) {
+        // Failed recently
+        return rawrtc_error_to_code(entry->err);
+    }
+
+    // Start query (if none in flight)
+    error = entry_query(cache, entry);
+    if (error) {
+        return error;
+    }
+
+    // Only caching?
+    if (!requestp) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Allocate request
+    request = mem_zalloc(sizeof(*request), rawrtc_dns_cache_request_destroy);
+    if (!request) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/reference
+    request->entry = mem_ref(entry);
+    request->handler = handler;
+    request->arg = arg;
+
+    // Wait for the query in flight
+    list_append(&entry->requests, &request->le, request);
+
+    // Set pointer
+    *requestp = request;
+    return RAWRTC_CODE_SUCCESS;
+}
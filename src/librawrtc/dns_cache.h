@@ -0,0 +1,69 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    RAWRTC_DNS_CACHE_DNS_SERVERS = 10,
+    RAWRTC_DNS_CACHE_MIN_TTL = 30, // in seconds
+    RAWRTC_DNS_CACHE_MAX_TTL = 24 * 3600, // in seconds
+    RAWRTC_DNS_CACHE_NEGATIVE_TTL = 30, // in seconds
+};
+
+/*
+ * DNS cache query result handler.
+ * `address` is NULL in case `err` is set. Its port is zero.
+ */
+typedef void (rawrtc_dns_cache_handler)(
+    int err,
+    struct sa const* address, // nullable
+    void* arg
+);
+
+/*
+ * Cached A or AAAA record of a hostname.
+ */
+struct rawrtc_dns_cache_entry {
+    struct le le;
+    char* host; // copied
+    uint16_t dns_type;
+    struct sa address; // AF_UNSPEC if not resolved
+    int err; // 0 unless the last query failed and there is no address
+    uint64_t expires; // in milliseconds (jiffies)
+    struct dns_query* query; // nullable, in flight
+    struct list requests; // waiting for the query in flight
+};
+
+/*
+ * Pending DNS cache request.
+ */
+struct rawrtc_dns_cache_request {
+    struct le le;
+    struct rawrtc_dns_cache_entry* entry; // referenced
+    rawrtc_dns_cache_handler* handler;
+    void* arg;
+};
+
+/*
+ * Process-wide DNS cache.
+ */
+struct rawrtc_dns_cache {
+    struct dnsc* client; // nullable, created on first query
+    struct hash* entries;
+};
+
+enum rawrtc_code rawrtc_dns_cache_init();
+
+void rawrtc_dns_cache_close();
+
+enum rawrtc_code rawrtc_dns_cache_lookup(
+    struct sa* const addressp, // de-referenced
+    struct pl const* const host,
+    uint16_t const dns_type
+);
+
+enum rawrtc_code rawrtc_dns_cache_query(
+    struct rawrtc_dns_cache_request** const requestp, // de-referenced, nullable
+    struct pl const* const host,
+    uint16_t const dns_type,
+    rawrtc_dns_cache_handler* const handler, // nullable if `requestp` is NULL
+    void* const arg
+);
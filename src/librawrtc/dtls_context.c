@@ -0,0 +1,431 @@
+#include <string.h> // memcmp, strstr
+#if defined(__linux__) && (defined(__aarch64__) || defined(__arm__))
+#include <sys/auxv.h> // getauxval
+#include <asm/hwcap.h> // HWCAP_AES, HWCAP2_AES
+#endif
+#include <openssl/ssl.h> // SSL_CTX_*
+#include <openssl/err.h> // ERR_clear_error
+#include <rawrtc.h>
+#include "dtls_context.h"
+#include "dtls_session.h"
+#include "certificate.h"
+#include "main.h"
+#include "utils.h"
+
+#define DEBUG_MODULE "dtls-context"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+/*
+ * Embedded DH parameters in DER encoding (bits: 2048)
+ */
+uint8_t const rawrtc_default_dh_parameters[] = {
+    0x30, 0x82, 0x01, 0x08, 0x02, 0x82, 0x01, 0x01, 0x00, 0xaa, 0x4c, 0x1f,
+    0x1e, 0xc9, 0xed, 0xfe, 0x5c, 0x50, 0x2d, 0xff, 0xf4, 0x95, 0xf4, 0x80,
+    0x69, 0xcf, 0xc3, 0x84, 0x29, 0x87, 0xd5, 0x2c, 0x4f, 0xf6, 0x9e, 0x88,
+    0xa2, 0x5b, 0x61, 0xd2, 0x7d, 0x78, 0x97, 0xce, 0x47, 0x39, 0x9d, 0xc0,
+    0x95, 0x14, 0x98, 0x1f, 0xa9, 0xa3, 0x42, 0x93, 0x58, 0x49, 0x3d, 0xad,
+    0xeb, 0x6c, 0x3d, 0x79, 0x2d, 0x27, 0x94, 0x67, 0x4c, 0xdc, 0x94, 0x31,
+    0xbf, 0xc1, 0x00, 0x9d, 0x96, 0x4a, 0x91, 0xa7, 0x4f, 0xab, 0x48, 0x44,
+    0xcc, 0x54, 0x1a, 0x4e, 0x2a, 0x8e, 0xa1, 0x81, 0x4b, 0xeb, 0xea, 0xc3,
+    0xba, 0xd6, 0x03, 0xfb, 0xf2, 0x9a, 0x48, 0x1f, 0xc8, 0xba, 0x73, 0x89,
+    0x86, 0x25, 0x2e, 0xba, 0x10, 0x80, 0x2a, 0xeb, 0xf9, 0xe2, 0x28, 0xf1,
+    0xcf, 0x85, 0x0d, 0xeb, 0x2f, 0x61, 0x51, 0x11, 0xe1, 0xe7, 0x82, 0xe5,
+    0xa7, 0x5d, 0x71, 0x0a, 0xef, 0x8a, 0xe1, 0x97, 0x48, 0x41, 0xac, 0xd7,
+    0xc5, 0xf7, 0xce, 0xd5, 0xcd, 0x66, 0x1e, 0x6b, 0x0e, 0x82, 0x4e, 0x77,
+    0x5d, 0x89, 0x3b, 0xe2, 0x94, 0x7a, 0x10, 0xee, 0x5b, 0x5d, 0x36, 0x07,
+    0x29, 0x8b, 0x06, 0xb6, 0x49, 0x1e, 0x17, 0x17, 0x57, 0xc8, 0xc1, 0x80,
+    0x24, 0x15, 0x22, 0x9c, 0xb8, 0x59, 0x55, 0x08, 0x41, 0x67, 0x07, 0xca,
+    0xa8, 0x54, 0x1a, 0xd1, 0xb7, 0x91, 0x2f, 0x41, 0x78, 0xc0, 0xcd, 0x2f,
+    0x07, 0x49, 0x4b, 0xb9, 0x05, 0xf4, 0xea, 0x72, 0x3a, 0xcf, 0x04, 0x69,
+    0xcb, 0x5b, 0xe4, 0xcb, 0x4f, 0x72, 0x40, 0xe4, 0x56, 0x1f, 0xca, 0xee,
+    0x33, 0x2b, 0x29, 0x1a, 0x80, 0xda, 0x01, 0x3f, 0x03, 0xa6, 0xbf, 0x32,
+    0x02, 0x6c, 0xfb, 0xb1, 0xb5, 0x81, 0xda, 0x32, 0x6f, 0xa1, 0x4b, 0x9f,
+    0x42, 0x2e, 0x17, 0xc9, 0x95, 0x30, 0xda, 0x16, 0xb7, 0x9a, 0x7c, 0xf4,
+    0x83, 0x02, 0x01, 0x02
+};
+size_t const rawrtc_default_dh_parameters_length = ARRAY_SIZE(rawrtc_default_dh_parameters);
+
+/*
+ * List of default DTLS cipher suites.
+ * Note: Reordered by `rawrtc_dtls_context_order_cipher_suites` on init.
+ */
+char const* rawrtc_default_dtls_cipher_suites[] = {
+    "ECDHE-ECDSA-CHACHA20-POLY1305",
+    "ECDHE-RSA-CHACHA20-POLY1305",
+    "ECDHE-ECDSA-AES128-GCM-SHA256", // recommended
+    "ECDHE-RSA-AES128-GCM-SHA256",
+    "ECDHE-ECDSA-AES256-GCM-SHA384",
+    "ECDHE-RSA-AES256-GCM-SHA384",
+    "DHE-RSA-AES128-GCM-SHA256",
+    "DHE-RSA-AES256-GCM-SHA384",
+    "ECDHE-ECDSA-AES128-SHA256",
+    "ECDHE-RSA-AES128-SHA256",
+    "ECDHE-ECDSA-AES128-SHA", // required
+    "ECDHE-RSA-AES256-SHA384",
+    "ECDHE-RSA-AES128-SHA",
+    "ECDHE-ECDSA-AES256-SHA384",
+    "ECDHE-ECDSA-AES256-SHA",
+    "ECDHE-RSA-AES256-SHA",
+    "DHE-RSA-AES128-SHA256",
+    "DHE-RSA-AES128-SHA",
+    "DHE-RSA-AES256-SHA256",
+    "DHE-RSA-AES256-SHA"
+};
+size_t const rawrtc_default_dtls_cipher_suites_length =
+        ARRAY_SIZE(rawrtc_default_dtls_cipher_suites);
+
+/*
+ * Check whether the CPU provides AES instructions.
+ */
+static bool have_aes_instructions() {
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(__linux__) && defined(__aarch64__) && defined(HWCAP_AES)
+    return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#elif defined(__linux__) && defined(__arm__) && defined(HWCAP2_AES)
+    return (getauxval(AT_HWCAP2) & HWCAP2_AES) != 0;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Get the preference rank of a cipher suite (lower is better).
+ */
+static int cipher_suite_rank(
+        char const* const cipher_suite,
+        bool const prefer_aes
+) {
+    bool const is_aes_gcm = strstr(cipher_suite, "-GCM-") != NULL;
+    bool const is_chacha20 = strstr(cipher_suite, "CHACHA20") != NULL;
+
+    // Preferred AEAD first, then the other AEAD, then everything else
+    if (is_aes_gcm || is_chacha20) {
+        return is_aes_gcm == prefer_aes ? 0 : 1;
+    } else {
+        return 2;
+    }
+}
+
+/*
+ * Reorder the default DTLS cipher suites depending on the CPU's
+ * capabilities: AES-GCM is preferred if the CPU has AES instructions,
+ * ChaCha20-Poly1305 otherwise. The relative order of the cipher suites
+ * within each group is retained.
+ */
+void rawrtc_dtls_context_order_cipher_suites() {
+    bool const prefer_aes = have_aes_instructions();
+    size_t i;
+    size_t j;
+
+    // Stable insertion sort by rank
+    for (i = 1; i < rawrtc_default_dtls_cipher_suites_length; ++i) {
+        char const* const cipher_suite = rawrtc_default_dtls_cipher_suites[i];
+        int const rank = cipher_suite_rank(cipher_suite, prefer_aes);
+        for (j = i; j > 0; --j) {
+            if (cipher_suite_rank(rawrtc_default_dtls_cipher_suites[j - 1], prefer_aes) <= rank) {
+                break;
+            }
+            rawrtc_default_dtls_cipher_suites[j] = rawrtc_default_dtls_cipher_suites[j - 1];
+        }
+        rawrtc_default_dtls_cipher_suites[j] = cipher_suite;
+    }
+
+    DEBUG_PRINTF("Preferring %s cipher suites\n", prefer_aes ? "AES-GCM" : "ChaCha20-Poly1305");
+}
+
+/*
+ * Default (EC)DHE key exchange groups in order of preference.
+ */
+char const rawrtc_default_dtls_groups[] = "X25519:P-256:P-384";
+
+/*
+ * Search context for the DTLS context cache.
+ */
+struct lookup_context {
+    uint8_t const* fingerprint;
+    size_t fingerprint_length;
+    char const* cipher_suites;
+};
+
+/*
+ * Destructor for an existing DTLS context.
+ */
+static void rawrtc_dtls_context_destroy(
+        void* arg
+) {
+    struct rawrtc_dtls_context* const context = arg;
+
+    // Remove from cache
+    hash_unlink(&context->le);
+
+    // Un-reference
+    mem_deref(context->tls);
+    mem_deref(context->cipher_suites);
+}
+
+/*
+ * Join cipher suites into an OpenSSL cipher list string.
+ * `*cipher_suitesp` must be unreferenced.
+ */
+static enum rawrtc_code join_cipher_suites(
+        char** const cipher_suitesp, // de-referenced
+        char const* cipher_suites[],
+        size_t const n_cipher_suites
+) {
+    struct mbuf* buffer;
+    size_t i;
+    int err = 0;
+
+    // Allocate buffer
+    buffer = mbuf_alloc(n_cipher_suites * 32);
+    if (!buffer) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Join cipher suites
+    for (i = 0; i < n_cipher_suites; ++i) {
+        err = mbuf_printf(buffer, "%s%s", i > 0 ? ":" : "", cipher_suites[i]);
+        if (err) {
+            goto out;
+        }
+    }
+
+    // Copy to string
+    mbuf_set_pos(buffer, 0);
+    err = mbuf_strdup(buffer, cipher_suitesp, mbuf_get_left(buffer));
+
+out:
+    mem_deref(buffer);
+    return rawrtc_error_to_code(err);
+}
+
+/*
+ * Check if a cached DTLS context matches the lookup context.
+ */
+static bool context_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_dtls_context* const context = le->data;
+    struct lookup_context* const lookup = arg;
+
+    return context->fingerprint_length == lookup->fingerprint_length
+        && memcmp(context->fingerprint, lookup->fingerprint, lookup->fingerprint_length) == 0
+        && str_cmp(context->cipher_suites, lookup->cipher_suites) == 0;
+}
+
+/*
+ * Set the certificate and its private key on a DTLS context.
+ */
+static enum rawrtc_code set_certificate(
+        struct tls* const tls,
+        struct rawrtc_certificate* const certificate
+) {
+    SSL_CTX* ssl_context;
+    uint8_t* certificate_der;
+    size_t certificate_der_length;
+    enum rawrtc_code error;
+
+    switch (certificate->key_type) {
+        case RAWRTC_CERTIFICATE_KEY_TYPE_RSA:
+        case RAWRTC_CERTIFICATE_KEY_TYPE_EC:
+            // Get DER encoded certificate
+            error = rawrtc_certificate_get_der(
+                    &certificate_der, &certificate_der_length, certificate,
+                    RAWRTC_CERTIFICATE_ENCODE_BOTH);
+            if (error) {
+                return error;
+            }
+
+            // Set certificate
+            error = rawrtc_error_to_code(tls_set_certificate_der(
+                    tls, rawrtc_certificate_key_type_to_tls_keytype(certificate->key_type),
+                    certificate_der, certificate_der_length, NULL, 0));
+            mem_deref(certificate_der);
+            return error;
+
+        default:
+            // Note: re does not know about other key types, so we need to use OpenSSL directly
+            ssl_context = tls_openssl_context(tls);
+            if (!SSL_CTX_use_certificate(ssl_context, certificate->certificate)
+                    || !SSL_CTX_use_PrivateKey(ssl_context, certificate->key)
+                    || !SSL_CTX_check_private_key(ssl_context)) {
+                DEBUG_WARNING("Could not set certificate on DTLS context\n");
+                ERR_clear_error();
+                return RAWRTC_CODE_INVALID_CERTIFICATE;
+            }
+            return RAWRTC_CODE_SUCCESS;
+    }
+}
+
+/*
+ * Set the preferred key exchange groups on a DTLS context.
+ * Note: OpenSSL's default groups will be used if this fails.
+ */
+static void set_groups(
+        struct tls* const tls
+) {
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+    SSL_CTX* const ssl_context = tls_openssl_context(tls);
+    if (!SSL_CTX_set1_groups_list(ssl_context, rawrtc_default_dtls_groups)) {
+        DEBUG_WARNING("Could not set key exchange groups on DTLS context, "
+                      "using default groups\n");
+        ERR_clear_error();
+    }
+#else
+    (void) tls;
+#endif
+}
+
+/*
+ * Create a new DTLS context and set certificate, DH parameters and
+ * cipher suites.
+ */
+static enum rawrtc_code dtls_context_create(
+        struct rawrtc_dtls_context** const contextp, // de-referenced
+        struct rawrtc_certificate* const certificate,
+        char const* cipher_suites[],
+        size_t const n_cipher_suites
+) {
+    struct rawrtc_dtls_context* context;
+    enum rawrtc_code error;
+
+    // Allocate
+    context = mem_zalloc(sizeof(*context), rawrtc_dtls_context_destroy);
+    if (!context) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Create (D)TLS context
+    DEBUG_PRINTF("Creating DTLS context\n");
+    error = rawrtc_error_to_code(tls_alloc(&context->tls, TLS_METHOD_DTLS, NULL, NULL));
+    if (error) {
+        goto out;
+    }
+
+    // Set certificate
+    DEBUG_PRINTF("Setting certificate on DTLS context\n");
+    error = set_certificate(context->tls, certificate);
+    if (error) {
+        goto out;
+    }
+
+    // Set Diffie-Hellman parameters
+    // TODO: Get DH params from config
+    DEBUG_PRINTF("Setting DH parameters on DTLS context\n");
+    error = rawrtc_error_to_code(tls_set_dh_params_der(
+            context->tls, rawrtc_default_dh_parameters, rawrtc_default_dh_parameters_length));
+    if (error) {
+        goto out;
+    }
+
+    // Set cipher suites
+    DEBUG_PRINTF("Setting cipher suites on DTLS context\n");
+    error = rawrtc_error_to_code(tls_set_ciphers(
+            context->tls, cipher_suites, (int) n_cipher_suites));
+    if (error) {
+        goto out;
+    }
+
+    // Set key exchange groups (X25519 preferred)
+    DEBUG_PRINTF("Setting key exchange groups on DTLS context\n");
+    set_groups(context->tls);
+
+    // Send client certificate (client) / request client certificate (server)
+    tls_set_verify_client(context->tls);
+
+out:
+    if (error) {
+        mem_deref(context);
+    } else {
+        // Set pointer
+        *contextp = context;
+    }
+    return error;
+}
+
+/*
+ * Get a DTLS context for a certificate and a list of cipher suites.
+ * Returns a cached context if one exists for the same certificate
+ * (fingerprint) and cipher suites, otherwise a new context will be
+ * created and cached.
+ * `*contextp` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_dtls_context_get(
+        struct rawrtc_dtls_context** const contextp, // de-referenced
+        struct rawrtc_certificate* const certificate,
+        char const* cipher_suites[],
+        size_t const n_cipher_suites
+) {
+    uint8_t fingerprint[RAWRTC_FINGERPRINT_MAX_SIZE];
+    size_t fingerprint_length;
+    char* joined_cipher_suites = NULL;
+    enum rawrtc_code error;
+    uint32_t key;
+    struct lookup_context lookup;
+    struct rawrtc_dtls_context* context;
+
+    // Check arguments
+    if (!contextp || !certificate || !cipher_suites || !n_cipher_suites) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Get certificate fingerprint
+    error = rawrtc_certificate_get_fingerprint_bin(
+            fingerprint, &fingerprint_length, certificate,
+            RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA256);
+    if (error) {
+        return error;
+    }
+
+    // Join cipher suites
+    error = join_cipher_suites(&joined_cipher_suites, cipher_suites, n_cipher_suites);
+    if (error) {
+        return error;
+    }
+
+    // Lookup cached context
+    key = hash_joaat(fingerprint, fingerprint_length);
+    lookup.fingerprint = fingerprint;
+    lookup.fingerprint_length = fingerprint_length;
+    lookup.cipher_suites = joined_cipher_suites;
+    context = list_ledata(hash_lookup(
+            rawrtc_global.dtls_contexts, key, context_lookup_handler, &lookup));
+    if (context) {
+        DEBUG_PRINTF("Using cached DTLS context\n");
+        *contextp = mem_ref(context);
+        goto out;
+    }
+
+    // Create context
+    error = dtls_context_create(&context, certificate, cipher_suites, n_cipher_suites);
+    if (error) {
+        goto out;
+    }
+
+    // Set fields
+    memcpy(context->fingerprint, fingerprint, fingerprint_length);
+    context->fingerprint_length = fingerprint_length;
+    context->cipher_suites = mem_ref(joined_cipher_suites);
+
+    // Enable session resumption
+    error = rawrtc_dtls_session_cache_attach(context->tls, fingerprint, fingerprint_length);
+    if (error) {
+        mem_deref(context);
+        goto out;
+    }
+
+    // Add to cache
+    // Note: The cache does not hold a reference, the context removes itself once destroyed.
+    hash_append(rawrtc_global.dtls_contexts, key, &context->le, context);
+
+    // Set pointer
+    *contextp = context;
+
+out:
+    mem_deref(joined_cipher_suites);
+    return error;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <rawrtc.h>
+#include "certificate.h"
+
+/*
+ * Shared DTLS context.
+ * Transports using the same certificate and cipher suites share one context.
+ */
+struct rawrtc_dtls_context {
+    struct le le;
+    uint8_t fingerprint[RAWRTC_FINGERPRINT_MAX_SIZE];
+    size_t fingerprint_length;
+    char* cipher_suites;
+    struct tls* tls;
+};
+
+extern char const* rawrtc_default_dtls_cipher_suites[];
+extern size_t const rawrtc_default_dtls_cipher_suites_length;
+
+void rawrtc_dtls_context_order_cipher_suites();
+
+enum rawrtc_code rawrtc_dtls_context_get(
+    struct rawrtc_dtls_context** const contextp, // de-referenced
+    struct rawrtc_certificate* const certificate,
+    char const* cipher_suites[],
+    size_t const n_cipher_suites
+);
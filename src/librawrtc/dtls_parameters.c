@@ -1,5 +1,10 @@
 #include <rawrtc.h>
 #include "dtls_parameters.h"
+#include "utils.h"
+
+#define DEBUG_MODULE "dtls-parameters"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
 
 /*
  * Destructor for an existing DTLS fingerprint instance.
@@ -13,6 +18,45 @@ static void rawrtc_dtls_fingerprint_destroy(
     mem_deref(fingerprint->value);
 }
 
+/*
+ * Convert the hex-encoded value of a fingerprint to binary.
+ * Leaves the binary length at 0 if the value is invalid or the
+ * algorithm is unsupported.
+ */
+static void parse_fingerprint(
+        struct rawrtc_dtls_fingerprint* const fingerprint
+) {
+    size_t length;
+    size_t bytes_written;
+    enum rawrtc_code error;
+
+    // Get algorithm digest size
+    error = rawrtc_get_sign_algorithm_length(&length, fingerprint->algorithm);
+    if (error) {
+        return;
+    }
+
+    // Convert hex-encoded value to binary
+    error = rawrtc_colon_hex_to_bin(
+            &bytes_written, fingerprint->value_binary, sizeof(fingerprint->value_binary),
+            fingerprint->value);
+    if (error) {
+        DEBUG_WARNING("Could not convert hex-encoded fingerprint to binary, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        return;
+    }
+
+    // Validate length
+    if (bytes_written != length) {
+        DEBUG_WARNING("Hex-encoded fingerprint should have been %zu bytes but was %zu bytes\n",
+                      length, bytes_written);
+        return;
+    }
+
+    // Set length
+    fingerprint->value_binary_length = length;
+}
+
 /*
  * Create a new DTLS fingerprint instance.
  */
@@ -37,6 +81,9 @@ enum rawrtc_code rawrtc_dtls_fingerprint_create(
         goto out;
     }
 
+    // Parse binary value once (used to verify the remote certificate)
+    parse_fingerprint(fingerprint);
+
 out:
     if (error) {
         mem_deref(fingerprint);
@@ -0,0 +1,444 @@
+#include <string.h> // memcpy, memcmp
+#include <time.h> // time
+#include <openssl/ssl.h> // SSL_*
+#include <openssl/evp.h> // EVP_*
+#include <openssl/rand.h> // RAND_bytes
+#include <openssl/x509.h> // X509_digest
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h> // OSSL_MAC_PARAM_*
+#include <openssl/params.h> // OSSL_PARAM_*
+#else
+#include <openssl/hmac.h> // HMAC_*
+#endif
+#include <rawrtc.h>
+#include "dtls_session.h"
+#include "main.h"
+#include "utils.h"
+
+#define DEBUG_MODULE "dtls-session"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+/*
+ * Destructor for an existing cached session.
+ */
+static void rawrtc_dtls_session_destroy(
+        void* arg
+) {
+    struct rawrtc_dtls_session* const session = arg;
+
+    // Remove from cache
+    hash_unlink(&session->le);
+    list_unlink(&session->age_le);
+
+    // Free
+    SSL_SESSION_free(session->session);
+}
+
+/*
+ * Check if a cached session matches a fingerprint.
+ */
+static bool session_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_dtls_session* const session = le->data;
+    return memcmp(session->fingerprint, arg, sizeof(session->fingerprint)) == 0;
+}
+
+/*
+ * Find a cached session by the remote certificate's SHA-256 fingerprint.
+ */
+static struct rawrtc_dtls_session* session_lookup(
+        struct rawrtc_dtls_session_cache* const cache,
+        uint8_t* const fingerprint
+) {
+    return list_ledata(hash_lookup(
+            cache->sessions, hash_joaat(fingerprint, 32), session_lookup_handler, fingerprint));
+}
+
+/*
+ * Generate a new (current) session ticket key and retain the previous
+ * one so that recently issued tickets can still be decrypted.
+ */
+static enum rawrtc_code rotate_ticket_key(
+        struct rawrtc_dtls_session_cache* const cache
+) {
+    struct rawrtc_dtls_ticket_key key;
+
+    // Generate key
+    if (RAND_bytes(key.name, sizeof(key.name)) != 1
+            || RAND_bytes(key.aes_key, sizeof(key.aes_key)) != 1
+            || RAND_bytes(key.hmac_key, sizeof(key.hmac_key)) != 1) {
+        DEBUG_WARNING("Could not generate session ticket key\n");
+        return RAWRTC_CODE_UNKNOWN_ERROR;
+    }
+    key.valid = true;
+
+    // Rotate
+    cache->ticket_keys[1] = cache->ticket_keys[0];
+    cache->ticket_keys[0] = key;
+    cache->ticket_key_created = tmr_jiffies();
+    DEBUG_PRINTF("Rotated session ticket key\n");
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Select the ticket key and initialise the cipher context for
+ * encrypting or decrypting a session ticket.
+ * Returns the value expected by OpenSSL's ticket key callback.
+ */
+static int init_ticket_cipher(
+        struct rawrtc_dtls_ticket_key** const keyp, // de-referenced
+        unsigned char* const key_name,
+        unsigned char* const iv,
+        EVP_CIPHER_CTX* const cipher_context,
+        int const encrypt
+) {
+    struct rawrtc_dtls_session_cache* const cache = rawrtc_global.dtls_session_cache;
+    struct rawrtc_dtls_ticket_key* key;
+    size_t i;
+
+    // Encrypt: Use current key (rotate if expired)
+    if (encrypt) {
+        if (!cache->ticket_keys[0].valid
+                || tmr_jiffies() - cache->ticket_key_created >= RAWRTC_DTLS_TICKET_KEY_LIFETIME) {
+            if (rotate_ticket_key(cache)) {
+                return -1;
+            }
+        }
+        key = &cache->ticket_keys[0];
+
+        // Set key name and generate IV
+        memcpy(key_name, key->name, sizeof(key->name));
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1) {
+            return -1;
+        }
+        if (!EVP_EncryptInit_ex(cipher_context, EVP_aes_256_cbc(), NULL, key->aes_key, iv)) {
+            return -1;
+        }
+        *keyp = key;
+        return 1;
+    }
+
+    // Decrypt: Find key by name
+    for (i = 0; i < ARRAY_SIZE(cache->ticket_keys); ++i) {
+        key = &cache->ticket_keys[i];
+        if (key->valid && memcmp(key_name, key->name, sizeof(key->name)) == 0) {
+            if (!EVP_DecryptInit_ex(cipher_context, EVP_aes_256_cbc(), NULL, key->aes_key, iv)) {
+                return -1;
+            }
+            *keyp = key;
+
+            // Ask for a renewed ticket if the previous key has been used
+            return i == 0 ? 1 : 2;
+        }
+    }
+
+    // Unknown key (full handshake)
+    DEBUG_PRINTF("Unknown session ticket key\n");
+    return 0;
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+/*
+ * Encrypt or decrypt a session ticket.
+ */
+static int ticket_key_handler(
+        SSL* ssl,
+        unsigned char* key_name,
+        unsigned char* iv,
+        EVP_CIPHER_CTX* cipher_context,
+        EVP_MAC_CTX* mac_context,
+        int encrypt
+) {
+    struct rawrtc_dtls_ticket_key* key;
+    OSSL_PARAM parameters[3];
+    int result;
+    (void) ssl;
+
+    // Initialise cipher
+    result = init_ticket_cipher(&key, key_name, iv, cipher_context, encrypt);
+    if (result <= 0) {
+        return result;
+    }
+
+    // Initialise HMAC
+    parameters[0] = OSSL_PARAM_construct_octet_string(
+            OSSL_MAC_PARAM_KEY, key->hmac_key, sizeof(key->hmac_key));
+    parameters[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0);
+    parameters[2] = OSSL_PARAM_construct_end();
+    if (!EVP_MAC_CTX_set_params(mac_context, parameters)) {
+        return -1;
+    }
+    return result;
+}
+#else
+/*
+ * Encrypt or decrypt a session ticket.
+ */
+static int ticket_key_handler(
+        SSL* ssl,
+        unsigned char* key_name,
+        unsigned char* iv,
+        EVP_CIPHER_CTX* cipher_context,
+        HMAC_CTX* mac_context,
+        int encrypt
+) {
+    struct rawrtc_dtls_ticket_key* key;
+    int result;
+    (void) ssl;
+
+    // Initialise cipher
+    result = init_ticket_cipher(&key, key_name, iv, cipher_context, encrypt);
+    if (result <= 0) {
+        return result;
+    }
+
+    // Initialise HMAC
+    if (!HMAC_Init_ex(mac_context, key->hmac_key, sizeof(key->hmac_key), EVP_sha256(), NULL)) {
+        return -1;
+    }
+    return result;
+}
+#endif
+
+/*
+ * Store a new client session.
+ */
+static int new_session_handler(
+        SSL* ssl,
+        SSL_SESSION* ssl_session
+) {
+    struct rawrtc_dtls_session_cache* const cache = rawrtc_global.dtls_session_cache;
+    X509* peer_certificate;
+    uint8_t fingerprint[EVP_MAX_MD_SIZE];
+    unsigned int fingerprint_length;
+    struct rawrtc_dtls_session* session;
+
+    // Only client sessions are being cached (the server uses tickets)
+    if (SSL_is_server(ssl)) {
+        return 0;
+    }
+
+    // Get remote certificate's fingerprint
+    peer_certificate = SSL_SESSION_get0_peer(ssl_session);
+    if (!peer_certificate
+            || !X509_digest(peer_certificate, EVP_sha256(), fingerprint, &fingerprint_length)
+            || fingerprint_length != 32) {
+        return 0;
+    }
+
+    // Remove existing session
+    mem_deref(session_lookup(cache, fingerprint));
+
+    // Allocate
+    session = mem_zalloc(sizeof(*session), rawrtc_dtls_session_destroy);
+    if (!session) {
+        return 0;
+    }
+
+    // Set fields
+    memcpy(session->fingerprint, fingerprint, sizeof(session->fingerprint));
+    session->session = ssl_session;
+
+    // Add to cache
+    // Note: The cache owns the session.
+    hash_append(cache->sessions, hash_joaat(fingerprint, 32), &session->le, session);
+    list_append(&cache->sessions_by_age, &session->age_le, session);
+    DEBUG_PRINTF("Cached client session\n");
+
+    // Remove oldest session (if exceeding the limit)
+    if (list_count(&cache->sessions_by_age) > RAWRTC_DTLS_SESSION_CACHE_SIZE) {
+        mem_deref(list_ledata(list_head(&cache->sessions_by_age)));
+    }
+
+    // Note: Returning 1 indicates that we have taken the session's reference.
+    return 1;
+}
+
+/*
+ * Offer the selected session on handshake start and update counters
+ * once the handshake is done.
+ */
+static void info_handler(
+        SSL const* ssl,
+        int where,
+        int value
+) {
+    struct rawrtc_dtls_session_cache* const cache = rawrtc_global.dtls_session_cache;
+    (void) value;
+
+    // Offer selected session
+    // Note: OpenSSL has no lookup callback for client sessions and re does not expose the
+    //       connection's SSL instance, so the session is set when the handshake starts.
+    if ((where & SSL_CB_HANDSHAKE_START) && cache->selected && !SSL_is_server((SSL*) ssl)) {
+        if (!SSL_set_session((SSL*) ssl, cache->selected)) {
+            DEBUG_WARNING("Could not offer cached session\n");
+        }
+        cache->selected = NULL;
+    }
+
+    // Update counters
+    if (where & SSL_CB_HANDSHAKE_DONE) {
+        if (SSL_session_reused((SSL*) ssl)) {
+            DEBUG_PRINTF("DTLS session resumed\n");
+            ++cache->hits;
+        } else {
+            ++cache->misses;
+        }
+    }
+}
+
+/*
+ * Initialise the DTLS session cache.
+ */
+enum rawrtc_code rawrtc_dtls_session_cache_init() {
+    struct rawrtc_dtls_session_cache* cache;
+    int err;
+
+    // Allocate
+    cache = mem_zalloc(sizeof(*cache), NULL);
+    if (!cache) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Create session hash table
+    err = hash_alloc(&cache->sessions, 16);
+    if (err) {
+        mem_deref(cache);
+        return rawrtc_error_to_code(err);
+    }
+    list_init(&cache->sessions_by_age);
+
+    // Set pointer
+    rawrtc_global.dtls_session_cache = cache;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Close the DTLS session cache and free cached sessions.
+ */
+void rawrtc_dtls_session_cache_close() {
+    struct rawrtc_dtls_session_cache* const cache = rawrtc_global.dtls_session_cache;
+    if (!cache) {
+        return;
+    }
+
+    // Free sessions and wipe ticket keys
+    list_flush(&cache->sessions_by_age);
+    mem_deref(cache->sessions);
+    OPENSSL_cleanse(cache->ticket_keys, sizeof(cache->ticket_keys));
+
+    // Un-reference
+    rawrtc_global.dtls_session_cache = mem_deref(cache);
+}
+
+/*
+ * Enable session resumption on a DTLS context.
+ * `fingerprint` is the local certificate's fingerprint and is being
+ * used as session ID context.
+ */
+enum rawrtc_code rawrtc_dtls_session_cache_attach(
+        struct tls* const tls,
+        uint8_t const* const fingerprint,
+        size_t const fingerprint_length
+) {
+    SSL_CTX* ssl_context;
+
+    // Check arguments
+    if (!tls || !fingerprint || fingerprint_length > SSL_MAX_SID_CTX_LENGTH) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set session ID context (required as client certificates are being requested)
+    ssl_context = tls_openssl_context(tls);
+    if (!SSL_CTX_set_session_id_context(
+            ssl_context, fingerprint, (unsigned int) fingerprint_length)) {
+        return RAWRTC_CODE_UNKNOWN_ERROR;
+    }
+
+    // Use external client session cache and stateless tickets on the server side
+    SSL_CTX_set_session_cache_mode(
+            ssl_context, SSL_SESS_CACHE_BOTH | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(ssl_context, new_session_handler);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ssl_context, ticket_key_handler);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ssl_context, ticket_key_handler);
+#endif
+    SSL_CTX_set_info_callback(ssl_context, info_handler);
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Select the cached session to be offered by the next client handshake
+ * depending on the remote fingerprints. Must be called right before
+ * initiating a DTLS connection and with `NULL` afterwards.
+ */
+void rawrtc_dtls_session_cache_select(
+        struct rawrtc_dtls_fingerprints* const fingerprints // nullable
+) {
+    struct rawrtc_dtls_session_cache* const cache = rawrtc_global.dtls_session_cache;
+    size_t i;
+    struct rawrtc_dtls_session* session;
+
+    // Reset
+    cache->selected = NULL;
+    if (!fingerprints) {
+        return;
+    }
+
+    // Find session by SHA-256 fingerprint
+    for (i = 0; i < fingerprints->n_fingerprints; ++i) {
+        struct rawrtc_dtls_fingerprint* const fingerprint = fingerprints->fingerprints[i];
+        if (fingerprint->algorithm != RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA256
+                || fingerprint->value_binary_length != 32) {
+            continue;
+        }
+
+        // Lookup
+        session = session_lookup(cache, fingerprint->value_binary);
+        if (!session) {
+            continue;
+        }
+
+        // Expired?
+        if (SSL_SESSION_get_time(session->session) + SSL_SESSION_get_timeout(session->session)
+                <= (long) time(NULL)) {
+            DEBUG_PRINTF("Removing expired client session\n");
+            mem_deref(session);
+            continue;
+        }
+
+        // Select
+        DEBUG_PRINTF("Offering cached client session\n");
+        cache->selected = session->session;
+        return;
+    }
+}
+
+/*
+ * Get the amount of resumed (hits) and full (misses) DTLS handshakes.
+ */
+enum rawrtc_code rawrtc_dtls_session_cache_get_counters(
+        uint64_t* const hitsp, // de-referenced
+        uint64_t* const missesp // de-referenced
+) {
+    struct rawrtc_dtls_session_cache* const cache = rawrtc_global.dtls_session_cache;
+
+    // Check arguments
+    if (!hitsp || !missesp) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (!cache) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Set pointers
+    *hitsp = cache->hits;
+    *missesp = cache->misses;
+    return RAWRTC_CODE_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <openssl/ssl.h> // SSL_SESSION
+#include <rawrtc.h>
+
+/*
+ * Maximum amount of cached client sessions.
+ */
+enum {
+    RAWRTC_DTLS_SESSION_CACHE_SIZE = 256,
+    RAWRTC_DTLS_TICKET_KEY_LIFETIME = 12 * 3600 * 1000, // in milliseconds
+};
+
+/*
+ * Session ticket key (server side).
+ */
+struct rawrtc_dtls_ticket_key {
+    bool valid;
+    uint8_t name[16];
+    uint8_t aes_key[32];
+    uint8_t hmac_key[32];
+};
+
+/*
+ * Cached client session, keyed by the remote certificate's SHA-256
+ * fingerprint.
+ */
+struct rawrtc_dtls_session {
+    struct le le;
+    struct le age_le;
+    uint8_t fingerprint[32];
+    SSL_SESSION* session;
+};
+
+/*
+ * DTLS session resumption state.
+ */
+struct rawrtc_dtls_session_cache {
+    struct hash* sessions;
+    struct list sessions_by_age;
+    SSL_SESSION* selected; // not referenced, nullable
+    struct rawrtc_dtls_ticket_key ticket_keys[2]; // current, previous
+    uint64_t ticket_key_created;
+    uint64_t hits;
+    uint64_t misses;
+};
+
+enum rawrtc_code rawrtc_dtls_session_cache_init();
+
+void rawrtc_dtls_session_cache_close();
+
+enum rawrtc_code rawrtc_dtls_session_cache_attach(
+    struct tls* const tls,
+    uint8_t const* const fingerprint,
+    size_t const fingerprint_length
+);
+
+void rawrtc_dtls_session_cache_select(
+    struct rawrtc_dtls_fingerprints* const fingerprints // nullable
+);
@@ -1,9 +1,14 @@
 #include <string.h> // memcmp
+#include <openssl/crypto.h> // CRYPTO_memcmp
 #include <rawrtc.h>
 #include "dtls_transport.h"
+#include "dtls_context.h"
+#include "dtls_session.h"
 #include "dtls_parameters.h"
 #include "message_buffer.h"
 #include "candidate_helper.h"
+#include "tcp_framing.h"
+#include "ice_transport.h"
 #include "certificate.h"
 #include "utils.h"
 
@@ -11,64 +16,6 @@
 //#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
 #include "debug.h"
 
-/*
- * Embedded DH parameters in DER encoding (bits: 2048)
- */
-uint8_t const rawrtc_default_dh_parameters[] = {
-    0x30, 0x82, 0x01, 0x08, 0x02, 0x82, 0x01, 0x01, 0x00, 0xaa, 0x4c, 0x1f,
-    0x1e, 0xc9, 0xed, 0xfe, 0x5c, 0x50, 0x2d, 0xff, 0xf4, 0x95, 0xf4, 0x80,
-    0x69, 0xcf, 0xc3, 0x84, 0x29, 0x87, 0xd5, 0x2c, 0x4f, 0xf6, 0x9e, 0x88,
-    0xa2, 0x5b, 0x61, 0xd2, 0x7d, 0x78, 0x97, 0xce, 0x47, 0x39, 0x9d, 0xc0,
-    0x95, 0x14, 0x98, 0x1f, 0xa9, 0xa3, 0x42, 0x93, 0x58, 0x49, 0x3d, 0xad,
-    0xeb, 0x6c, 0x3d, 0x79, 0x2d, 0x27, 0x94, 0x67, 0x4c, 0xdc, 0x94, 0x31,
-    0xbf, 0xc1, 0x00, 0x9d, 0x96, 0x4a, 0x91, 0xa7, 0x4f, 0xab, 0x48, 0x44,
-    0xcc, 0x54, 0x1a, 0x4e, 0x2a, 0x8e, 0xa1, 0x81, 0x4b, 0xeb, 0xea, 0xc3,
-    0xba, 0xd6, 0x03, 0xfb, 0xf2, 0x9a, 0x48, 0x1f, 0xc8, 0xba, 0x73, 0x89,
-    0x86, 0x25, 0x2e, 0xba, 0x10, 0x80, 0x2a, 0xeb, 0xf9, 0xe2, 0x28, 0xf1,
-    0xcf, 0x85, 0x0d, 0xeb, 0x2f, 0x61, 0x51, 0x11, 0xe1, 0xe7, 0x82, 0xe5,
-    0xa7, 0x5d, 0x71, 0x0a, 0xef, 0x8a, 0xe1, 0x97, 0x48, 0x41, 0xac, 0xd7,
-    0xc5, 0xf7, 0xce, 0xd5, 0xcd, 0x66, 0x1e, 0x6b, 0x0e, 0x82, 0x4e, 0x77,
-    0x5d, 0x89, 0x3b, 0xe2, 0x94, 0x7a, 0x10, 0xee, 0x5b, 0x5d, 0x36, 0x07,
-    0x29, 0x8b, 0x06, 0xb6, 0x49, 0x1e, 0x17, 0x17, 0x57, 0xc8, 0xc1, 0x80,
-    0x24, 0x15, 0x22, 0x9c, 0xb8, 0x59, 0x55, 0x08, 0x41, 0x67, 0x07, 0xca,
-    0xa8, 0x54, 0x1a, 0xd1, 0xb7, 0x91, 0x2f, 0x41, 0x78, 0xc0, 0xcd, 0x2f,
-    0x07, 0x49, 0x4b, 0xb9, 0x05, 0xf4, 0xea, 0x72, 0x3a, 0xcf, 0x04, 0x69,
-    0xcb, 0x5b, 0xe4, 0xcb, 0x4f, 0x72, 0x40, 0xe4, 0x56, 0x1f, 0xca, 0xee,
-    0x33, 0x2b, 0x29, 0x1a, 0x80, 0xda, 0x01, 0x3f, 0x03, 0xa6, 0xbf, 0x32,
-    0x02, 0x6c, 0xfb, 0xb1, 0xb5, 0x81, 0xda, 0x32, 0x6f, 0xa1, 0x4b, 0x9f,
-    0x42, 0x2e, 0x17, 0xc9, 0x95, 0x30, 0xda, 0x16, 0xb7, 0x9a, 0x7c, 0xf4,
-    0x83, 0x02, 0x01, 0x02
-};
-size_t const rawrtc_default_dh_parameters_length = ARRAY_SIZE(rawrtc_default_dh_parameters);
-
-/*
- * List of default DTLS cipher suites.
- */
-char const* rawrtc_default_dtls_cipher_suites[] = {
-    "ECDHE-ECDSA-CHACHA20-POLY1305",
-    "ECDHE-RSA-CHACHA20-POLY1305",
-    "ECDHE-ECDSA-AES128-GCM-SHA256", // recommended
-    "ECDHE-RSA-AES128-GCM-SHA256",
-    "ECDHE-ECDSA-AES256-GCM-SHA384",
-    "ECDHE-RSA-AES256-GCM-SHA384",
-    "DHE-RSA-AES128-GCM-SHA256",
-    "DHE-RSA-AES256-GCM-SHA384",
-    "ECDHE-ECDSA-AES128-SHA256",
-    "ECDHE-RSA-AES128-SHA256",
-    "ECDHE-ECDSA-AES128-SHA", // required
-    "ECDHE-RSA-AES256-SHA384",
-    "ECDHE-RSA-AES128-SHA",
-    "ECDHE-ECDSA-AES256-SHA384",
-    "ECDHE-ECDSA-AES256-SHA",
-    "ECDHE-RSA-AES256-SHA",
-    "DHE-RSA-AES128-SHA256",
-    "DHE-RSA-AES128-SHA",
-    "DHE-RSA-AES256-SHA256",
-    "DHE-RSA-AES256-SHA"
-};
-size_t const rawrtc_default_dtls_cipher_suites_length =
-        ARRAY_SIZE(rawrtc_default_dtls_cipher_suites);
-
 /*
  * Get the corresponding name for an ICE transport state.
  */
@@ -138,6 +85,9 @@ static void set_state(
 
     // Connected?
     if (state == RAWRTC_DTLS_TRANSPORT_STATE_CONNECTED) {
+        // Update timeline
+        rawrtc_timestamp_once(&transport->ice_transport->timeline.dtls_connected);
+
         // Send buffered outgoing DTLS messages
         enum rawrtc_code const error = rawrtc_message_buffer_clear(
                 &transport->buffered_messages_out, dtls_outgoing_buffer_handler, transport);
@@ -244,8 +194,8 @@ static void verify_certificate(
     enum rawrtc_code error = RAWRTC_CODE_SUCCESS;
     bool valid = false;
     enum tls_fingerprint algorithm;
-    uint8_t expected_fingerprint[RAWRTC_FINGERPRINT_MAX_SIZE];
-    uint8_t actual_fingerprint[RAWRTC_FINGERPRINT_MAX_SIZE];
+    uint8_t actual_fingerprints[TLS_FINGERPRINT_SHA256 + 1][RAWRTC_FINGERPRINT_MAX_SIZE];
+    bool have_actual_fingerprint[TLS_FINGERPRINT_SHA256 + 1] = {false};
 
     // Verify the peer's certificate
     // TODO: Fix this. Testing the fingerprint alone is okay for now though.
@@ -256,12 +206,15 @@ static void verify_certificate(
 //    DEBUG_PRINTF("Peer's certificate verified\n");
 
     // Check if any of the fingerprints provided matches
-    // TODO: Is this correct?
+    // Note: Binary values have been parsed when the fingerprints were created.
     for (i = 0; i < transport->remote_parameters->fingerprints->n_fingerprints; ++i) {
         struct rawrtc_dtls_fingerprint* const fingerprint =
                 transport->remote_parameters->fingerprints->fingerprints[i];
-        size_t length;
-        size_t bytes_written;
+
+        // Invalid or unsupported value?
+        if (fingerprint->value_binary_length == 0) {
+            continue;
+        }
 
         // Get algorithm
         error = rawrtc_certificate_sign_algorithm_to_tls_fingerprint(
@@ -273,47 +226,23 @@ static void verify_certificate(
             goto out;
         }
 
-        // Get algorithm digest size
-        error = rawrtc_get_sign_algorithm_length(&length, fingerprint->algorithm);
-        if (error) {
-            if (error == RAWRTC_CODE_UNSUPPORTED_ALGORITHM) {
-                continue;
+        // Get remote fingerprint (once per algorithm)
+        if (!have_actual_fingerprint[algorithm]) {
+            error = rawrtc_error_to_code(tls_peer_fingerprint(
+                    transport->connection, algorithm, actual_fingerprints[algorithm],
+                    sizeof(actual_fingerprints[algorithm])));
+            if (error) {
+                goto out;
             }
-            goto out;
+            have_actual_fingerprint[algorithm] = true;
         }
 
-        // Convert hex-encoded value to binary
-        error = rawrtc_colon_hex_to_bin(
-                &bytes_written, expected_fingerprint, length, fingerprint->value);
-        if (error) {
-            if (error == RAWRTC_CODE_INSUFFICIENT_SPACE) {
-                DEBUG_WARNING("Hex-encoded fingerprint exceeds buffer size!\n");
-            } else {
-                DEBUG_WARNING("Could not convert hex-encoded fingerprint to binary, reason: %s\n",
-                        rawrtc_code_to_str(error));
-            }
-            continue;
-        }
-
-        // Validate length
-        if (bytes_written != length) {
-            DEBUG_WARNING("Hex-encoded fingerprint should have been %zu bytes but was %zu bytes\n",
-                    length, bytes_written);
-            continue;
-        }
-
-        // Get remote fingerprint
-        error = rawrtc_error_to_code(tls_peer_fingerprint(
-                transport->connection, algorithm, actual_fingerprint, sizeof(actual_fingerprint)));
-        if (error) {
-            goto out;
-        }
-
-        // Compare fingerprints
-        // TODO: Constant-time equality comparison needed?
-        if (memcmp(expected_fingerprint, actual_fingerprint, length) == 0) {
+        // Compare fingerprints (constant-time)
+        if (CRYPTO_memcmp(fingerprint->value_binary, actual_fingerprints[algorithm],
+                          fingerprint->value_binary_length) == 0) {
             DEBUG_PRINTF("Peer's certificate fingerprint is valid\n");
             valid = true;
+            break;
         }
     }
 
@@ -397,7 +326,8 @@ static void connect_handler(
 
         // Accept and create connection
         DEBUG_PRINTF("Accepting incoming DTLS connection from %J\n", peer);
-        err = dtls_accept(&transport->connection, transport->context, transport->socket,
+        rawrtc_timestamp_once(&transport->ice_transport->timeline.dtls_client_hello);
+        err = dtls_accept(&transport->connection, transport->context->tls, transport->socket,
                           establish_handler, dtls_receive_handler, close_handler, transport);
         if (err) {
             DEBUG_WARNING("Could not accept incoming DTLS connection, reason: %m\n", err);
@@ -419,11 +349,22 @@ static enum rawrtc_code do_connect(
         struct rawrtc_dtls_transport* const transport,
         const struct sa* const peer
 ) {
+    int err;
+
+    // Select cached session to resume (if any)
+    rawrtc_dtls_session_cache_select(
+            transport->remote_parameters ? transport->remote_parameters->fingerprints : NULL);
+
     // Connect
     DEBUG_PRINTF("Starting DTLS connection to %J\n", peer);
-    return rawrtc_error_to_code(dtls_connect(
-            &transport->connection, transport->context, transport->socket, peer,
-            establish_handler, dtls_receive_handler, close_handler, transport));
+    rawrtc_timestamp_once(&transport->ice_transport->timeline.dtls_client_hello);
+    err = dtls_connect(
+            &transport->connection, transport->context->tls, transport->socket, peer,
+            establish_handler, dtls_receive_handler, close_handler, transport);
+
+    // Reset selected session
+    rawrtc_dtls_session_cache_select(NULL);
+    return rawrtc_error_to_code(err);
 }
 
 /*
@@ -436,38 +377,34 @@ static int send_handler(
         void* arg
 ) {
     struct rawrtc_dtls_transport* const transport = arg;
-    struct trice* const ice = transport->ice_transport->gatherer->ice;
-    bool closed = is_closed(transport);
     (void) tc; (void) original_destination;
 
     // Note: No need to check if closed as only non-application data may be sent if the
     //       transport is already closed.
 
-    // Get selected candidate pair
-    struct ice_candpair* const candidate_pair = list_ledata(list_head(trice_validl(ice)));
-    if (!candidate_pair) {
-        if (!closed) {
-            DEBUG_WARNING("Cannot send message, no selected candidate pair\n");
+    // Send framed (if the selected candidate pair uses TCP)
+    if (transport->route_framing) {
+        enum rawrtc_code const error = rawrtc_tcp_framing_send(transport->route_framing, buffer);
+        if (error) {
+            DEBUG_WARNING("Could not send, reason: %s\n", rawrtc_code_to_str(error));
+            return EIO;
         }
-        return ECONNRESET;
+        return 0;
     }
 
-    // Get local candidate's UDP socket
-    // TODO: What about TCP?
-    struct udp_sock* const udp_socket = trice_lcand_sock(ice, candidate_pair->lcand);
-    if (!udp_socket) {
-        if (!closed) {
-            DEBUG_WARNING("Cannot send message, selected candidate pair has no socket\n");
+    // Get cached route of the selected candidate pair
+    if (!transport->route_socket) {
+        if (!is_closed(transport)) {
+            DEBUG_WARNING("Cannot send message, no selected candidate pair\n");
         }
         return ECONNRESET;
     }
 
     // Send
     // TODO: Is destination correct?
-    DEBUG_PRINTF("Sending DTLS message (%zu bytes) to %J (originally: %J) from %J\n",
-                 mbuf_get_left(buffer), &candidate_pair->rcand->attr.addr, original_destination,
-                 &candidate_pair->lcand->attr.addr);
-    int err = udp_send(udp_socket, &candidate_pair->rcand->attr.addr, buffer);
+    DEBUG_PRINTF("Sending DTLS message (%zu bytes) to %J (originally: %J)\n",
+                 mbuf_get_left(buffer), &transport->route_address, original_destination);
+    int err = udp_send(transport->route_socket, &transport->route_address, buffer);
     if (err) {
         DEBUG_WARNING("Could not send, error: %m\n", err);
     }
@@ -486,6 +423,50 @@ static size_t mtu_handler(
     return 1400;
 }
 
+/*
+ * Get the remote address of a candidate pair.
+ * Note: For TCP, this is the peer of the connection as active
+ *       candidates are being announced with the discard port.
+ */
+static void get_remote_address(
+        struct sa* const address, // not checked
+        struct ice_candpair* const candidate_pair // not checked
+) {
+    if (candidate_pair->lcand->attr.proto == IPPROTO_TCP && candidate_pair->tc
+            && !tcp_conn_peer_get(candidate_pair->tc, address)) {
+        return;
+    }
+    sa_cpy(address, &candidate_pair->rcand->attr.addr);
+}
+
+/*
+ * Check if an address belongs to a remote candidate of a valid
+ * (checked) candidate pair.
+ */
+static bool is_validated_remote_address(
+        struct rawrtc_dtls_transport* const transport,
+        struct sa const* const address
+) {
+    struct le* le;
+
+    // No ICE agent?
+    if (!transport->ice_transport->gatherer->ice) {
+        return false;
+    }
+
+    // Find remote candidate in valid list
+    for (le = list_head(rawrtc_ice_transport_valid_candidate_pairs(transport->ice_transport));
+            le != NULL; le = le->next) {
+        struct ice_candpair* const candidate_pair = le->data;
+        struct sa remote_address;
+        get_remote_address(&remote_address, candidate_pair);
+        if (sa_cmp(&remote_address, address, SA_ALL)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 /*
  * Handle received UDP messages.
  */
@@ -498,20 +479,24 @@ static bool udp_receive_handler(
     struct sa* source = context;
     struct sa const* peer;
 
-    // TODO: Check if DTLS or SRTP packet
+    // Note: Packets have already been classified as DTLS by the candidate helper
     // TODO: This handler should also be moved into ICE transport
-    // https://tools.ietf.org/search/rfc7983#section-7
 
-    // Update remote peer address (if changed and connection exists)
-    if (transport->connection) {
-        // TODO: It would be cleaner to check if source is in our list of remote candidates
+    // Drop packets from sources that did not pass ICE connectivity checks
+    // Note: Otherwise, anyone able to spoof a packet could redirect the connection or
+    //       trigger the connect handler (and its logging) at will. Dropped handshake
+    //       packets will be retransmitted by the peer once the candidate pair is valid.
+    peer = transport->connection ? dtls_peer(transport->connection) : NULL;
+    if (!peer || !sa_cmp(peer, source, SA_ALL)) {
+        if (!is_validated_remote_address(transport, source)) {
+            DEBUG_PRINTF("Dropping DTLS packet from unvalidated source %J\n", source);
+            return true;
+        }
 
+        // Update remote peer address (if changed and connection exists)
         // TODO: SCTP - Retest path MTU and reset congestion state to the initial state
         // https://tools.ietf.org/html/draft-ietf-rtcweb-data-channel-13#section-5
-
-        // Update if changed
-        peer = dtls_peer(transport->connection);
-        if (!sa_cmp(peer, source, SA_ALL)) {
+        if (peer) {
             DEBUG_PRINTF("Remote changed its peer address from %J to %J\n", peer, source);
             dtls_set_peer(transport->connection, source);
         }
@@ -549,6 +534,7 @@ static void rawrtc_dtls_transport_destroy(
 ) {
     struct rawrtc_dtls_transport* const transport = arg;
     struct le* le;
+    size_t i;
 
     // Stop transport
     // TODO: Check effects in case transport has been destroyed due to error in create
@@ -558,11 +544,13 @@ static void rawrtc_dtls_transport_destroy(
     for (le = list_head(&transport->ice_transport->gatherer->local_candidates);
          le != NULL; le = le->next) {
         struct rawrtc_candidate_helper* const candidate_helper = le->data;
-        mem_deref(candidate_helper->udp_helper);
+        rawrtc_candidate_helper_unset_receive_handler(candidate_helper);
         // TODO: Be aware that UDP packets go to nowhere now...
     }
 
     // Un-reference
+    mem_deref(transport->route_framing);
+    mem_deref(transport->route_socket);
     mem_deref(transport->connection);
     mem_deref(transport->socket);
     mem_deref(transport->context);
@@ -570,7 +558,10 @@ static void rawrtc_dtls_transport_destroy(
     list_flush(&transport->buffered_messages_out);
     list_flush(&transport->buffered_messages_in);
     mem_deref(transport->remote_parameters);
-    list_flush(&transport->certificates);
+    for (i = 0; i < transport->n_certificates; ++i) {
+        mem_deref(transport->certificates[i]);
+    }
+    mem_deref(transport->certificates);
     mem_deref(transport->ice_transport);
 }
 
@@ -580,7 +571,7 @@ static void rawrtc_dtls_transport_destroy(
 enum rawrtc_code rawrtc_dtls_transport_create(
         struct rawrtc_dtls_transport** const transportp, // de-referenced
         struct rawrtc_ice_transport* const ice_transport, // referenced
-        struct rawrtc_certificate* const certificates[], // copied (each item)
+        struct rawrtc_certificate* const certificates[], // referenced (each item)
         size_t const n_certificates,
         rawrtc_dtls_transport_state_change_handler* const state_change_handler, // nullable
         rawrtc_dtls_transport_error_handler* const error_handler, // nullable
@@ -591,8 +582,6 @@ enum rawrtc_code rawrtc_dtls_transport_create(
     struct rawrtc_certificate* certificate;
     enum rawrtc_code error;
     struct le* le;
-    uint8_t* certificate_der;
-    size_t certificate_der_length;
 
     // Check arguments
     if (!transportp || !ice_transport || !certificates || !n_certificates) {
@@ -620,7 +609,6 @@ enum rawrtc_code rawrtc_dtls_transport_create(
     // Set fields/reference
     transport->state = RAWRTC_DTLS_TRANSPORT_STATE_NEW; // TODO: Raise state (delayed)?
     transport->ice_transport = mem_ref(ice_transport);
-    list_init(&transport->certificates);
     transport->state_change_handler = state_change_handler;
     transport->error_handler = error_handler;
     transport->arg = arg;
@@ -629,8 +617,16 @@ enum rawrtc_code rawrtc_dtls_transport_create(
     list_init(&transport->buffered_messages_in);
     list_init(&transport->buffered_messages_out);
     list_init(&transport->fingerprints);
-
-    // Append and reference certificates
+    sa_init(&transport->route_address, AF_UNSPEC);
+
+    // Reference certificates
+    // Note: Certificates are immutable and can therefore be shared
+    transport->certificates = mem_zalloc(
+            sizeof(*transport->certificates) * n_certificates, NULL);
+    if (!transport->certificates) {
+        error = RAWRTC_CODE_NO_MEMORY;
+        goto out;
+    }
     for (i = 0; i < n_certificates; ++i) {
         // Null?
         if (certificates[i] == NULL) {
@@ -638,64 +634,21 @@ enum rawrtc_code rawrtc_dtls_transport_create(
             goto out;
         }
 
-        // Copy certificate
-        // Note: Copying is needed as the 'le' element cannot be associated to multiple lists
-        error = rawrtc_certificate_copy(&certificate, certificates[i]);
-        if (error) {
-            goto out;
-        }
-
-        // Append to list
-        list_append(&transport->certificates, &certificate->le, certificate);
+        // Reference certificate
+        transport->certificates[i] = mem_ref(certificates[i]);
+        ++transport->n_certificates;
     }
 
-    // Create (D)TLS context
-    DEBUG_PRINTF("Creating DTLS context\n");
-    error = rawrtc_error_to_code(tls_alloc(&transport->context, TLS_METHOD_DTLS, NULL, NULL));
-    if (error) {
-        goto out;
-    }
-
-    // Get DER encoded certificate of choice
+    // Get (shared) DTLS context with default cipher suites
     // TODO: Which certificate should we use?
-    certificate = list_ledata(list_head(&transport->certificates));
-    error = rawrtc_certificate_get_der(
-            &certificate_der, &certificate_der_length, certificate, RAWRTC_CERTIFICATE_ENCODE_BOTH);
-    if (error) {
-        goto out;
-    }
-
-    // Set certificate
-    DEBUG_PRINTF("Setting certificate on DTLS context\n");
-    error = rawrtc_error_to_code(tls_set_certificate_der(
-            transport->context, rawrtc_certificate_key_type_to_tls_keytype(certificate->key_type),
-            certificate_der, certificate_der_length, NULL, 0));
-    mem_deref(certificate_der);
-    if (error) {
-        goto out;
-    }
-
-    // Set Diffie-Hellman parameters
-    // TODO: Get DH params from config
-    DEBUG_PRINTF("Setting DH parameters on DTLS context\n");
-    error = rawrtc_error_to_code(tls_set_dh_params_der(transport->context,
-            rawrtc_default_dh_parameters, rawrtc_default_dh_parameters_length));
-    if (error) {
-        goto out;
-    }
-
-    // Set cipher suites
-    // TODO: Get cipher suites from config
-    DEBUG_PRINTF("Setting cipher suites on DTLS context\n");
-    error = rawrtc_error_to_code(tls_set_ciphers(transport->context,
-            rawrtc_default_dtls_cipher_suites, rawrtc_default_dtls_cipher_suites_length));
+    certificate = transport->certificates[0];
+    error = rawrtc_dtls_context_get(
+            &transport->context, certificate, rawrtc_default_dtls_cipher_suites,
+            rawrtc_default_dtls_cipher_suites_length);
     if (error) {
         goto out;
     }
 
-    // Send client certificate (client) / request client certificate (server)
-    tls_set_verify_client(transport->context);
-
     // Create DTLS socket
     DEBUG_PRINTF("Creating DTLS socket\n");
     error = rawrtc_error_to_code(dtls_socketless(
@@ -704,8 +657,12 @@ enum rawrtc_code rawrtc_dtls_transport_create(
         goto out;
     }
 
+    // Reserve space for TURN framing (relayed candidate pairs)
+    dtls_set_headroom(transport->socket, RAWRTC_DTLS_TRANSPORT_HEADROOM);
+
     // Attach to existing candidate pairs
-    for (le = list_head(trice_validl(ice_transport->gatherer->ice)); le != NULL; le = le->next) {
+    for (le = list_head(rawrtc_ice_transport_valid_candidate_pairs(ice_transport));
+            le != NULL; le = le->next) {
         struct ice_candpair* candidate_pair = le->data;
         error = rawrtc_dtls_transport_add_candidate_pair(transport, candidate_pair);
         if (error) {
@@ -729,6 +686,42 @@ out:
     return error;
 }
 
+/*
+ * Set the cipher suites (OpenSSL names, in order of preference) to be
+ * used by the DTLS transport. Must be called before the transport is
+ * being started.
+ */
+enum rawrtc_code rawrtc_dtls_transport_set_cipher_suites(
+        struct rawrtc_dtls_transport* const transport,
+        char const* cipher_suites[], // copied
+        size_t const n_cipher_suites
+) {
+    struct rawrtc_dtls_context* context;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!transport || !cipher_suites || !n_cipher_suites) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (transport->remote_parameters || is_closed(transport)) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Get (shared) DTLS context
+    error = rawrtc_dtls_context_get(
+            &context, transport->certificates[0], cipher_suites, n_cipher_suites);
+    if (error) {
+        return error;
+    }
+
+    // Replace context
+    mem_deref(transport->context);
+    transport->context = context;
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Let the DTLS transport attach itself to a candidate pair.
  * TODO: Separate ICE transport and DTLS transport properly (like data transport)
@@ -754,7 +747,8 @@ enum rawrtc_code rawrtc_dtls_transport_add_candidate_pair(
 
     // Find candidate helper
     error = rawrtc_candidate_helper_find(
-            &candidate_helper, &transport->ice_transport->gatherer->local_candidates,
+            &candidate_helper,
+            transport->ice_transport->gatherer->local_candidates_by_re_candidate,
             candidate_pair->lcand);
     if (error) {
         DEBUG_WARNING("Could not find matching candidate helper for candidate pair, reason: %s\n",
@@ -780,9 +774,28 @@ enum rawrtc_code rawrtc_dtls_transport_add_candidate_pair(
         goto out;
     }
 
+    // Attach framing to the connection (if TCP)
+    if (candidate_pair->lcand->attr.proto == IPPROTO_TCP) {
+        struct rawrtc_tcp_framing* framing;
+        if (!candidate_pair->tc) {
+            DEBUG_WARNING("TCP candidate pair has no connection\n");
+            error = RAWRTC_CODE_NO_SOCKET;
+            goto out;
+        }
+        error = rawrtc_candidate_helper_get_tcp_framing(
+                &framing, candidate_helper, candidate_pair->tc);
+        if (error) {
+            DEBUG_WARNING("Could not attach framing to candidate pair, reason: %s\n",
+                          rawrtc_code_to_str(error));
+            goto out;
+        }
+    }
+
     // Do connect (if client and no connection)
     if (transport->role == RAWRTC_DTLS_ROLE_CLIENT && !transport->connection) {
-        error = do_connect(transport, &candidate_pair->rcand->attr.addr);
+        struct sa remote_address;
+        get_remote_address(&remote_address, candidate_pair);
+        error = do_connect(transport, &remote_address);
         if (error) {
             DEBUG_WARNING("Could not start DTLS connection for candidate pair, reason: %s\n",
                           rawrtc_code_to_str(error));
@@ -790,6 +803,12 @@ enum rawrtc_code rawrtc_dtls_transport_add_candidate_pair(
         }
     }
 
+    // Update cached route (the selected candidate pair may have changed)
+    error = rawrtc_dtls_transport_update_route(transport);
+    if (error) {
+        goto out;
+    }
+
 out:
     if (!error) {
         DEBUG_PRINTF("Attached DTLS transport to candidate pair\n");
@@ -797,6 +816,96 @@ out:
     return error;
 }
 
+/*
+ * Update the cached route (local socket and remote address) from the
+ * selected candidate pair of the ICE transport.
+ * Note: This needs to be called whenever the selected candidate pair changes (nomination, a
+ *       candidate pair failed). The cache is cleared if there is no selected candidate pair
+ *       (unless an ICE restart is in progress).
+ */
+enum rawrtc_code rawrtc_dtls_transport_update_route(
+        struct rawrtc_dtls_transport* const transport
+) {
+    struct trice* ice;
+    struct ice_candpair* candidate_pair;
+    struct udp_sock* udp_socket = NULL;
+    struct rawrtc_tcp_framing* framing = NULL;
+    struct rawrtc_candidate_helper* candidate_helper;
+    struct sa remote_address;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!transport) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Get selected candidate pair (if any)
+    ice = transport->ice_transport->gatherer->ice;
+    candidate_pair = ice ? rawrtc_ice_transport_selected_candidate_pair(
+            transport->ice_transport) : NULL;
+
+    // Keep the previous session's route until the restarted session selected a candidate pair
+    // (RFC 8445, section 9)
+    if (!candidate_pair && transport->ice_transport->gatherer->previous_ice) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Get local candidate's UDP socket or the framing of the TCP connection
+    if (candidate_pair && candidate_pair->lcand->attr.proto == IPPROTO_TCP) {
+        error = rawrtc_candidate_helper_find(
+                &candidate_helper,
+                transport->ice_transport->gatherer->local_candidates_by_re_candidate,
+                candidate_pair->lcand);
+        if (!error && candidate_pair->tc) {
+            error = rawrtc_candidate_helper_get_tcp_framing(
+                    &framing, candidate_helper, candidate_pair->tc);
+        }
+        if (error || !framing) {
+            DEBUG_WARNING("Selected candidate pair has no framed connection\n");
+        }
+    } else if (candidate_pair) {
+        udp_socket = trice_lcand_sock(ice, candidate_pair->lcand);
+        if (!udp_socket) {
+            DEBUG_WARNING("Selected candidate pair has no socket\n");
+        }
+    }
+
+    // Get remote address
+    if (udp_socket || framing) {
+        get_remote_address(&remote_address, candidate_pair);
+    }
+
+    // Unchanged?
+    if (udp_socket == transport->route_socket && framing == transport->route_framing
+            && (!(udp_socket || framing)
+                || sa_cmp(&transport->route_address, &remote_address, SA_ALL))) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Send anything batched on the previous route
+    if (transport->route_framing) {
+        rawrtc_tcp_framing_flush(transport->route_framing);
+    }
+
+    // Replace cached route
+    mem_deref(transport->route_socket);
+    mem_deref(transport->route_framing);
+    if (udp_socket || framing) {
+        transport->route_socket = mem_ref(udp_socket);
+        transport->route_framing = mem_ref(framing);
+        sa_cpy(&transport->route_address, &remote_address);
+        DEBUG_PRINTF("Selected route: %J -> %J (%s)\n",
+                     &candidate_pair->lcand->attr.addr, &transport->route_address,
+                     net_proto2name(candidate_pair->lcand->attr.proto));
+    } else {
+        transport->route_socket = NULL;
+        transport->route_framing = NULL;
+        sa_init(&transport->route_address, AF_UNSPEC);
+        DEBUG_PRINTF("Cleared route\n");
+    }
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Start the DTLS transport.
  */
@@ -870,12 +979,14 @@ enum rawrtc_code rawrtc_dtls_transport_start(
         }
 
         // Get selected candidate pair
-        struct ice_candpair* const candidate_pair = list_ledata(list_head(trice_validl(
-                transport->ice_transport->gatherer->ice)));
+        struct ice_candpair* const candidate_pair = rawrtc_ice_transport_selected_candidate_pair(
+                transport->ice_transport);
 
         // Do connect (if we have a valid candidate pair)
         if (candidate_pair) {
-            error = do_connect(transport, &candidate_pair->rcand->attr.addr);
+            struct sa remote_address;
+            get_remote_address(&remote_address, candidate_pair);
+            error = do_connect(transport, &remote_address);
             if (error) {
                 goto out;
             }
@@ -1004,6 +1115,11 @@ enum rawrtc_code rawrtc_dtls_transport_clear_data_transport(
 
 /*
  * Send a data message over the DTLS transport.
+ * Note: Record protection happens inline on the event loop thread. It
+ *       cannot be moved to worker threads as the OpenSSL connection
+ *       (owned by re) must not be used concurrently and record sequence
+ *       numbers are assigned while encrypting. Crypto throughput scales
+ *       by distributing transports across processes instead.
  */
 enum rawrtc_code rawrtc_dtls_transport_send(
         struct rawrtc_dtls_transport* const transport,
@@ -1071,7 +1187,7 @@ enum rawrtc_code rawrtc_dtls_transport_get_local_parameters(
 ) {
     // TODO: Get config from struct
     enum rawrtc_certificate_sign_algorithm const algorithm = rawrtc_default_config.sign_algorithm;
-    struct le* le;
+    size_t i;
     struct rawrtc_dtls_fingerprint* fingerprint;
     enum rawrtc_code error;
 
@@ -1087,8 +1203,8 @@ enum rawrtc_code rawrtc_dtls_transport_get_local_parameters(
 
     // Lazy-create fingerprints
     if (list_isempty(&transport->fingerprints)) {
-        for (le = list_head(&transport->certificates); le != NULL; le = le->next) {
-            struct rawrtc_certificate* certificate = le->data;
+        for (i = 0; i < transport->n_certificates; ++i) {
+            struct rawrtc_certificate* const certificate = transport->certificates[i];
 
             // Create fingerprint
             error = rawrtc_dtls_fingerprint_create_empty(&fingerprint, algorithm);
@@ -1096,9 +1212,15 @@ enum rawrtc_code rawrtc_dtls_transport_get_local_parameters(
                 return error;
             }
 
-            // Get and set fingerprint of certificate
+            // Get and set fingerprint of certificate (hex-encoded and binary)
             error = rawrtc_certificate_get_fingerprint(&fingerprint->value, certificate, algorithm);
+            if (!error) {
+                error = rawrtc_certificate_get_fingerprint_bin(
+                        fingerprint->value_binary, &fingerprint->value_binary_length,
+                        certificate, algorithm);
+            }
             if (error) {
+                mem_deref(fingerprint);
                 return error;
             }
 
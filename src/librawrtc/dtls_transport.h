@@ -1,10 +1,20 @@
 #pragma once
 
+enum {
+    // Space reserved in front of outgoing DTLS records for TURN framing
+    // (a Send indication with an IPv6 peer address, ChannelData needs 4 bytes)
+    RAWRTC_DTLS_TRANSPORT_HEADROOM = 48,
+};
+
 enum rawrtc_code rawrtc_dtls_transport_add_candidate_pair(
     struct rawrtc_dtls_transport* const transport,
     struct ice_candpair* const candidate_pair
 );
 
+enum rawrtc_code rawrtc_dtls_transport_update_route(
+    struct rawrtc_dtls_transport* const transport
+);
+
 enum rawrtc_code rawrtc_dtls_transport_have_data_transport(
     bool* const have_data_transportp, // de-referenced
     struct rawrtc_dtls_transport* const transport
@@ -7,6 +7,9 @@
 #include "ice_candidate.h"
 #include "message_buffer.h"
 #include "candidate_helper.h"
+#include "udp_mux.h"
+#include "dns_cache.h"
+#include "interface_cache.h"
 
 #define DEBUG_MODULE "ice-gatherer"
 //#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
@@ -202,6 +205,127 @@ enum rawrtc_code rawrtc_ice_gather_options_create(
     return RAWRTC_CODE_SUCCESS;
 }
 
+/*
+ * Let host candidates share one UDP socket per interface on a fixed
+ * port with other ICE gatherers using the same port.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_set_udp_mux_port(
+        struct rawrtc_ice_gather_options* const options,
+        uint16_t const port
+) {
+    // Check arguments
+    if (!options || port == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set port
+    options->udp_mux_port = port;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Bind the UDP mux sockets with SO_REUSEPORT so that `n_shards`
+ * processes (each running its own event loop) can share the UDP mux
+ * port. `shard` is the index of the calling process' shard.
+ *
+ * If `n_shards` is greater than 1 (Linux only), the shard is encoded in
+ * the local username fragment so that incoming connectivity checks are
+ * steered to the shard owning the gatherer. Other packets are steered
+ * by remote address once the ICE agent checks it.
+ * Note: Shards must bind their UDP mux sockets in the order of their
+ *       index (before any traffic arrives) and keep them bound.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_set_udp_mux_shards(
+        struct rawrtc_ice_gather_options* const options,
+        uint16_t const n_shards,
+        uint16_t const shard
+) {
+    // Check arguments
+    if (!options || n_shards == 0 || n_shards > RAWRTC_UDP_MUX_MAX_SHARDS || shard >= n_shards) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set amount of shards and shard
+    options->udp_mux_shards = n_shards;
+    options->udp_mux_shard = shard;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Run as an ICE lite agent (RFC 8445, section 2.5): Only host
+ * candidates will be gathered, `iceLite` will be advertised in the local
+ * ICE parameters and the ICE transport will only respond to connectivity
+ * checks.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_set_ice_lite(
+        struct rawrtc_ice_gather_options* const options,
+        bool const ice_lite
+) {
+    // Check arguments
+    if (!options) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set ICE lite
+    options->ice_lite = ice_lite;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Resolve the ICE servers' hostnames ahead of gathering (e.g. at
+ * startup). Resolved addresses are being cached process-wide, so ICE
+ * gatherers do not have to wait for DNS queries.
+ */
+enum rawrtc_code rawrtc_ice_gather_options_resolve_servers(
+        struct rawrtc_ice_gather_options* const options
+) {
+    struct le* le;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!options) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    for (le = list_head(&options->ice_servers); le != NULL; le = le->next) {
+        struct rawrtc_ice_server* const server = le->data;
+        struct le* url_le;
+
+        for (url_le = list_head(&server->urls); url_le != NULL; url_le = url_le->next) {
+            struct rawrtc_ice_server_url* const url = url_le->data;
+            struct sa address;
+
+            // IP address? Nothing to resolve.
+            if (!sa_set(&address, &url->host, 0)) {
+                continue;
+            }
+
+            // Query A record (if IPv4 is enabled)
+            if (rawrtc_default_config.ipv4_enable) {
+                error = rawrtc_dns_cache_query(NULL, &url->host, DNS_TYPE_A, NULL, NULL);
+                if (error) {
+                    DEBUG_NOTICE("Unable to query A record, reason: %s\n",
+                                 rawrtc_code_to_str(error));
+                    // Continue - not considered critical
+                }
+            }
+
+            // Query AAAA record (if IPv6 is enabled)
+            if (rawrtc_default_config.ipv6_enable) {
+                error = rawrtc_dns_cache_query(NULL, &url->host, DNS_TYPE_AAAA, NULL, NULL);
+                if (error) {
+                    DEBUG_NOTICE("Unable to query AAAA record, reason: %s\n",
+                                 rawrtc_code_to_str(error));
+                    // Continue - not considered critical
+                }
+            }
+        }
+    }
+
+    // Done
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Parse ICE server's transport.
  */
@@ -370,8 +494,6 @@ static void rawrtc_ice_server_url_destroy(
     list_unlink(&url->le);
 
     // Un-reference
-    mem_deref(url->dns_aaaa_context);
-    mem_deref(url->dns_a_context);
     mem_deref(url->url);
 }
 
@@ -485,6 +607,7 @@ enum rawrtc_code rawrtc_ice_gather_options_add_server(
         }
 
         // Append URL to list
+        url->server = server;
         list_append(&server->urls, &url->le, url);
     }
 
@@ -515,53 +638,6 @@ out:
     return error;
 }
 
-/*
- * Destroy both ICE server URL DNS context (IPv4 and IPv6).
- */
-static void ice_url_destroy_dns_contexts(
-        struct rawrtc_ice_server_url* const url
-) {
-    // Destroy URL DNS IPv4 context (if any)
-    if (url->dns_a_context) {
-        url->dns_a_context = mem_deref(url->dns_a_context);
-    }
-
-    // Destroy URL DNS IPv6 context (if any)
-    if (url->dns_aaaa_context) {
-        url->dns_aaaa_context = mem_deref(url->dns_aaaa_context);
-    }
-}
-
-/*
- * Destroy an ICE server's URL DNS contexts.
- */
-static void ice_server_destroy_url_dns_contexts(
-        struct rawrtc_ice_server* const server // not checked
-) {
-    struct le* le;
-    for (le = list_head(&server->urls); le != NULL; le = le->next) {
-        struct rawrtc_ice_server_url* const url = le->data;
-
-        // Destroy URL DNS contexts (if any)
-        ice_url_destroy_dns_contexts(url);
-    }
-}
-
-/*
- * Destroy all ICE server URL DNS contexts.
- */
-static void ice_options_destroy_url_dns_contexts(
-        struct rawrtc_ice_gather_options* const options // not checked
-) {
-    struct le* le;
-    for (le = list_head(&options->ice_servers); le != NULL; le = le->next) {
-        struct rawrtc_ice_server* const server = le->data;
-
-        // Destroy URL DNS contexts
-        ice_server_destroy_url_dns_contexts(server);
-    }
-}
-
 /*
  * Destructor for URLs of the ICE gatherer.
  */
@@ -570,8 +646,11 @@ static void rawrtc_ice_server_url_dns_context_destroy(
 ) {
     struct rawrtc_ice_server_url_dns_context* const context = arg;
 
-    // Un-reference
-    mem_deref(context->dns_query);
+    // Remove from gatherer
+    list_unlink(&context->le);
+
+    // Un-reference (cancels the request)
+    mem_deref(context->dns_request);
     mem_deref(context->gatherer);
     mem_deref(context->url);
 }
@@ -608,29 +687,6 @@ enum rawrtc_code rawrtc_ice_server_url_dns_context_create(
     return RAWRTC_CODE_SUCCESS;
 }
 
-/*
- * Check if there are pending DNS queries for an ICE server.
- */
-static bool ice_server_dns_queries_pending(
-        struct rawrtc_ice_server_url** const urlp, // de-referenced, not checked
-        struct rawrtc_ice_server* const server // not checked
-) {
-    struct le* le;
-    for (le = list_head(&server->urls); le != NULL; le = le->next) {
-        struct rawrtc_ice_server_url* const url = le->data;
-
-        // DNS queries pending?
-        if (url->dns_a_context || url->dns_aaaa_context) {
-            // Set pointer
-            *urlp = url;
-            return true;
-        }
-    }
-
-    // No pending DNS queries
-    return false;
-}
-
 /*
  * Print debug information for an ICE server.
  */
@@ -678,7 +734,7 @@ static int ice_server_debug(
                 pf, "    URL=\"%s\" type=%s transport=%s resolved=%s\n",
                 url->url, ice_server_type_to_name(url->type),
                 ice_server_transport_to_name(url->transport),
-                url->dns_a_context && url->dns_aaaa_context ? "yes" : "no");
+                !sa_is_any(&url->ipv4_address) || !sa_is_any(&url->ipv6_address) ? "yes" : "no");
     }
 
     // Done
@@ -706,6 +762,9 @@ static int ice_gather_options_debug(
     err |= re_hprintf(pf, "  gather_policy=%s\n",
                       rawrtc_ice_gather_policy_to_str(options->gather_policy));
 
+    // ICE lite
+    err |= re_hprintf(pf, "  ice_lite=%s\n", options->ice_lite ? "yes" : "no");
+
     // ICE servers
     for (le = list_head(&options->ice_servers); le != NULL; le = le->next) {
         struct rawrtc_ice_server* const server = le->data;
@@ -736,6 +795,22 @@ char const * const rawrtc_ice_gatherer_state_to_name(
     }
 }
 
+/*
+ * Generate a random local username fragment (encoding the UDP mux
+ * shard, if sharded).
+ */
+static void generate_username_fragment(
+        char* const username_fragment,
+        size_t const size,
+        struct rawrtc_ice_gather_options* const options
+) {
+    rand_str(username_fragment, size);
+    if (options->udp_mux_port != 0) {
+        rawrtc_udp_mux_steer_username_fragment(
+                username_fragment, options->udp_mux_shards, options->udp_mux_shard);
+    }
+}
+
 /*
  * Destructor for an existing ICE gatherer.
  */
@@ -749,8 +824,14 @@ static void rawrtc_ice_gatherer_destroy(
     rawrtc_ice_gatherer_close(gatherer);
 
     // Un-reference
-    mem_deref(gatherer->dns_client);
     mem_deref(gatherer->ice);
+    list_flush(&gatherer->dns_contexts);
+    list_flush(&gatherer->previous_local_candidates);
+    mem_deref(gatherer->previous_ice);
+    hash_flush(gatherer->re_candidates_by_attributes);
+    mem_deref(gatherer->re_candidates_by_attributes);
+    hash_clear(gatherer->local_candidates_by_re_candidate);
+    mem_deref(gatherer->local_candidates_by_re_candidate);
     list_flush(&gatherer->local_candidates);
     list_flush(&gatherer->buffered_messages);
     mem_deref(gatherer->options);
@@ -769,9 +850,6 @@ enum rawrtc_code rawrtc_ice_gatherer_create(
 ) {
     struct rawrtc_ice_gatherer* gatherer;
     int err;
-    struct sa dns_servers[RAWRTC_ICE_GATHERER_DNS_SERVERS];
-    uint32_t n_dns_servers = ARRAY_SIZE(dns_servers);
-    uint32_t i;
 
     // Check arguments
     if (!gathererp || !options) {
@@ -793,9 +871,25 @@ enum rawrtc_code rawrtc_ice_gatherer_create(
     gatherer->arg = arg;
     list_init(&gatherer->buffered_messages);
     list_init(&gatherer->local_candidates);
+    list_init(&gatherer->previous_local_candidates);
+    list_init(&gatherer->dns_contexts);
+
+    // Create local candidate lookup tables
+    err = hash_alloc(
+            &gatherer->local_candidates_by_re_candidate, RAWRTC_ICE_GATHERER_CANDIDATES_HASH_SIZE);
+    if (err) {
+        goto out;
+    }
+    err = hash_alloc(
+            &gatherer->re_candidates_by_attributes, RAWRTC_ICE_GATHERER_CANDIDATES_HASH_SIZE);
+    if (err) {
+        goto out;
+    }
 
     // Generate random username fragment and password for ICE
-    rand_str(gatherer->ice_username_fragment, sizeof(gatherer->ice_username_fragment));
+    generate_username_fragment(
+            gatherer->ice_username_fragment, sizeof(gatherer->ice_username_fragment),
+            gatherer->options);
     rand_str(gatherer->ice_password, sizeof(gatherer->ice_password));
 
     // Set ICE configuration and create trice instance
@@ -812,28 +906,6 @@ enum rawrtc_code rawrtc_ice_gatherer_create(
         goto out;
     }
 
-    // Get local DNS servers
-    err = dns_srv_get(NULL, 0, dns_servers, &n_dns_servers);
-    if (err) {
-        DEBUG_WARNING("Unable to retrieve local DNS servers, reason: %m\n", err);
-        goto out;
-    }
-
-    // Print local DNS servers
-    if (n_dns_servers == 0) {
-        DEBUG_NOTICE("No DNS servers found\n");
-    }
-    for (i = 0; i < n_dns_servers; ++i) {
-        DEBUG_PRINTF("DNS server: %j\n", &dns_servers[i]);
-    }
-
-    // Create DNS client (for resolving ICE server IPs)
-    err = dnsc_alloc(&gatherer->dns_client, NULL, dns_servers, n_dns_servers);
-    if (err) {
-        DEBUG_WARNING("Unable to create DNS client instance, reason: %m\n", err);
-        goto out;
-    }
-
     // Done
     DEBUG_PRINTF("ICE gatherer created:\n%H", ice_gather_options_debug, gatherer->options);
 
@@ -883,17 +955,24 @@ enum rawrtc_code rawrtc_ice_gatherer_close(
 
     // TODO: Stop ICE transport
 
-    // Remove STUN sessions from local candidate helpers
+    // Release the previous session (if restarting)
+    rawrtc_ice_gatherer_release_previous_session(gatherer);
+
+    // Remove STUN and TURN sessions from local candidate helpers
     // Note: Needed to purge remaining references to the gatherer so it can be free'd.
     list_apply(&gatherer->local_candidates, true,
-               rawrtc_candidate_helper_remove_stun_sessions_handler, NULL);
+               rawrtc_candidate_helper_remove_sessions_handler, NULL);
+
+    // Stop listening for interface changes
+    gatherer->interface_listener = mem_deref(gatherer->interface_listener);
 
-    // Flush local candidate helpers
+    // Flush local candidate helpers and lookup tables
+    hash_flush(gatherer->re_candidates_by_attributes);
+    hash_clear(gatherer->local_candidates_by_re_candidate);
     list_flush(&gatherer->local_candidates);
 
-    // Remove ICE server URL DNS context's
-    // TODO: Does this stop the resolving process?
-    ice_options_destroy_url_dns_contexts(gatherer->options);
+    // Cancel pending DNS queries of this gatherer
+    list_flush(&gatherer->dns_contexts);
 
     // Stop ICE checklist (if running)
     trice_checklist_stop(gatherer->ice);
@@ -906,6 +985,94 @@ enum rawrtc_code rawrtc_ice_gatherer_close(
     return RAWRTC_CODE_SUCCESS;
 }
 
+/*
+ * Release the local candidates and the trice instance of the session
+ * before an ICE restart. Called once the restarted ICE transport
+ * selected a candidate pair.
+ */
+void rawrtc_ice_gatherer_release_previous_session(
+        struct rawrtc_ice_gatherer* const gatherer // not checked
+) {
+    if (!gatherer->previous_ice) {
+        return;
+    }
+    DEBUG_PRINTF("Releasing previous session\n");
+
+    // Remove STUN and TURN sessions & flush local candidate helpers
+    list_apply(&gatherer->previous_local_candidates, true,
+               rawrtc_candidate_helper_remove_sessions_handler, NULL);
+    list_flush(&gatherer->previous_local_candidates);
+
+    // Remove trice instance
+    gatherer->previous_ice = mem_deref(gatherer->previous_ice);
+}
+
+/*
+ * Restart the ICE gatherer (ICE restart, RFC 8445, section 9).
+ */
+enum rawrtc_code rawrtc_ice_gatherer_restart(
+        struct rawrtc_ice_gatherer* const gatherer
+) {
+    char username_fragment[sizeof(gatherer->ice_username_fragment)];
+    char password[sizeof(gatherer->ice_password)];
+    enum trice_role role = ROLE_UNKNOWN;
+    struct trice* ice;
+    struct le* le;
+    int err;
+
+    // Check arguments
+    if (!gatherer) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (gatherer->state == RAWRTC_ICE_GATHERER_CLOSED) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Generate new username fragment and password
+    generate_username_fragment(username_fragment, sizeof(username_fragment), gatherer->options);
+    rand_str(password, sizeof(password));
+
+    // Create new trice instance (keeping the role)
+    // Note: trice cannot change the local username fragment and password of an instance.
+    trice_get_role(gatherer->ice, &role);
+    err = trice_alloc(&ice, &gatherer->ice_config, role, username_fragment, password);
+    if (err) {
+        DEBUG_WARNING("Unable to create trickle ICE instance, reason: %m\n", err);
+        return rawrtc_error_to_code(err);
+    }
+
+    // Release the session of an earlier restart that has not completed
+    rawrtc_ice_gatherer_release_previous_session(gatherer);
+
+    // Keep local candidate helpers (including their sockets, STUN and TURN sessions) of the
+    // previous session, flush lookup tables and buffered packets
+    // Note: The previous session keeps carrying DTLS (and SCTP) until the restarted ICE
+    //       transport selected a candidate pair (RFC 8445, section 9).
+    while ((le = list_head(&gatherer->local_candidates)) != NULL) {
+        list_unlink(le);
+        list_append(&gatherer->previous_local_candidates, le, le->data);
+    }
+    hash_flush(gatherer->re_candidates_by_attributes);
+    hash_clear(gatherer->local_candidates_by_re_candidate);
+    list_flush(&gatherer->buffered_messages);
+
+    // Replace trice instance
+    // Note: The previous instance still answers checks (e.g. consent) on its candidates.
+    trice_checklist_stop(gatherer->ice);
+    gatherer->previous_ice = gatherer->ice;
+    gatherer->ice = ice;
+    memcpy(gatherer->ice_username_fragment, username_fragment, sizeof(username_fragment));
+    memcpy(gatherer->ice_password, password, sizeof(password));
+    DEBUG_INFO("Restarting, new username fragment: %s\n", gatherer->ice_username_fragment);
+
+    // Gather again
+    // Note: The state is being reset silently, the handler will be called with 'gathering'.
+    gatherer->state = RAWRTC_ICE_GATHERER_NEW;
+    return rawrtc_ice_gatherer_gather(gatherer, NULL);
+}
+
 /*
  * Handle received UDP messages.
  */
@@ -956,6 +1123,11 @@ static enum rawrtc_code announce_candidate(
 ) {
     enum rawrtc_code error;
 
+    // Update timeline
+    if (re_candidate) {
+        rawrtc_timestamp_once(&gatherer->timeline.first_local_candidate);
+    }
+
     // Create ICE candidate
     if (gatherer->local_candidate_handler) {
         struct rawrtc_ice_candidate* ice_candidate = NULL;
@@ -991,18 +1163,13 @@ static void check_gathering_complete(
         return;
     }
 
-    // Ensure no DNS queries are in flight
-    for (le = list_head(&gatherer->options->ice_servers); le != NULL; le = le->next) {
-        struct rawrtc_ice_server* const server = le->data;
-        struct rawrtc_ice_server_url* url;
-
-        // Check for pending DNS queries
-        if (ice_server_dns_queries_pending(&url, server)) {
-            // Nope
-            DEBUG_PRINTF("Gathering still in progress, pending DNS record queries (%s)\n",
-                         url->url);
-            return;
-        }
+    // Ensure no DNS queries of this gatherer are in flight
+    if (!list_isempty(&gatherer->dns_contexts)) {
+        struct rawrtc_ice_server_url_dns_context* const context =
+                list_ledata(list_head(&gatherer->dns_contexts));
+        DEBUG_PRINTF("Gathering still in progress, pending DNS record queries (%s)\n",
+                     context->url->url);
+        return;
     }
 
     // Ensure every local candidate has no pending srflx/relay candidates
@@ -1037,92 +1204,457 @@ static void check_gathering_complete(
 }
 
 /*
- * Find an existing local candidate.
- * TODO: This should probably be moved into a PR towards rew
+ * Get the lookup key of a local candidate.
+ * Note: The port of the address is not part of the key.
  */
-static struct ice_lcand* find_candidate(
-        struct trice* const ice,
-        enum ice_cand_type type, // set to -1 if it should not be checked
-        unsigned const component_id, // set to 0 if it should not be checked
+static uint32_t candidate_key(
+        enum ice_cand_type const type,
+        unsigned const component_id,
         int const protocol,
-        struct sa const * const address, // nullable
-        enum sa_flag const address_flag,
-        struct sa const * base_address, // nullable
-        enum sa_flag const base_address_flags
+        struct sa const* const address,
+        struct sa const* const base_address
 ) {
-    struct le* le;
-
-    // Check arguments
-    if (!ice) {
-        return NULL;
-    }
-
-    // If base address and address have an identical IP, ignore the base address and the type
-    if (address && base_address && sa_cmp(address, base_address, SA_ADDR)) {
-        base_address = NULL;
-        type = (enum ice_cand_type) -1;
-    }
+    uint32_t const values[] = {
+        (uint32_t) type, (uint32_t) component_id, (uint32_t) protocol,
+        sa_hash(address, SA_ADDR), sa_hash(base_address, SA_ALL),
+    };
+    return hash_joaat((uint8_t const*) values, sizeof(values));
+}
 
-    for (le = list_head(trice_lcandl(ice)); le != NULL; le = le->next) {
-        struct ice_lcand* candidate = le->data;
+/*
+ * Local candidate lookup handler.
+ */
+static bool candidate_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_ice_gatherer_candidate_entry* const entry = le->data;
+    struct ice_lcand const* const key = arg;
+    struct ice_lcand* const candidate = entry->candidate;
+    return candidate->attr.type == key->attr.type
+            && candidate->attr.compid == key->attr.compid
+            && candidate->attr.proto == key->attr.proto
+            && sa_cmp(&candidate->attr.addr, &key->attr.addr, SA_ADDR)
+            && sa_cmp(&candidate->base_addr, &key->base_addr, SA_ALL);
+}
 
-        // Check type (if requested)
-        if (type != (enum ice_cand_type) -1 && type != candidate->attr.type) {
-            continue;
-        }
+/*
+ * Find an existing local candidate by type, component id, protocol,
+ * address (ignoring the port) and base address.
+ */
+static struct ice_lcand* find_candidate(
+        struct rawrtc_ice_gatherer* const gatherer, // not checked
+        enum ice_cand_type const type,
+        unsigned const component_id,
+        int const protocol,
+        struct sa const* const address, // not checked
+        struct sa const* const base_address // not checked
+) {
+    struct ice_lcand key;
+    struct rawrtc_ice_gatherer_candidate_entry* entry;
+
+    // Prepare key
+    key.attr.type = type;
+    key.attr.compid = component_id;
+    key.attr.proto = protocol;
+    sa_cpy(&key.attr.addr, address);
+    sa_cpy(&key.base_addr, base_address);
+
+    // Lookup
+    entry = list_ledata(hash_lookup(
+            gatherer->re_candidates_by_attributes,
+            candidate_key(type, component_id, protocol, address, base_address),
+            candidate_lookup_handler, &key));
+    return entry ? entry->candidate : NULL;
+}
 
-        // Check component id (if requested)
-        if (component_id && candidate->attr.compid != component_id) {
-            continue;
-        }
+/*
+ * Destructor for an existing local candidate entry.
+ */
+static void rawrtc_ice_gatherer_candidate_entry_destroy(
+        void* arg
+) {
+    struct rawrtc_ice_gatherer_candidate_entry* const entry = arg;
 
-        // Check protocol
-        if (candidate->attr.proto != protocol) {
-            continue;
-        }
+    // Remove from lookup table
+    hash_unlink(&entry->le);
 
-        // Check address
-        if (address && !sa_cmp(&candidate->attr.addr, address, address_flag)) {
-            continue;
-        }
+    // Un-reference
+    mem_deref(entry->candidate);
+}
 
-        // Check base address
-        if (base_address && !sa_cmp(&candidate->base_addr, base_address, base_address_flags)) {
-            continue;
-        }
+/*
+ * Add a local candidate to the lookup table.
+ */
+static enum rawrtc_code index_candidate(
+        struct rawrtc_ice_gatherer* const gatherer, // not checked
+        struct ice_lcand* const candidate // not checked
+) {
+    struct rawrtc_ice_gatherer_candidate_entry* entry;
 
-        // Found
-        return candidate;
+    // Allocate
+    entry = mem_zalloc(sizeof(*entry), rawrtc_ice_gatherer_candidate_entry_destroy);
+    if (!entry) {
+        return RAWRTC_CODE_NO_MEMORY;
     }
 
-    // Not found
-    return NULL;
+    // Set fields/reference
+    entry->candidate = mem_ref(candidate);
+
+    // Add to lookup table
+    hash_append(
+            gatherer->re_candidates_by_attributes,
+            candidate_key(candidate->attr.type, candidate->attr.compid, candidate->attr.proto,
+                          &candidate->attr.addr, &candidate->base_addr),
+            &entry->le, entry);
+    return RAWRTC_CODE_SUCCESS;
 }
 
 /*
- * Gather relay candidates on an ICE server.
+ * Add a permission and bind a channel for a remote peer on a TURN
+ * session's allocation (if allocated).
+ * Note: Once the channel has been bound, data is being relayed using
+ *       ChannelData messages (4 bytes overhead) instead of Send and Data
+ *       indications (36 bytes and more).
  */
-static enum rawrtc_code gather_relay_candidates(
-        struct rawrtc_candidate_helper* const candidate, // not checked
-        struct sa* server_address, // not checked
-        struct rawrtc_ice_server_url* const url // not checked
+static void turn_session_add_peer(
+        struct rawrtc_candidate_helper_turn_session* const session, // not checked
+        struct sa const* const peer_address // not checked
 ) {
-    // Check ICE server is enabled for TURN
-    if (url->type != RAWRTC_ICE_SERVER_TYPE_TURN) {
-        return RAWRTC_CODE_SUCCESS;
+    int err;
+
+    // Not allocated or different address family?
+    if (session->pending || sa_af(&session->relay_address) != sa_af(peer_address)) {
+        return;
     }
 
-    // TODO: Create TURN request
-    DEBUG_NOTICE("TODO: Gather relay candidates using server %J (%s)\n", server_address, url->url);
-    return RAWRTC_CODE_SUCCESS;
+    // Add permission & bind channel
+    err = turnc_add_perm(session->turn_client, peer_address, NULL, NULL);
+    if (!err) {
+        err = turnc_add_chan(session->turn_client, peer_address, NULL, NULL);
+    }
+    if (err) {
+        DEBUG_NOTICE("Could not add TURN permission for peer %J on relay %J, reason: %m\n",
+                     peer_address, &session->relay_address, err);
+    }
 }
 
 /*
- * Handle gathered server reflexive candidate.
+ * Add permissions and bind channels for a remote peer on all TURN
+ * allocations of the gatherer.
  */
-static void reflexive_candidate_handler(
-        int err,
-        struct sa const* address, // not checked
+void rawrtc_ice_gatherer_add_turn_peer(
+        struct rawrtc_ice_gatherer* const gatherer, // not checked
+        struct sa const* const peer_address // not checked
+) {
+    struct le* le;
+    for (le = list_head(&gatherer->local_candidates); le != NULL; le = le->next) {
+        struct rawrtc_candidate_helper* const candidate = le->data;
+        struct le* session_le;
+
+        for (session_le = list_head(&candidate->turn_sessions); session_le != NULL;
+                session_le = session_le->next) {
+            turn_session_add_peer(session_le->data, peer_address);
+        }
+    }
+}
+
+/*
+ * Drop packets on a TURN session's socket that have not been consumed
+ * by any UDP helper.
+ */
+static void turn_socket_receive_handler(
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_candidate_helper_turn_session* const session = arg;
+    (void) source; (void) buffer;
+    ++session->candidate_helper->gatherer->packet_counters.dropped;
+}
+
+/*
+ * Handle allocated relay candidate.
+ */
+static void relay_candidate_handler(
+        int err,
+        uint16_t scode,
+        char const* reason,
+        struct sa const* relay_address,
+        struct sa const* mapped_address,
+        struct stun_msg const* message,
+        void* arg // not checked
+) {
+    struct rawrtc_candidate_helper_turn_session* const session = arg;
+    struct rawrtc_candidate_helper* const candidate = session->candidate_helper;
+    struct rawrtc_ice_gatherer* const gatherer = candidate->gatherer;
+    struct ice_lcand* const re_candidate = candidate->candidate;
+    uint32_t priority;
+    struct ice_lcand* relay_candidate;
+    struct rawrtc_candidate_helper* relay_candidate_helper;
+    struct le* le;
+    enum rawrtc_code error;
+    (void) message;
+
+    // Check state
+    if (gatherer->state == RAWRTC_ICE_GATHERER_CLOSED) {
+        return;
+    }
+
+    // Ignore candidates of the previous session (ICE restart)
+    if (candidate->le.list != &gatherer->local_candidates) {
+        return;
+    }
+
+    // Refreshing an existing allocation failed?
+    // Note: The TURN client refreshes allocations, permissions and channels on its own.
+    if (!session->pending) {
+        if (err || scode) {
+            DEBUG_WARNING("Could not refresh TURN allocation %J (%s), reason: %m %"PRIu16" %s\n",
+                          &session->relay_address, session->url->url, err, scode,
+                          reason ? reason : "");
+        }
+        return;
+    }
+    session->pending = false;
+
+    // Error?
+    if (err || scode) {
+        DEBUG_NOTICE("TURN allocation failed (%s), reason: %m %"PRIu16" %s\n",
+                     session->url->url, err, scode, reason ? reason : "");
+        goto out;
+    }
+
+    // Add relay candidate
+    // Note: The relay candidate uses the allocation's socket and the mapped address as its
+    //       related address.
+    priority = rawrtc_ice_candidate_calculate_priority(
+            ICE_CAND_TYPE_RELAY, re_candidate->attr.proto, sa_af(relay_address),
+            re_candidate->attr.tcptype);
+    err = trice_lcand_add(
+            &relay_candidate, gatherer->ice, re_candidate->attr.compid, re_candidate->attr.proto,
+            priority, relay_address, relay_address, ICE_CAND_TYPE_RELAY, mapped_address,
+            re_candidate->attr.tcptype, session->socket, RAWRTC_LAYER_ICE);
+    if (err) {
+        DEBUG_WARNING("Could not add relay candidate, reason: %m\n", err);
+        goto out;
+    }
+    sa_cpy(&session->relay_address, relay_address);
+    DEBUG_PRINTF("Added %s relay candidate %J for interface %j (%s)\n",
+                 net_proto2name(relay_candidate->attr.proto), relay_address,
+                 &re_candidate->attr.addr, session->url->url);
+
+    // Create candidate helper (attaches receive handler)
+    error = rawrtc_candidate_helper_create(
+            &relay_candidate_helper, gatherer, relay_candidate, udp_receive_handler, gatherer);
+    if (error) {
+        DEBUG_WARNING("Could not create candidate helper, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        goto out;
+    }
+
+    // Add to lookup tables
+    error = index_candidate(gatherer, relay_candidate);
+    if (error) {
+        DEBUG_WARNING("Could not index relay candidate, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        mem_deref(relay_candidate_helper);
+        goto out;
+    }
+    hash_append(
+            gatherer->local_candidates_by_re_candidate,
+            rawrtc_candidate_helper_key(relay_candidate), &relay_candidate_helper->lookup_le,
+            relay_candidate_helper);
+
+    // Add to local candidates list
+    list_append(&gatherer->local_candidates, &relay_candidate_helper->le, relay_candidate_helper);
+
+    // Add permissions for remote candidates that are already known
+    for (le = list_head(trice_rcandl(gatherer->ice)); le != NULL; le = le->next) {
+        struct ice_rcand* const remote_candidate = le->data;
+        turn_session_add_peer(session, &remote_candidate->attr.addr);
+    }
+
+    // Announce candidate to handler
+    error = announce_candidate(gatherer, relay_candidate, session->url->url);
+    if (error) {
+        DEBUG_WARNING("Could not announce relay candidate, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        goto out;
+    }
+
+out:
+    // Decrease counter & check if done gathering
+    --candidate->relay_pending_count;
+    check_gathering_complete(gatherer);
+}
+
+/*
+ * Gather relay candidates on an ICE server.
+ */
+static enum rawrtc_code gather_relay_candidates(
+        struct rawrtc_candidate_helper* const candidate, // not checked
+        struct sa* server_address, // not checked
+        struct rawrtc_ice_server_url* const url // not checked
+) {
+    struct ice_cand_attr* const attribute = &candidate->candidate->attr;
+    struct rawrtc_ice_server* const server = url->server;
+    struct sa local_address;
+    struct rawrtc_candidate_helper_turn_session* session = NULL;
+    struct udp_sock* socket = NULL;
+    struct turnc* turn_client = NULL;
+    enum rawrtc_code error;
+
+    // Check ICE server is enabled for TURN
+    if (url->type != RAWRTC_ICE_SERVER_TYPE_TURN) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Ensure the candidate's protocol matches the server address's protocol
+    if (sa_af(&attribute->addr) != sa_af(server_address)) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // TODO: Handle TCP/TLS/DTLS transports
+    if (attribute->proto != IPPROTO_UDP || url->transport != RAWRTC_ICE_SERVER_TRANSPORT_UDP) {
+        DEBUG_NOTICE("TODO: Gather relay candidates using server %J (%s) over %s\n",
+                     server_address, url->url, ice_server_transport_to_name(url->transport));
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Only long-term credentials are supported
+    if (server->credential_type != RAWRTC_ICE_CREDENTIAL_TYPE_PASSWORD
+            || !server->username || !server->credential) {
+        DEBUG_NOTICE("Missing long-term credentials for TURN server %J (%s)\n",
+                     server_address, url->url);
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Create TURN session
+    error = rawrtc_candidate_helper_turn_session_create(&session, url);
+    if (error) {
+        goto out;
+    }
+
+    // Create socket on the candidate's interface
+    // Note: A separate socket is required as the relay candidate needs its own base.
+    sa_cpy(&local_address, &attribute->addr);
+    sa_set_port(&local_address, 0);
+    error = rawrtc_error_to_code(udp_listen(
+            &socket, &local_address, turn_socket_receive_handler, session));
+    if (error) {
+        goto out;
+    }
+
+    // Create TURN client
+    DEBUG_PRINTF("Creating TURN allocation for %s candidate %J using ICE server %J (%s)\n",
+                 net_proto2name(attribute->proto), &attribute->addr, server_address, url->url);
+    error = rawrtc_error_to_code(turnc_alloc(
+            &turn_client, &rawrtc_default_config.stun_config, IPPROTO_UDP, socket,
+            RAWRTC_LAYER_TURN, server_address, server->username, server->credential,
+            RAWRTC_ICE_GATHERER_TURN_LIFETIME, relay_candidate_handler, session));
+    if (error) {
+        goto out;
+    }
+
+    // Add the TURN session to the candidate
+    error = rawrtc_candidate_helper_turn_session_add(session, candidate, socket, turn_client);
+    if (error) {
+        goto out;
+    }
+
+    // Increase counter & done
+    ++candidate->relay_pending_count;
+    error = RAWRTC_CODE_SUCCESS;
+
+out:
+    // Un-reference
+    mem_deref(turn_client);
+    mem_deref(socket);
+    if (error) {
+        DEBUG_WARNING("Could not create TURN allocation, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        mem_deref(session);
+    }
+
+    // Done
+    return error;
+}
+
+/*
+ * Send a STUN keep-alive to the server of a STUN session.
+ * Every nth keep-alive is a binding request which verifies that the
+ * binding still exists, the others are binding indications.
+ */
+static void stun_keepalive_timer_handler(
+        void* arg
+) {
+    struct rawrtc_candidate_helper_stun_session* const session = arg;
+    struct ice_lcand* const re_candidate = session->candidate_helper->candidate;
+    uint32_t const interval = rawrtc_default_config.stun_keepalive_interval;
+    int err;
+
+    // Send binding request?
+    ++session->n_keepalives;
+    if (session->n_keepalives % RAWRTC_ICE_GATHERER_STUN_KEEPALIVE_REQUEST_TICKS == 0) {
+        // Note: The STUN keep-alive sends the request right away. Its own timer is set to the
+        //       request interval, so it cannot fire before the next tick stops it again.
+        stun_keepalive_enable(session->stun_keepalive,
+                              interval * RAWRTC_ICE_GATHERER_STUN_KEEPALIVE_REQUEST_TICKS);
+    } else {
+        // Stop STUN keep-alive timer (started by the previous request)
+        stun_keepalive_enable(session->stun_keepalive, 0);
+
+        // Send binding indication (keeps the NAT binding alive, RFC 8445, section 11)
+        err = stun_indication(
+                re_candidate->attr.proto, re_candidate->us, &session->server_address, 0,
+                STUN_METHOD_BINDING, NULL, 0, false, 0);
+        if (err) {
+            DEBUG_NOTICE("Could not send STUN keep-alive to %J, reason: %m\n",
+                         &session->server_address, err);
+        }
+    }
+
+    // Restart (spread out to prevent bursts)
+    rawrtc_timer_wheel_start(
+            &session->keepalive_timer,
+            rawrtc_timer_wheel_jitter(interval * 1000,
+                                      RAWRTC_ICE_GATHERER_STUN_KEEPALIVE_JITTER),
+            stun_keepalive_timer_handler, session);
+}
+
+/*
+ * Hand the keep-alives of a STUN session over to the timer wheel (once
+ * the server reflexive address is known).
+ * Note: This stops the STUN keep-alive's own timer, so the session does
+ *       not hold a separate timer while idle.
+ */
+static void stun_keepalive_start(
+        struct rawrtc_candidate_helper_stun_session* const session // not checked
+) {
+    enum rawrtc_code error;
+
+    // Stop STUN keep-alive timer
+    stun_keepalive_enable(session->stun_keepalive, 0);
+    session->mapped = true;
+
+    // Start timer wheel timer
+    error = rawrtc_timer_wheel_start(
+            &session->keepalive_timer,
+            rawrtc_timer_wheel_jitter(rawrtc_default_config.stun_keepalive_interval * 1000,
+                                      RAWRTC_ICE_GATHERER_STUN_KEEPALIVE_JITTER),
+            stun_keepalive_timer_handler, session);
+    if (error) {
+        DEBUG_WARNING("Could not start STUN keep-alives, reason: %s\n", rawrtc_code_to_str(error));
+    }
+}
+
+/*
+ * Handle gathered server reflexive candidate.
+ */
+static void reflexive_candidate_handler(
+        int err,
+        struct sa const* address, // not checked
         void* arg // not checked
 ) {
     struct rawrtc_candidate_helper_stun_session* const session = arg;
@@ -1140,17 +1672,43 @@ static void reflexive_candidate_handler(
         return;
     }
 
+    // Ignore candidates of the previous session (ICE restart)
+    if (candidate->le.list != &gatherer->local_candidates) {
+        return;
+    }
+
+    // Response to a keep-alive request?
+    // TODO: Replace the server reflexive candidate when the mapped address changed
+    if (session->mapped) {
+        if (err) {
+            DEBUG_NOTICE("STUN keep-alive request to %J failed, reason: %m\n",
+                         &session->server_address, err);
+        } else {
+            DEBUG_NOTICE("Server reflexive address of %J changed to %J (%s)\n",
+                         &re_candidate->attr.addr, address, session->url->url);
+        }
+        return;
+    }
+
     // Error?
     if (err) {
         DEBUG_NOTICE("STUN request failed, reason: %m\n", err);
         goto out;
     }
 
+    // Same IP as the base? Then the host candidate already covers it.
+    if (sa_cmp(address, &re_candidate->attr.addr, SA_ADDR)) {
+        DEBUG_PRINTF("Ignoring server reflexive candidate with same IP as base %J (%s)\n",
+                     &re_candidate->attr.addr, session->url->url);
+        remove_session = true;
+        goto out;
+    }
+
     // Check if a local candidate with the same base and same attributes (apart from the port)
     // exists
     re_other_candidate = find_candidate(
-            gatherer->ice, ICE_CAND_TYPE_SRFLX, re_candidate->attr.compid, re_candidate->attr.proto,
-            address, SA_ADDR, &re_candidate->attr.addr, SA_ALL);
+            gatherer, ICE_CAND_TYPE_SRFLX, re_candidate->attr.compid, re_candidate->attr.proto,
+            address, &re_candidate->attr.addr);
     if (re_other_candidate) {
         DEBUG_PRINTF("Ignoring server reflexive candidate with same base %J and public IP %j (%s)"
                      "\n", &re_candidate->attr.addr, address, session->url->url);
@@ -1178,6 +1736,14 @@ static void reflexive_candidate_handler(
     DEBUG_PRINTF("Added %s server reflexive candidate for interface %j (%s)\n",
                  net_proto2name(srflx_candidate->attr.proto), address, session->url->url);
 
+    // Add to lookup table
+    error = index_candidate(gatherer, srflx_candidate);
+    if (error) {
+        DEBUG_WARNING("Could not index server reflexive candidate, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        goto out;
+    }
+
     // Announce candidate to handler
     error = announce_candidate(gatherer, srflx_candidate, session->url->url);
     if (error) {
@@ -1186,6 +1752,9 @@ static void reflexive_candidate_handler(
         goto out;
     }
 
+    // Keep the binding alive
+    stun_keepalive_start(session);
+
 out:
     // Decrease counter & check if done gathering
     --candidate->srflx_pending_count;
@@ -1233,6 +1802,7 @@ static enum rawrtc_code gather_reflexive_candidates(
     if (error) {
         goto out;
     }
+    sa_cpy(&session->server_address, server_address);
 
     // Create STUN keep-alive session
     // TODO: We're using the candidate's protocol which conflicts with the ICE server URL transport
@@ -1280,10 +1850,17 @@ static void gather_candidates(
 ) {
     enum rawrtc_code error;
 
+    // Only UDP host candidates can be used as a base
+    // TODO: Server reflexive and relay candidates for ICE-TCP
+    if (candidate->candidate->attr.type != ICE_CAND_TYPE_HOST
+            || candidate->candidate->attr.proto != IPPROTO_UDP) {
+        return;
+    }
+
     // Gather reflexive candidates
     error = gather_reflexive_candidates(candidate, server_address, url);
     if (error) {
-        DEBUG_WARNING("Could not gather server reflexive candidates, reason: %s",
+        DEBUG_WARNING("Could not gather server reflexive candidates, reason: %s\n",
                       rawrtc_code_to_str(error));
         // Note: Considered non-critical, continuing
     }
@@ -1291,7 +1868,7 @@ static void gather_candidates(
     // Gather relay candidates
     error = gather_relay_candidates(candidate, server_address, url);
     if (error) {
-        DEBUG_WARNING("Could not gather relay candidates, reason: %s",
+        DEBUG_WARNING("Could not gather relay candidates, reason: %s\n",
                       rawrtc_code_to_str(error));
         // Note: Considered non-critical, continuing
     }
@@ -1371,21 +1948,35 @@ static enum rawrtc_code add_candidate(
 ) {
     uint32_t priority;
     int const ipproto = rawrtc_ice_protocol_to_ipproto(protocol);
+    struct sa mux_address;
+    struct rawrtc_udp_mux* mux = NULL;
     struct ice_lcand* re_candidate;
     int err;
     struct rawrtc_candidate_helper* candidate;
     enum rawrtc_code error;
 
+    // Use shared UDP socket (if enabled)
+    if (protocol == RAWRTC_ICE_PROTOCOL_UDP && gatherer->options->udp_mux_port != 0) {
+        mux_address = *address;
+        sa_set_port(&mux_address, gatherer->options->udp_mux_port);
+        error = rawrtc_udp_mux_get(&mux, &mux_address, gatherer->options->udp_mux_shards);
+        if (error) {
+            DEBUG_WARNING("Could not get UDP mux, reason: %s\n", rawrtc_code_to_str(error));
+            return error;
+        }
+    }
+
     // Add host candidate
     priority = rawrtc_ice_candidate_calculate_priority(
             ICE_CAND_TYPE_HOST, ipproto, sa_af(address), tcp_type);
     // TODO: Set component id properly
     err = trice_lcand_add(
-            &re_candidate, gatherer->ice, 1, ipproto, priority, address,
-            NULL, ICE_CAND_TYPE_HOST, NULL, tcp_type, NULL, RAWRTC_LAYER_ICE);
+            &re_candidate, gatherer->ice, 1, ipproto, priority, mux ? &mux->address : address,
+            NULL, ICE_CAND_TYPE_HOST, NULL, tcp_type, mux ? mux->socket : NULL, RAWRTC_LAYER_ICE);
     if (err) {
         DEBUG_WARNING("Could not add host candidate, reason: %m\n", err);
-        return rawrtc_error_to_code(err);
+        error = rawrtc_error_to_code(err);
+        goto out;
     }
 
     // Create candidate helper (attaches receive handler)
@@ -1394,8 +1985,33 @@ static enum rawrtc_code add_candidate(
     if (error) {
         DEBUG_WARNING("Could not create candidate helper, reason: %s\n",
                       rawrtc_code_to_str(error));
-        return error;
+        goto out;
+    }
+
+    // Add to UDP mux (if enabled)
+    if (mux) {
+        error = rawrtc_udp_mux_add(
+                &candidate->udp_mux_entry, mux, candidate, gatherer->ice_username_fragment);
+        if (error) {
+            DEBUG_WARNING("Could not add candidate to UDP mux, reason: %s\n",
+                          rawrtc_code_to_str(error));
+            mem_deref(candidate);
+            goto out;
+        }
+        mux = mem_deref(mux);
+    }
+
+    // Add to lookup tables
+    error = index_candidate(gatherer, re_candidate);
+    if (error) {
+        DEBUG_WARNING("Could not index host candidate, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        mem_deref(candidate);
+        goto out;
     }
+    hash_append(
+            gatherer->local_candidates_by_re_candidate,
+            rawrtc_candidate_helper_key(re_candidate), &candidate->lookup_le, candidate);
 
     // Add to local candidates list
     list_append(&gatherer->local_candidates, &candidate->le, candidate);
@@ -1423,6 +2039,28 @@ static enum rawrtc_code add_candidate(
 
     // Done
     return RAWRTC_CODE_SUCCESS;
+
+out:
+    mem_deref(mux);
+    return error;
+}
+
+/*
+ * Check if a host candidate for an interface address exists.
+ */
+static bool has_host_candidate(
+        struct rawrtc_ice_gatherer* const gatherer, // not checked
+        struct sa const* const address // not checked
+) {
+    struct le* le;
+    for (le = list_head(&gatherer->local_candidates); le != NULL; le = le->next) {
+        struct rawrtc_candidate_helper* const candidate = le->data;
+        if (candidate->candidate->attr.type == ICE_CAND_TYPE_HOST
+                && sa_cmp(&candidate->candidate->attr.addr, address, SA_ADDR)) {
+            return true;
+        }
+    }
+    return false;
 }
 
 /*
@@ -1445,11 +2083,6 @@ static bool interface_handler(
         return true; // Don't continue gathering
     }
 
-    // Ignore loopback and linklocal addresses
-    if (sa_is_linklocal(address) || sa_is_loopback(address)) {
-        return false; // Continue gathering
-    }
-
     // Skip IPv4, IPv6?
     // TODO: Get config from struct
     af = sa_af(address);
@@ -1458,7 +2091,10 @@ static bool interface_handler(
         return false; // Continue gathering
     }
 
-    // TODO: Ignore interfaces gatherered twice
+    // Ignore interfaces gathered before (when re-gathering)
+    if (has_host_candidate(gatherer, address)) {
+        return false; // Continue gathering
+    }
 
     DEBUG_PRINTF("Gathered local interface %j\n", address);
 
@@ -1466,7 +2102,7 @@ static bool interface_handler(
     if (rawrtc_default_config.udp_enable) {
         error = add_candidate(gatherer, address, RAWRTC_ICE_PROTOCOL_UDP, ICE_TCP_ACTIVE);
         if (error) {
-            DEBUG_WARNING("Could not add candidate, reason: %s", rawrtc_code_to_str(error));
+            DEBUG_WARNING("Could not add candidate, reason: %s\n", rawrtc_code_to_str(error));
             goto out;
         }
 
@@ -1476,11 +2112,32 @@ static bool interface_handler(
         }
     }
 
-    // Add TCP candidate
-    if (rawrtc_default_config.tcp_enable) {
-        // TODO
-        //add_candidate(gatherer, address, RAWRTC_ICE_PROTOCOL_TCP, ICE_TCP_SO);
-        DEBUG_WARNING("TODO: Add TCP host candidate for interface %j\n", address);
+    // Add TCP candidates (RFC 6544)
+    // Note: Simultaneous-open candidates are not being gathered as they rarely work through NATs.
+    // Note: ICE lite agents skip TCP as the ICE agent handles framed STUN messages itself, so
+    //       nominations on TCP candidate pairs would never be detected.
+    if (rawrtc_default_config.tcp_enable && !gatherer->options->ice_lite) {
+        error = add_candidate(gatherer, address, RAWRTC_ICE_PROTOCOL_TCP, ICE_TCP_PASSIVE);
+        if (error) {
+            DEBUG_WARNING("Could not add candidate, reason: %s\n", rawrtc_code_to_str(error));
+            goto out;
+        }
+
+        // Check state
+        if (gatherer->state == RAWRTC_ICE_GATHERER_CLOSED) {
+            return true; // Don't continue gathering
+        }
+
+        error = add_candidate(gatherer, address, RAWRTC_ICE_PROTOCOL_TCP, ICE_TCP_ACTIVE);
+        if (error) {
+            DEBUG_WARNING("Could not add candidate, reason: %s\n", rawrtc_code_to_str(error));
+            goto out;
+        }
+
+        // Check state
+        if (gatherer->state == RAWRTC_ICE_GATHERER_CLOSED) {
+            return true; // Don't continue gathering
+        }
     }
 
 out:
@@ -1494,82 +2151,84 @@ out:
 }
 
 /*
- * DNS A or AAAA record handler.
+ * Local interfaces changed callback.
  */
-static bool dns_record_result_handler(
-    struct dnsrr* resource_record,
-    void* arg
+static void interface_change_handler(
+        void* arg
 ) {
-    struct rawrtc_ice_server_url_dns_context* const context = arg;
-    struct rawrtc_ice_server_url* const url = context->url;
-    struct sa* server_address;
-    DEBUG_PRINTF("DNS resource record: %H\n", dns_rr_print, resource_record);
+    struct rawrtc_ice_gatherer* const gatherer = arg;
 
-    // Set IP address
-    switch (resource_record->type) {
-        case DNS_TYPE_A:
-            // Set IPv4 address
-            server_address = &url->ipv4_address;
-            sa_set_in(server_address, resource_record->rdata.a.addr, sa_port(server_address));
+    switch (gatherer->state) {
+        case RAWRTC_ICE_GATHERER_GATHERING:
+            // Gather on new interfaces
+            DEBUG_INFO("Interfaces changed, gathering on new interfaces\n");
+            rawrtc_interface_cache_apply(interface_handler, gatherer);
+            check_gathering_complete(gatherer);
             break;
-
-        case DNS_TYPE_AAAA:
-            // Set IPv6 address
-            server_address = &url->ipv6_address;
-            sa_set_in6(server_address, resource_record->rdata.aaaa.addr, sa_port(server_address));
+        case RAWRTC_ICE_GATHERER_COMPLETE:
+            // Let the application decide (e.g. re-gather or ICE restart)
+            DEBUG_INFO("Interfaces changed after gathering completed\n");
+            if (gatherer->interface_change_handler) {
+                gatherer->interface_change_handler(gatherer->arg);
+            }
             break;
-
         default:
-            DEBUG_WARNING("Invalid DNS resource record, expected A/AAAA record, got: %H\n",
-                          dns_rr_print, resource_record);
-            return true; // stop traversing
+            break;
     }
+}
 
-    // Start gathering candidates using the resolved ICE server
-    gather_candidates_using_server(context->gatherer, server_address, url);
-
-    // Done, stop traversing, one IP is sufficient
-    return true;
+/*
+ * Set the IP address of a resolved ICE server (keeping the port).
+ */
+static void set_server_address(
+        struct sa* const server_address,
+        struct sa const* const address
+) {
+    uint16_t const port = sa_port(server_address);
+    sa_cpy(server_address, address);
+    sa_set_port(server_address, port);
 }
 
 /*
- * DNS query result handler.
+ * DNS cache query result handler.
  */
 static void dns_query_handler(
         int err,
-        struct dnshdr const* header,
-        struct list* answer_records,
-        struct list* authoritive_records,
-        struct list* additional_records,
+        struct sa const* address,
         void* arg
 ) {
     struct rawrtc_ice_server_url_dns_context* const context = arg;
-    (void) header; (void) authoritive_records; (void) additional_records;
-
-    // Handle error (if any)
-    if (err) {
-        DEBUG_WARNING("Could not query DNS record, reason: %m\n", err);
-        goto out;
-    }
+    struct rawrtc_ice_server_url* const url = context->url;
+    struct sa* server_address;
 
-    // Handle A or AAAA record
-    dns_rrlist_apply2(answer_records, NULL, DNS_TYPE_A, DNS_TYPE_AAAA, DNS_CLASS_IN, true,
-                      dns_record_result_handler, context);
+    // Remove context from gatherer (query completed)
+    list_unlink(&context->le);
 
-    // Remove context from URL depending on DNS type
+    // Get server address depending on DNS type
+    // Note: The resolved address is the same for all gatherers, so it is being stored in the
+    //       (shared) URL.
     switch (context->dns_type) {
         case DNS_TYPE_A:
-            context->url->dns_a_context = NULL;
+            server_address = &url->ipv4_address;
             break;
 
         case DNS_TYPE_AAAA:
-            context->url->dns_aaaa_context = NULL;
+            server_address = &url->ipv6_address;
             break;
 
         default:
             DEBUG_WARNING("Invalid DNS type, expected A/AAAA, got %s\n",
                           dns_rr_typename((uint16_t) context->dns_type));
-            break;
+            goto out;
+    }
+
+    // Handle error (if any)
+    if (err) {
+        DEBUG_WARNING("Could not query DNS record, reason: %m\n", err);
+    } else {
+        // Start gathering candidates using the resolved ICE server
+        set_server_address(server_address, address);
+        gather_candidates_using_server(context->gatherer, server_address, url);
     }
 
     // Check if gathering is complete
@@ -1581,23 +2240,32 @@ out:
 }
 
 /*
- * Query A or AAAA record.
+ * Query A or AAAA record (unless cached).
  */
 static enum rawrtc_code query_a_or_aaaa_record(
-        struct rawrtc_ice_server_url_dns_context** const contextp, // de-referenced, not checked
         struct sa* const server_address, // not checked
         uint_fast16_t const dns_type,
         struct rawrtc_ice_server_url* const url, // not checked
         struct rawrtc_ice_gatherer* const gatherer // not checked
 ) {
-    bool const resolved = !sa_is_any(server_address);
+    struct sa address;
     enum rawrtc_code error;
     struct rawrtc_ice_server_url_dns_context* context;
-    char* host_str = NULL;
 
-    // Check if already resolved
-    if (resolved) {
-        DEBUG_PRINTF("Hostname (%s) already resolved\n", dns_type_to_address_family_name(dns_type));
+    // IP address? Nothing to resolve.
+    if (!sa_set(&address, &url->host, 0)) {
+        if (sa_af(&address) == (dns_type == DNS_TYPE_A ? AF_INET : AF_INET6)) {
+            set_server_address(server_address, &address);
+        }
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Use cached address (if any)
+    error = rawrtc_dns_cache_lookup(&address, &url->host, (uint16_t) dns_type);
+    if (!error) {
+        DEBUG_PRINTF("Hostname (%s) resolved from cache: %j\n",
+                     dns_type_to_address_family_name(dns_type), &address);
+        set_server_address(server_address, &address);
         return RAWRTC_CODE_SUCCESS;
     }
 
@@ -1607,41 +2275,19 @@ static enum rawrtc_code query_a_or_aaaa_record(
         return error;
     }
 
-    // Copy URL to str
-    error = rawrtc_error_to_code(pl_strdup(&host_str, &url->host));
-    if (error) {
-        goto out;
-    }
-
-    // Query A or AAAA record
-    error = rawrtc_error_to_code(dnsc_query(
-            &context->dns_query, gatherer->dns_client, host_str, (uint16_t) dns_type,
-            DNS_CLASS_IN, true, dns_query_handler, context));
-    if (error) {
-        goto out;
-    }
-
-    // Done
-    error = RAWRTC_CODE_SUCCESS;
-
-out:
+    // Query A or AAAA record (or wait for the pending query)
+    error = rawrtc_dns_cache_query(
+            &context->dns_request, &url->host, (uint16_t) dns_type, dns_query_handler, context);
     if (error) {
         // Un-reference context
         mem_deref(context);
     } else {
-        // Set pointer
-        *contextp = context;
+        // Add to gatherer (owns the context until the query completed)
+        list_append(&gatherer->dns_contexts, &context->le, context);
     }
-
-    // Un-reference & done
-    mem_deref(host_str);
     return error;
 }
 
-/*
- * Cancel if already resolving
- */
-
 /*
  * Resolve ICE server IP addresses.
  */
@@ -1651,6 +2297,11 @@ static enum rawrtc_code resolve_ice_servers_address(
 ) {
     struct le* le;
 
+    // Cancel pending DNS queries of this gatherer
+    // Note: Other gatherers' queries are not affected, equal queries are coalesced by the DNS
+    //       cache.
+    list_flush(&gatherer->dns_contexts);
+
     for (le = list_head(&options->ice_servers); le != NULL; le = le->next) {
         struct rawrtc_ice_server* const ice_server = le->data;
         struct le* url_le;
@@ -1659,14 +2310,10 @@ static enum rawrtc_code resolve_ice_servers_address(
         for (url_le = list_head(&ice_server->urls); url_le != NULL; url_le = url_le->next) {
             struct rawrtc_ice_server_url* const url = url_le->data;
 
-            // Cancel pending DNS resolve processes
-            // TODO: Does this stop the resolving process?
-            ice_url_destroy_dns_contexts(url);
-
             // Query A record (if IPv4 is enabled)
             if (rawrtc_default_config.ipv4_enable) {
                 error = query_a_or_aaaa_record(
-                        &url->dns_a_context, &url->ipv4_address, DNS_TYPE_A, url, gatherer);
+                        &url->ipv4_address, DNS_TYPE_A, url, gatherer);
                 if (error) {
                     DEBUG_WARNING("Unable to query A record, reason: %s\n",
                                   rawrtc_code_to_str(error));
@@ -1677,7 +2324,7 @@ static enum rawrtc_code resolve_ice_servers_address(
             // Query AAAA record (if IPv6 is enabled)
             if (rawrtc_default_config.ipv6_enable) {
                 error = query_a_or_aaaa_record(
-                        &url->dns_aaaa_context, &url->ipv6_address, DNS_TYPE_AAAA, url, gatherer);
+                        &url->ipv6_address, DNS_TYPE_AAAA, url, gatherer);
                 if (error) {
                     DEBUG_WARNING("Unable to query AAAA record, reason: %s\n",
                                   rawrtc_code_to_str(error));
@@ -1719,17 +2366,35 @@ enum rawrtc_code rawrtc_ice_gatherer_gather(
     }
 
     // Resolve ICE server IP addresses
-    error = resolve_ice_servers_address(gatherer, options);
-    if (error) {
-        return error;
+    // Note: ICE lite agents only use host candidates, so ICE servers are being ignored.
+    if (!options->ice_lite) {
+        error = resolve_ice_servers_address(gatherer, options);
+        if (error) {
+            return error;
+        }
     }
 
-    // Update state
+    // Update state & timeline
+    rawrtc_timestamp_once(&gatherer->timeline.gathering_started);
     set_state(gatherer, RAWRTC_ICE_GATHERER_GATHERING);
 
+    // Listen for interface changes
+    if (!gatherer->interface_listener) {
+        error = rawrtc_interface_cache_listen(
+                &gatherer->interface_listener, interface_change_handler, gatherer);
+        if (error) {
+            DEBUG_WARNING("Could not listen for interface changes, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        }
+    }
+
     // Start gathering host candidates
     if (options->gather_policy != RAWRTC_ICE_GATHER_POLICY_NOHOST) {
-        net_if_apply(interface_handler, gatherer);
+        error = rawrtc_interface_cache_apply(interface_handler, gatherer);
+        if (error) {
+            DEBUG_WARNING("Could not enumerate interfaces, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        }
     }
 
     // Gathering complete
@@ -1739,6 +2404,103 @@ enum rawrtc_code rawrtc_ice_gatherer_gather(
     return RAWRTC_CODE_SUCCESS;
 }
 
+/*
+ * Get the received packet counters of an ICE gatherer.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_get_packet_counters(
+        struct rawrtc_packet_counters* const countersp, // de-referenced
+        struct rawrtc_ice_gatherer* const gatherer
+) {
+    // Check arguments
+    if (!countersp || !gatherer) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Copy counters
+    *countersp = gatherer->packet_counters;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Set the ICE gatherer's interface change handler.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_set_interface_change_handler(
+        struct rawrtc_ice_gatherer* const gatherer,
+        rawrtc_ice_gatherer_interface_change_handler* const interface_change_handler // nullable
+) {
+    // Check arguments
+    if (!gatherer) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set handler
+    gatherer->interface_change_handler = interface_change_handler;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Replace the handlers of an ICE gatherer.
+ * Note: The interface change handler will be unset.
+ */
+void rawrtc_ice_gatherer_set_handlers(
+        struct rawrtc_ice_gatherer* const gatherer, // not checked
+        rawrtc_ice_gatherer_state_change_handler* const state_change_handler, // nullable
+        rawrtc_ice_gatherer_error_handler* const error_handler, // nullable
+        rawrtc_ice_gatherer_local_candidate_handler* const local_candidate_handler, // nullable
+        void* const arg // nullable
+) {
+    gatherer->state_change_handler = state_change_handler;
+    gatherer->error_handler = error_handler;
+    gatherer->local_candidate_handler = local_candidate_handler;
+    gatherer->interface_change_handler = NULL;
+    gatherer->arg = arg;
+}
+
+/*
+ * Replay the state changes and local candidates an ICE gatherer has
+ * gone through so far to its current handlers.
+ * Note: The URL of server reflexive candidates is not being replayed.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_replay(
+        struct rawrtc_ice_gatherer* const gatherer // not checked
+) {
+    struct le* le;
+    enum rawrtc_code error;
+
+    // Nothing happened, yet?
+    if (gatherer->state == RAWRTC_ICE_GATHERER_NEW
+            || gatherer->state == RAWRTC_ICE_GATHERER_CLOSED) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Gathering
+    if (gatherer->state_change_handler) {
+        gatherer->state_change_handler(RAWRTC_ICE_GATHERER_GATHERING, gatherer->arg);
+    }
+
+    // Announce local candidates
+    for (le = list_head(trice_lcandl(gatherer->ice)); le != NULL; le = le->next) {
+        error = announce_candidate(gatherer, le->data, NULL);
+        if (error) {
+            return error;
+        }
+    }
+
+    // Complete?
+    if (gatherer->state == RAWRTC_ICE_GATHERER_COMPLETE) {
+        error = announce_candidate(gatherer, NULL, NULL);
+        if (error) {
+            return error;
+        }
+        if (gatherer->state_change_handler) {
+            gatherer->state_change_handler(RAWRTC_ICE_GATHERER_COMPLETE, gatherer->arg);
+        }
+    }
+
+    // Done
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Get local ICE parameters of an ICE gatherer.
  */
@@ -1758,7 +2520,8 @@ enum rawrtc_code rawrtc_ice_gatherer_get_local_parameters(
 
     // Create and return ICE parameters instance
     return rawrtc_ice_parameters_create(
-            parametersp, gatherer->ice_username_fragment, gatherer->ice_password, false);
+            parametersp, gatherer->ice_username_fragment, gatherer->ice_password,
+            gatherer->options->ice_lite);
 }
 
 /*
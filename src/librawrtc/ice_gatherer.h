@@ -1,9 +1,42 @@
 #pragma once
 
 enum {
-    RAWRTC_ICE_GATHERER_DNS_SERVERS = 10
+    RAWRTC_ICE_GATHERER_CANDIDATES_HASH_SIZE = 16,
+    RAWRTC_ICE_GATHERER_STUN_KEEPALIVE_JITTER = 20, // in percent
+    RAWRTC_ICE_GATHERER_STUN_KEEPALIVE_REQUEST_TICKS = 4, // every nth keep-alive is a request
+    RAWRTC_ICE_GATHERER_TURN_LIFETIME = 600, // in seconds
 };
 
+/*
+ * Local candidate, indexed by type, component id, protocol, address and
+ * base address.
+ */
+struct rawrtc_ice_gatherer_candidate_entry {
+    struct le le;
+    struct ice_lcand* candidate; // referenced
+};
+
+void rawrtc_ice_gatherer_set_handlers(
+    struct rawrtc_ice_gatherer* const gatherer, // not checked
+    rawrtc_ice_gatherer_state_change_handler* const state_change_handler, // nullable
+    rawrtc_ice_gatherer_error_handler* const error_handler, // nullable
+    rawrtc_ice_gatherer_local_candidate_handler* const local_candidate_handler, // nullable
+    void* const arg // nullable
+);
+
+void rawrtc_ice_gatherer_release_previous_session(
+    struct rawrtc_ice_gatherer* const gatherer // not checked
+);
+
+enum rawrtc_code rawrtc_ice_gatherer_replay(
+    struct rawrtc_ice_gatherer* const gatherer // not checked
+);
+
+void rawrtc_ice_gatherer_add_turn_peer(
+    struct rawrtc_ice_gatherer* const gatherer, // not checked
+    struct sa const* const peer_address // not checked
+);
+
 enum rawrtc_code rawrtc_ice_server_url_dns_context_create(
     struct rawrtc_ice_server_url_dns_context** const contextp,
     uint_fast16_t const dns_type,
@@ -0,0 +1,286 @@
+#include <rawrtc.h>
+#include "ice_gatherer.h"
+#include "ice_gatherer_pool.h"
+
+#define DEBUG_MODULE "ice-gatherer-pool"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+static void replenish_timer_handler(
+    void* arg
+);
+
+/*
+ * Schedule replenishing the pool (unless already scheduled).
+ */
+static void schedule_replenish(
+        struct rawrtc_ice_gatherer_pool* const pool // not checked
+) {
+    if (!tmr_isrunning(&pool->replenish_timer)) {
+        tmr_start(&pool->replenish_timer, RAWRTC_ICE_GATHERER_POOL_REPLENISH_DELAY,
+                  replenish_timer_handler, pool);
+    }
+}
+
+/*
+ * Pooled ICE gatherer state change handler.
+ */
+static void pool_state_change_handler(
+        enum rawrtc_ice_gatherer_state const state, // read-only
+        void* const arg
+) {
+    struct rawrtc_ice_gatherer_pool_entry* const entry = arg;
+    struct rawrtc_ice_gatherer_pool* const pool = entry->pool;
+
+    switch (state) {
+        case RAWRTC_ICE_GATHERER_COMPLETE:
+            // Move to the head, so completed gatherers are being claimed first
+            DEBUG_PRINTF("Pooled gatherer complete\n");
+            list_unlink(&entry->le);
+            list_prepend(&pool->entries, &entry->le, entry);
+            break;
+        case RAWRTC_ICE_GATHERER_CLOSED:
+            // Remove from pool & replace it
+            // Note: Un-referencing is delayed as the gatherer is still in use.
+            DEBUG_NOTICE("Pooled gatherer closed, replacing it\n");
+            list_unlink(&entry->le);
+            list_append(&pool->closed_entries, &entry->le, entry);
+            schedule_replenish(pool);
+            break;
+        default:
+            break;
+    }
+}
+
+/*
+ * Pooled ICE gatherer interface change handler.
+ * Candidates gathered before the change may be stale, so the gatherer
+ * will be replaced.
+ */
+static void pool_interface_change_handler(
+        void* const arg
+) {
+    struct rawrtc_ice_gatherer_pool_entry* const entry = arg;
+
+    // Close (will be replaced)
+    DEBUG_INFO("Interfaces changed, replacing pooled gatherer\n");
+    rawrtc_ice_gatherer_close(entry->gatherer);
+}
+
+/*
+ * Destructor for an existing pooled ICE gatherer.
+ */
+static void rawrtc_ice_gatherer_pool_entry_destroy(
+        void* arg
+) {
+    struct rawrtc_ice_gatherer_pool_entry* const entry = arg;
+
+    // Remove from pool
+    list_unlink(&entry->le);
+
+    // Detach handlers, close & un-reference gatherer
+    if (entry->gatherer) {
+        rawrtc_ice_gatherer_set_handlers(entry->gatherer, NULL, NULL, NULL, NULL);
+        rawrtc_ice_gatherer_close(entry->gatherer);
+        mem_deref(entry->gatherer);
+    }
+}
+
+/*
+ * Create a pooled ICE gatherer and start gathering.
+ */
+static enum rawrtc_code entry_create(
+        struct rawrtc_ice_gatherer_pool* const pool // not checked
+) {
+    struct rawrtc_ice_gatherer_pool_entry* entry;
+    enum rawrtc_code error;
+
+    // Allocate
+    entry = mem_zalloc(sizeof(*entry), rawrtc_ice_gatherer_pool_entry_destroy);
+    if (!entry) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    entry->pool = pool;
+
+    // Create ICE gatherer
+    error = rawrtc_ice_gatherer_create(
+            &entry->gatherer, pool->options, pool_state_change_handler, NULL, NULL, entry);
+    if (error) {
+        goto out;
+    }
+
+    // Set interface change handler
+    error = rawrtc_ice_gatherer_set_interface_change_handler(
+            entry->gatherer, pool_interface_change_handler);
+    if (error) {
+        goto out;
+    }
+
+    // Append to pool
+    // Note: Needs to happen before gathering, as state changes move the entry.
+    list_append(&pool->entries, &entry->le, entry);
+
+    // Start gathering
+    error = rawrtc_ice_gatherer_gather(entry->gatherer, NULL);
+    if (error) {
+        goto out;
+    }
+
+out:
+    if (error) {
+        mem_deref(entry);
+    }
+    return error;
+}
+
+/*
+ * Create pooled ICE gatherers until the target size has been reached.
+ */
+static void replenish_timer_handler(
+        void* arg
+) {
+    struct rawrtc_ice_gatherer_pool* const pool = arg;
+    uint_fast16_t n;
+    enum rawrtc_code error;
+
+    // Remove closed gatherers
+    list_flush(&pool->closed_entries);
+
+    // Fill up
+    // Note: Gatherers closing immediately will be replaced on the next run.
+    for (n = (uint_fast16_t) list_count(&pool->entries); n < pool->size; ++n) {
+        error = entry_create(pool);
+        if (error) {
+            DEBUG_WARNING("Could not create pooled gatherer, reason: %s\n",
+                          rawrtc_code_to_str(error));
+            return;
+        }
+    }
+    DEBUG_PRINTF("Pool replenished (%"PRIuFAST16" gatherers)\n", pool->size);
+}
+
+/*
+ * Destructor for an existing ICE gatherer pool.
+ */
+static void rawrtc_ice_gatherer_pool_destroy(
+        void* arg
+) {
+    struct rawrtc_ice_gatherer_pool* const pool = arg;
+
+    // Stop replenishing
+    tmr_cancel(&pool->replenish_timer);
+
+    // Close & un-reference pooled gatherers
+    list_flush(&pool->entries);
+    list_flush(&pool->closed_entries);
+
+    // Un-reference
+    mem_deref(pool->options);
+}
+
+/*
+ * Create a pool of ICE gatherers that gather in the background so
+ * that a session can claim a gatherer whose candidates have already
+ * been gathered.
+ * `size` is the number of gatherers the pool keeps ready. Claimed
+ * gatherers will be replaced in the background.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_pool_create(
+        struct rawrtc_ice_gatherer_pool** const poolp, // de-referenced
+        struct rawrtc_ice_gather_options* const options, // referenced
+        uint_fast16_t const size
+) {
+    struct rawrtc_ice_gatherer_pool* pool;
+
+    // Check arguments
+    if (!poolp || !options || size == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    pool = mem_zalloc(sizeof(*pool), rawrtc_ice_gatherer_pool_destroy);
+    if (!pool) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/reference
+    pool->options = mem_ref(options);
+    pool->size = size;
+    list_init(&pool->entries);
+    list_init(&pool->closed_entries);
+    tmr_init(&pool->replenish_timer);
+
+    // Start gathering immediately
+    replenish_timer_handler(pool);
+
+    // Set pointer
+    *poolp = pool;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Claim an ICE gatherer from the pool.
+ * The gatherer's state changes and candidates gathered so far will be
+ * replayed to the handlers before this function returns. If the pool
+ * is empty, a new gatherer will be created and gathering will be
+ * started.
+ */
+enum rawrtc_code rawrtc_ice_gatherer_pool_claim(
+        struct rawrtc_ice_gatherer** const gathererp, // de-referenced
+        struct rawrtc_ice_gatherer_pool* const pool,
+        rawrtc_ice_gatherer_state_change_handler* const state_change_handler, // nullable
+        rawrtc_ice_gatherer_error_handler* const error_handler, // nullable
+        rawrtc_ice_gatherer_local_candidate_handler* const local_candidate_handler, // nullable
+        void* const arg // nullable
+) {
+    struct rawrtc_ice_gatherer_pool_entry* entry;
+    struct rawrtc_ice_gatherer* gatherer;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!gathererp || !pool) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Replenish in the background
+    schedule_replenish(pool);
+
+    // Pool empty? Create & gather now.
+    entry = list_ledata(list_head(&pool->entries));
+    if (!entry) {
+        DEBUG_NOTICE("Pool empty, creating gatherer on demand\n");
+        error = rawrtc_ice_gatherer_create(
+                &gatherer, pool->options, state_change_handler, error_handler,
+                local_candidate_handler, arg);
+        if (error) {
+            return error;
+        }
+        error = rawrtc_ice_gatherer_gather(gatherer, NULL);
+        if (error) {
+            mem_deref(gatherer);
+            return error;
+        }
+        *gathererp = gatherer;
+        return RAWRTC_CODE_SUCCESS;
+    }
+
+    // Take gatherer out of the pool
+    gatherer = entry->gatherer;
+    entry->gatherer = NULL;
+    mem_deref(entry);
+    DEBUG_PRINTF("Claimed pooled gatherer (%s)\n",
+                 gatherer->state == RAWRTC_ICE_GATHERER_COMPLETE ? "complete" : "gathering");
+
+    // Hand over to the caller
+    rawrtc_ice_gatherer_set_handlers(
+            gatherer, state_change_handler, error_handler, local_candidate_handler, arg);
+
+    // Set pointer & replay
+    *gathererp = gatherer;
+    error = rawrtc_ice_gatherer_replay(gatherer);
+    if (error) {
+        *gathererp = NULL;
+        mem_deref(gatherer);
+    }
+    return error;
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    RAWRTC_ICE_GATHERER_POOL_REPLENISH_DELAY = 50, // in milliseconds
+};
+
+/*
+ * Pooled ICE gatherer.
+ */
+struct rawrtc_ice_gatherer_pool_entry {
+    struct le le;
+    struct rawrtc_ice_gatherer_pool* pool;
+    struct rawrtc_ice_gatherer* gatherer; // referenced
+};
+
+/*
+ * Pool of pre-gathered ICE gatherers.
+ */
+struct rawrtc_ice_gatherer_pool {
+    struct rawrtc_ice_gather_options* options; // referenced
+    uint_fast16_t size; // target size
+    struct list entries; // completed gatherers first
+    struct list closed_entries; // to be removed
+    struct tmr replenish_timer;
+};
@@ -1,6 +1,10 @@
+#include <string.h> // strlen, strncmp
 #include <rawrtc.h>
 #include "ice_transport.h"
 #include "dtls_transport.h"
+#include "ice_gatherer.h"
+#include "ice_candidate.h"
+#include "timer_wheel.h"
 #include "utils.h"
 
 #define DEBUG_MODULE "ice-transport"
@@ -46,6 +50,12 @@ static void rawrtc_ice_transport_destroy(
     rawrtc_ice_transport_stop(transport);
 
     // Un-reference
+    list_flush(&transport->candidate_pair_rtts);
+    mem_deref(transport->nominating_candidate_pair);
+    mem_deref(transport->selected_candidate_pair);
+    list_flush(&transport->lite_candidate_pairs);
+    mem_deref(transport->consent_timer);
+    mem_deref(transport->options);
     mem_deref(transport->remote_parameters);
     mem_deref(transport->gatherer);
 }
@@ -61,6 +71,7 @@ enum rawrtc_code rawrtc_ice_transport_create(
         void* const arg // nullable
 ) {
     struct rawrtc_ice_transport* transport;
+    enum rawrtc_code error;
 
     // Check arguments
     if (!transportp || !gatherer) {
@@ -85,6 +96,16 @@ enum rawrtc_code rawrtc_ice_transport_create(
     transport->state_change_handler = state_change_handler;
     transport->candidate_pair_change_handler = candidate_pair_change_handler;
     transport->arg = arg;
+    list_init(&transport->lite_candidate_pairs);
+    tmr_init(&transport->lite_timer);
+    list_init(&transport->candidate_pair_rtts);
+
+    // Create consent freshness timer
+    error = rawrtc_timer_wheel_timer_alloc(&transport->consent_timer);
+    if (error) {
+        mem_deref(transport);
+        return error;
+    }
 
     // Set pointer
     *transportp = transport;
@@ -108,6 +129,491 @@ static void set_state(
     }
 }
 
+/*
+ * Get the ICE transport's options (or the default options).
+ */
+static struct rawrtc_ice_transport_options* get_options(
+        struct rawrtc_ice_transport* const transport
+) {
+    return transport->options ? transport->options : &rawrtc_default_ice_transport_options;
+}
+
+/*
+ * Check if a candidate pair is (still) in the list of valid candidate
+ * pairs.
+ */
+static bool is_valid_candidate_pair(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_candpair const* const candidate_pair // nullable
+) {
+    return candidate_pair && transport->gatherer->ice
+            && candidate_pair->le.list == trice_validl(transport->gatherer->ice);
+}
+
+/*
+ * Destructor for an existing candidate pair round-trip time.
+ */
+static void rawrtc_ice_candidate_pair_rtt_destroy(
+        void* arg
+) {
+    struct rawrtc_ice_candidate_pair_rtt* const entry = arg;
+
+    // Remove from list
+    list_unlink(&entry->le);
+
+    // Un-reference
+    mem_deref(entry->candidate_pair);
+}
+
+/*
+ * Get the round-trip time of a candidate pair (optionally creates an
+ * entry).
+ */
+static struct rawrtc_ice_candidate_pair_rtt* get_candidate_pair_rtt(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_candpair* const candidate_pair,
+        bool const create
+) {
+    struct le* le;
+    struct rawrtc_ice_candidate_pair_rtt* entry;
+
+    // Lookup
+    for (le = list_head(&transport->candidate_pair_rtts); le != NULL; le = le->next) {
+        entry = le->data;
+        if (entry->candidate_pair == candidate_pair) {
+            return entry;
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+
+    // Allocate
+    entry = mem_zalloc(sizeof(*entry), rawrtc_ice_candidate_pair_rtt_destroy);
+    if (!entry) {
+        return NULL;
+    }
+
+    // Set fields/reference & add to list
+    entry->candidate_pair = mem_ref(candidate_pair);
+    entry->check_sent = 0;
+    entry->rtt = 0;
+    entry->last_success = tmr_jiffies();
+    entry->n_lost = 0;
+    entry->n_consecutive_lost = 0;
+    entry->expired = false;
+    list_append(&transport->candidate_pair_rtts, &entry->le, entry);
+    return entry;
+}
+
+/*
+ * Remove round-trip times of candidate pairs that are no longer valid.
+ */
+static void prune_candidate_pair_rtts(
+        struct rawrtc_ice_transport* const transport
+) {
+    struct le* le = list_head(&transport->candidate_pair_rtts);
+    while (le) {
+        struct rawrtc_ice_candidate_pair_rtt* const entry = le->data;
+        le = le->next;
+        if (!is_valid_candidate_pair(transport, entry->candidate_pair)) {
+            mem_deref(entry);
+        }
+    }
+}
+
+/*
+ * Check if a candidate pair is valid and has consent.
+ */
+static bool is_usable_candidate_pair(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_candpair* const candidate_pair // nullable
+) {
+    struct rawrtc_ice_candidate_pair_rtt* entry;
+    if (!is_valid_candidate_pair(transport, candidate_pair)) {
+        return false;
+    }
+    entry = get_candidate_pair_rtt(transport, candidate_pair, false);
+    return !entry || !entry->expired;
+}
+
+/*
+ * Get the usable candidate pair with the lowest round-trip time (falls
+ * back to the usable candidate pair with the highest priority).
+ */
+static struct ice_candpair* get_best_candidate_pair(
+        struct rawrtc_ice_transport* const transport
+) {
+    struct ice_candpair* best = NULL;
+    uint32_t best_rtt = 0;
+    struct le* le;
+
+    if (!transport->gatherer->ice) {
+        return NULL;
+    }
+    for (le = list_head(trice_validl(transport->gatherer->ice)); le != NULL; le = le->next) {
+        struct ice_candpair* const candidate_pair = le->data;
+        struct rawrtc_ice_candidate_pair_rtt* const entry =
+                get_candidate_pair_rtt(transport, candidate_pair, false);
+        uint32_t const rtt = entry ? entry->rtt : 0;
+        if (entry && entry->expired) {
+            continue;
+        }
+        if (!best || (rtt != 0 && (best_rtt == 0 || rtt < best_rtt))) {
+            best = candidate_pair;
+            best_rtt = rtt;
+        }
+    }
+    return best;
+}
+
+/*
+ * Add a round-trip time sample to a candidate pair.
+ */
+static void add_candidate_pair_rtt_sample(
+        struct rawrtc_ice_candidate_pair_rtt* const entry,
+        uint32_t const sample
+) {
+    // Smooth (at least 1 ms as 0 means unknown)
+    if (entry->rtt == 0) {
+        entry->rtt = sample;
+    } else {
+        entry->rtt = (uint32_t) (((uint64_t) entry->rtt * (RAWRTC_ICE_TRANSPORT_RTT_SMOOTHING - 1)
+                + sample) / RAWRTC_ICE_TRANSPORT_RTT_SMOOTHING);
+    }
+    if (entry->rtt == 0) {
+        entry->rtt = 1;
+    }
+    DEBUG_PRINTF("Candidate pair RTT: %"PRIu32" ms (sample: %"PRIu32" ms)\n", entry->rtt, sample);
+}
+
+/*
+ * Refresh the consent of a candidate pair once a check of ours
+ * succeeded and update its round-trip time (if a consent check was
+ * outstanding).
+ * Note: The ICE agent also reports candidate pairs nominated by a
+ *       request of the peer. Neither refreshes consent (RFC 7675,
+ *       section 5.1) nor is a round-trip time sample.
+ */
+static void update_candidate_pair_rtt(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_candpair* const candidate_pair,
+        struct stun_msg const* const message // nullable
+) {
+    struct rawrtc_ice_candidate_pair_rtt* entry;
+    uint64_t const now = tmr_jiffies();
+
+    // Response to a check of ours?
+    if (!message || stun_msg_class(message) != STUN_CLASS_SUCCESS_RESP) {
+        return;
+    }
+
+    // Get entry
+    entry = get_candidate_pair_rtt(transport, candidate_pair, true);
+    if (!entry) {
+        return;
+    }
+
+    // Refresh consent
+    entry->last_success = now;
+    if (entry->expired) {
+        DEBUG_INFO("Consent regained on candidate pair %H\n",
+                   trice_candpair_debug, candidate_pair);
+        entry->expired = false;
+    }
+
+    // Outstanding consent check?
+    if (entry->check_sent != 0) {
+        add_candidate_pair_rtt_sample(entry, (uint32_t) (now - entry->check_sent));
+        entry->check_sent = 0;
+        entry->n_consecutive_lost = 0;
+    }
+}
+
+/*
+ * Select a candidate pair, update the DTLS transport's route and
+ * announce the change.
+ */
+static void select_candidate_pair(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_candpair* const candidate_pair // nullable
+) {
+    struct rawrtc_ice_candidate* local_candidate = NULL;
+    struct rawrtc_ice_candidate* remote_candidate = NULL;
+    enum rawrtc_code error;
+
+    // Unchanged?
+    if (candidate_pair == transport->selected_candidate_pair) {
+        return;
+    }
+
+    // Replace
+    mem_deref(transport->selected_candidate_pair);
+    transport->selected_candidate_pair = mem_ref(candidate_pair);
+    transport->selection_time = tmr_jiffies();
+    if (!candidate_pair) {
+        return;
+    }
+    DEBUG_INFO("Selected candidate pair: %H\n", trice_candpair_debug, candidate_pair);
+
+    // Update the DTLS transport's route
+    if (transport->dtls_transport) {
+        error = rawrtc_dtls_transport_update_route(transport->dtls_transport);
+        if (error) {
+            DEBUG_WARNING("Could not update DTLS transport route, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        }
+    }
+
+    // The previous session is no longer needed (if restarted)
+    rawrtc_ice_gatherer_release_previous_session(transport->gatherer);
+
+    // Call handler (if any)
+    if (transport->candidate_pair_change_handler) {
+        error = rawrtc_ice_candidate_create_from_local_candidate(
+                &local_candidate, candidate_pair->lcand);
+        if (!error) {
+            error = rawrtc_ice_candidate_create_from_remote_candidate(
+                    &remote_candidate, candidate_pair->rcand);
+        }
+        if (error) {
+            DEBUG_WARNING("Could not announce selected candidate pair, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        } else {
+            transport->candidate_pair_change_handler(
+                    local_candidate, remote_candidate, transport->arg);
+        }
+        mem_deref(remote_candidate);
+        mem_deref(local_candidate);
+    }
+}
+
+/*
+ * Ensure a valid candidate pair with consent is selected (falls back to
+ * the best remaining candidate pair).
+ */
+static void update_selected_candidate_pair(
+        struct rawrtc_ice_transport* const transport
+) {
+    if (is_usable_candidate_pair(transport, transport->selected_candidate_pair)) {
+        return;
+    }
+    select_candidate_pair(transport, get_best_candidate_pair(transport));
+}
+
+/*
+ * Re-nominate the valid candidate pair with the lowest round-trip time
+ * if it is considerably lower than the one of the selected candidate
+ * pair (controlling only). The candidate pair is being selected once
+ * the nominating check succeeded.
+ * Note: The controlled agent never switches on its own, it only falls
+ *       back to another candidate pair once consent expired.
+ * Note: Hysteresis (minimum gain and hold time) prevents flapping
+ *       between candidate pairs with similar round-trip times.
+ */
+static void reselect_candidate_pair(
+        struct rawrtc_ice_transport* const transport
+) {
+    struct ice_candpair* const selected = transport->selected_candidate_pair;
+    uint32_t selected_rtt = 0;
+    struct rawrtc_ice_candidate_pair_rtt* best = NULL;
+    struct le* le;
+    int err;
+
+    // Controlling and no re-nomination in progress?
+    if (!transport->gatherer->ice
+            || trice_local_role(transport->gatherer->ice) != ROLE_CONTROLLING
+            || is_valid_candidate_pair(transport, transport->nominating_candidate_pair)) {
+        return;
+    }
+    transport->nominating_candidate_pair = mem_deref(transport->nominating_candidate_pair);
+
+    // Held?
+    if (!selected || tmr_jiffies() - transport->selection_time
+            < RAWRTC_ICE_TRANSPORT_RESELECT_HOLD_TIME) {
+        return;
+    }
+
+    // Find the candidate pair with the lowest round-trip time (and no recent loss)
+    for (le = list_head(&transport->candidate_pair_rtts); le != NULL; le = le->next) {
+        struct rawrtc_ice_candidate_pair_rtt* const entry = le->data;
+        if (entry->rtt == 0 || entry->expired
+                || !is_valid_candidate_pair(transport, entry->candidate_pair)) {
+            continue;
+        }
+        if (entry->candidate_pair != selected && entry->n_consecutive_lost > 0) {
+            continue;
+        }
+        if (entry->candidate_pair == selected) {
+            selected_rtt = entry->rtt;
+        } else if (!best || entry->rtt < best->rtt) {
+            best = entry;
+        }
+    }
+    if (!best || selected_rtt == 0) {
+        return;
+    }
+
+    // Considerably lower?
+    if (best->rtt + RAWRTC_ICE_TRANSPORT_RESELECT_MIN_GAIN > selected_rtt
+            || (uint64_t) best->rtt * 100
+               > (uint64_t) selected_rtt * (100 - RAWRTC_ICE_TRANSPORT_RESELECT_MIN_GAIN_PERCENT)) {
+        return;
+    }
+
+    // Re-nominate (USE-CANDIDATE)
+    DEBUG_INFO("Re-nominating candidate pair, RTT %"PRIu32" ms -> %"PRIu32" ms: %H\n",
+               selected_rtt, best->rtt, trice_candpair_debug, best->candidate_pair);
+    err = trice_conncheck_send(transport->gatherer->ice, best->candidate_pair, true);
+    if (err) {
+        DEBUG_WARNING("Could not re-nominate candidate pair, reason: %m\n", err);
+        return;
+    }
+    transport->nominating_candidate_pair = mem_ref(best->candidate_pair);
+}
+
+/*
+ * Select the candidate pair being re-nominated once the nominating
+ * check succeeded.
+ */
+static void complete_renomination(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_candpair* const candidate_pair, // nullable
+        struct stun_msg const* const message // nullable
+) {
+    // Response to the nominating check?
+    if (!candidate_pair || candidate_pair != transport->nominating_candidate_pair
+            || !candidate_pair->nominated
+            || !message || stun_msg_class(message) != STUN_CLASS_SUCCESS_RESP) {
+        return;
+    }
+
+    // Select
+    transport->nominating_candidate_pair = mem_deref(transport->nominating_candidate_pair);
+    if (is_usable_candidate_pair(transport, candidate_pair)) {
+        select_candidate_pair(transport, candidate_pair);
+    }
+}
+
+/*
+ * Nominate the valid candidate pair with the highest priority once all
+ * checks are done (regular nomination, controlling only).
+ */
+static void nominate_candidate_pair(
+        struct rawrtc_ice_transport* const transport
+) {
+    struct ice_candpair* candidate_pair;
+    int err;
+
+    // Regular nomination, controlling and not nominated, yet?
+    if (get_options(transport)->nomination != RAWRTC_ICE_NOMINATION_REGULAR
+            || trice_local_role(transport->gatherer->ice) != ROLE_CONTROLLING
+            || transport->nomination_sent) {
+        return;
+    }
+
+    // Checks done?
+    if (!trice_checklist_iscompleted(transport->gatherer->ice)) {
+        return;
+    }
+
+    // Get best valid candidate pair
+    candidate_pair = list_ledata(list_head(trice_validl(transport->gatherer->ice)));
+    if (!candidate_pair) {
+        return;
+    }
+
+    // Send nominating check (USE-CANDIDATE)
+    DEBUG_INFO("Nominating candidate pair: %H\n", trice_candpair_debug, candidate_pair);
+    err = trice_conncheck_send(transport->gatherer->ice, candidate_pair, true);
+    if (err) {
+        DEBUG_WARNING("Could not nominate candidate pair, reason: %m\n", err);
+        return;
+    }
+    transport->nomination_sent = true;
+}
+
+/*
+ * Send consent freshness checks (RFC 7675) on all valid candidate pairs
+ * and expire the consent of candidate pairs whose checks have not been
+ * answered in time. Also serves as keep-alive.
+ */
+static void consent_timer_handler(
+        void* arg
+) {
+    struct rawrtc_ice_transport* const transport = arg;
+    struct trice* const ice = transport->gatherer->ice;
+    uint64_t const now = tmr_jiffies();
+    struct le* le;
+    int err;
+
+    // Ignore unless connected
+    if (transport->state != RAWRTC_ICE_TRANSPORT_STATE_CONNECTED
+            && transport->state != RAWRTC_ICE_TRANSPORT_STATE_COMPLETED) {
+        return;
+    }
+
+    // Send checks on all valid candidate pairs
+    // Note: Consent is tracked per candidate pair. The checks on other candidate pairs than the
+    //       selected one also measure round-trip times for re-selection.
+    // Note: Without a running checklist, responses cannot be handled, so consent cannot be
+    //       verified either.
+    if (!list_isempty(trice_validl(ice)) && trice_checklist_isrunning(ice)) {
+        prune_candidate_pair_rtts(transport);
+        for (le = list_head(trice_validl(ice)); le != NULL; le = le->next) {
+            struct ice_candpair* const candidate_pair = le->data;
+            struct rawrtc_ice_candidate_pair_rtt* const entry =
+                    get_candidate_pair_rtt(transport, candidate_pair, true);
+            if (!entry) {
+                continue;
+            }
+
+            // Consent expired?
+            if (!entry->expired
+                    && now - entry->last_success > RAWRTC_ICE_TRANSPORT_CONSENT_TIMEOUT) {
+                DEBUG_NOTICE("Consent expired on candidate pair %H, no check succeeded "
+                             "within %u ms\n", trice_candpair_debug, candidate_pair,
+                             RAWRTC_ICE_TRANSPORT_CONSENT_TIMEOUT);
+                entry->expired = true;
+            }
+
+            // Previous check unanswered? Count as loss (not as round-trip time sample).
+            if (entry->check_sent != 0) {
+                ++entry->n_lost;
+                ++entry->n_consecutive_lost;
+                DEBUG_PRINTF("Consent check lost on candidate pair %H (%"PRIu32" in a row, "
+                             "%"PRIu32" total)\n", trice_candpair_debug, candidate_pair,
+                             entry->n_consecutive_lost, entry->n_lost);
+            }
+
+            // Send check
+            err = trice_conncheck_send(ice, candidate_pair, false);
+            if (err) {
+                DEBUG_NOTICE("Could not send consent check, reason: %m\n", err);
+                entry->check_sent = 0;
+                continue;
+            }
+            entry->check_sent = now;
+        }
+
+        // Fall back to the best remaining candidate pair (if the selected one expired)
+        update_selected_candidate_pair(transport);
+        if (!transport->selected_candidate_pair) {
+            DEBUG_NOTICE("Consent expired on all candidate pairs\n");
+            set_state(transport, RAWRTC_ICE_TRANSPORT_STATE_FAILED);
+            return;
+        }
+        reselect_candidate_pair(transport);
+    }
+
+    // Restart (spread out to prevent bursts)
+    rawrtc_timer_wheel_start(
+            transport->consent_timer,
+            rawrtc_timer_wheel_jitter(RAWRTC_ICE_TRANSPORT_CONSENT_INTERVAL,
+                                      RAWRTC_ICE_TRANSPORT_CONSENT_JITTER),
+            consent_timer_handler, transport);
+}
+
 /*
  * ICE connection established callback.
  */
@@ -118,7 +624,6 @@ static void ice_established_handler(
 ) {
     struct rawrtc_ice_transport* const transport = arg;
     enum rawrtc_code error;
-    (void) message;
 
     DEBUG_PRINTF("Candidate pair established: %H\n", trice_candpair_debug, candidate_pair);
 
@@ -127,10 +632,26 @@ static void ice_established_handler(
         return;
     }
 
+    // Update timeline
+    if (candidate_pair->nominated) {
+        rawrtc_timestamp_once(&transport->timeline.nominated);
+    }
+
     // State: checking -> connected
     if (transport->state == RAWRTC_ICE_TRANSPORT_STATE_CHECKING) {
         DEBUG_INFO("ICE connection established\n");
         set_state(transport, RAWRTC_ICE_TRANSPORT_STATE_CONNECTED);
+
+        // Start consent freshness checks
+        error = rawrtc_timer_wheel_start(
+                transport->consent_timer,
+                rawrtc_timer_wheel_jitter(RAWRTC_ICE_TRANSPORT_CONSENT_INTERVAL,
+                                          RAWRTC_ICE_TRANSPORT_CONSENT_JITTER),
+                consent_timer_handler, transport);
+        if (error) {
+            DEBUG_WARNING("Could not start consent freshness checks, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        }
     }
 
     // TODO: Re-enable once 'completed' state has been fixed
@@ -152,15 +673,27 @@ static void ice_established_handler(
 
             // Remove candidate pair
             mem_deref(candidate_pair);
+            candidate_pair = NULL;
         }
     }
 
-    // TODO: Call candidate_pair_change_handler (?)
+    // Refresh consent & measure round-trip time (if this was a check of ours)
+    if (candidate_pair) {
+        update_candidate_pair_rtt(transport, candidate_pair, message);
+    }
+
+    // Select candidate pair (if none selected), the re-nominated one or re-nominate a faster one
+    update_selected_candidate_pair(transport);
+    complete_renomination(transport, candidate_pair, message);
+    reselect_candidate_pair(transport);
 
     // Completed all candidate pairs?
     if (trice_checklist_iscompleted(transport->gatherer->ice)) {
         DEBUG_INFO("Checklist completed:\n%H", trice_debug, transport->gatherer->ice);
 
+        // Nominate (if regular nomination)
+        nominate_candidate_pair(transport);
+
 //        // At least one candidate pair succeeded, transition to completed
 //        DEBUG_INFO("ICE connection completed\n");
 //        // TODO: ORTC spec says: Only transition to completed if end-of-candidates has been added
@@ -179,6 +712,7 @@ static void ice_failed_handler(
         void* arg
 ) {
     struct rawrtc_ice_transport* const transport = arg;
+    enum rawrtc_code error;
     (void) err; (void) stun_code; (void) candidate_pair;
 
     DEBUG_PRINTF("Candidate pair failed: %H (%m %"PRIu16")\n",
@@ -189,6 +723,18 @@ static void ice_failed_handler(
         return;
     }
 
+    // Select another candidate pair (if the failed candidate pair has been selected)
+    update_selected_candidate_pair(transport);
+
+    // Update the DTLS transport's route (the failed candidate pair may have been selected)
+    if (transport->dtls_transport) {
+        error = rawrtc_dtls_transport_update_route(transport->dtls_transport);
+        if (error) {
+            DEBUG_WARNING("Could not update DTLS transport route, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        }
+    }
+
     // Ignore if completed
     // Note: This case can happen when the checklist is completed but an ICE candidate triggers
     //       a late failed event.
@@ -202,6 +748,9 @@ static void ice_failed_handler(
 
         // Do we have one candidate pair that succeeded?
         if (!list_isempty(trice_validl(transport->gatherer->ice))) {
+            // Nominate (if regular nomination)
+            nominate_candidate_pair(transport);
+
             // Yes, transition to completed
             DEBUG_INFO("ICE connection completed\n");
             // TODO: ORTC spec says: Only transition to completed if end-of-candidates has been
@@ -215,6 +764,284 @@ static void ice_failed_handler(
     }
 }
 
+/*
+ * Announce nominated candidate pairs (ICE lite only).
+ * Note: This is being called from a timer so the STUN response is sent
+ *       before anything else is being sent on the candidate pair.
+ */
+static void lite_timer_handler(
+        void* arg
+) {
+    struct rawrtc_ice_transport* const transport = arg;
+    struct le* le;
+    enum rawrtc_code error;
+
+    // Ignore if closed
+    if (transport->state == RAWRTC_ICE_TRANSPORT_STATE_CLOSED) {
+        return;
+    }
+
+    // Announce new candidate pairs
+    for (le = list_head(&transport->lite_candidate_pairs); le != NULL; le = le->next) {
+        struct rawrtc_ice_lite_candidate_pair* const candidate_pair = le->data;
+        if (candidate_pair->announced) {
+            continue;
+        }
+        candidate_pair->announced = true;
+        DEBUG_PRINTF("Candidate pair nominated: %H\n", trice_candpair_debug, &candidate_pair->pair);
+
+        // State: checking -> connected
+        if (transport->state == RAWRTC_ICE_TRANSPORT_STATE_CHECKING) {
+            DEBUG_INFO("ICE connection established\n");
+            set_state(transport, RAWRTC_ICE_TRANSPORT_STATE_CONNECTED);
+        }
+
+        // Offer candidate pair to DTLS transport (if any)
+        if (transport->dtls_transport) {
+            error = rawrtc_dtls_transport_add_candidate_pair(
+                    transport->dtls_transport, &candidate_pair->pair);
+            if (error) {
+                DEBUG_WARNING("DTLS transport could not attach to candidate pair, reason: %s\n",
+                              rawrtc_code_to_str(error));
+            }
+        }
+    }
+
+    // Update the DTLS transport's route (a candidate pair may have been re-nominated)
+    if (transport->dtls_transport) {
+        error = rawrtc_dtls_transport_update_route(transport->dtls_transport);
+        if (error) {
+            DEBUG_WARNING("Could not update DTLS transport route, reason: %s\n",
+                          rawrtc_code_to_str(error));
+        }
+    }
+
+    // The previous session is no longer needed (if restarted)
+    if (!list_isempty(&transport->lite_candidate_pairs)) {
+        rawrtc_ice_gatherer_release_previous_session(transport->gatherer);
+    }
+}
+
+/*
+ * Destructor for an existing ICE lite candidate pair.
+ */
+static void rawrtc_ice_lite_candidate_pair_destroy(
+        void* arg
+) {
+    struct rawrtc_ice_lite_candidate_pair* const candidate_pair = arg;
+
+    // Remove from list
+    list_unlink(&candidate_pair->le);
+
+    // Un-reference
+    mem_deref(candidate_pair->pair.lcand);
+}
+
+/*
+ * Add or re-nominate a candidate pair (ICE lite only). The candidate
+ * pair will become the selected candidate pair.
+ */
+static enum rawrtc_code lite_nominate_candidate_pair(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_lcand* const local_candidate,
+        struct sa const* const address,
+        uint32_t const priority
+) {
+    struct le* le;
+    struct rawrtc_ice_lite_candidate_pair* candidate_pair;
+    struct ice_rcand* remote_candidate;
+
+    // Already nominated?
+    for (le = list_head(&transport->lite_candidate_pairs); le != NULL; le = le->next) {
+        candidate_pair = le->data;
+        if (candidate_pair->pair.lcand == local_candidate
+                && sa_cmp(&candidate_pair->remote_candidate.attr.addr, address, SA_ALL)) {
+            // Select (if not already selected)
+            if (le != list_head(&transport->lite_candidate_pairs)) {
+                list_unlink(le);
+                list_prepend(&transport->lite_candidate_pairs, le, &candidate_pair->pair);
+                tmr_start(&transport->lite_timer, 0, lite_timer_handler, transport);
+            }
+            return RAWRTC_CODE_SUCCESS;
+        }
+    }
+
+    // Allocate
+    candidate_pair = mem_zalloc(sizeof(*candidate_pair), rawrtc_ice_lite_candidate_pair_destroy);
+    if (!candidate_pair) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Use signalled remote candidate (if any), otherwise peer reflexive
+    remote_candidate = NULL;
+    for (le = list_head(trice_rcandl(transport->gatherer->ice)); le != NULL; le = le->next) {
+        struct ice_rcand* const candidate = le->data;
+        if (candidate->attr.compid == local_candidate->attr.compid
+                && candidate->attr.proto == local_candidate->attr.proto
+                && sa_cmp(&candidate->attr.addr, address, SA_ALL)) {
+            remote_candidate = candidate;
+            break;
+        }
+    }
+    if (remote_candidate) {
+        candidate_pair->remote_candidate.attr = remote_candidate->attr;
+    } else {
+        candidate_pair->remote_candidate.attr.compid = local_candidate->attr.compid;
+        candidate_pair->remote_candidate.attr.proto = local_candidate->attr.proto;
+        candidate_pair->remote_candidate.attr.prio = priority;
+        candidate_pair->remote_candidate.attr.type = ICE_CAND_TYPE_PRFLX;
+        sa_cpy(&candidate_pair->remote_candidate.attr.addr, address);
+    }
+
+    // Set fields/reference
+    candidate_pair->pair.lcand = mem_ref(local_candidate);
+    candidate_pair->pair.rcand = &candidate_pair->remote_candidate;
+    candidate_pair->pair.state = ICE_CANDPAIR_SUCCEEDED;
+    candidate_pair->pair.valid = true;
+    candidate_pair->pair.nominated = true;
+
+    // Select & announce
+    list_prepend(&transport->lite_candidate_pairs, &candidate_pair->le, &candidate_pair->pair);
+    tmr_start(&transport->lite_timer, 0, lite_timer_handler, transport);
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Inspect a STUN message received on a local candidate (ICE lite only).
+ * Authenticated binding requests carrying USE-CANDIDATE nominate the
+ * candidate pair. The request itself will be answered by trice.
+ * Returns `true` if the candidate pair has been nominated.
+ */
+bool rawrtc_ice_transport_lite_receive(
+        struct rawrtc_ice_transport* const transport,
+        struct ice_lcand* const local_candidate,
+        struct sa const* const source,
+        struct mbuf* const buffer
+) {
+    size_t const position = buffer->pos;
+    struct stun_msg* message = NULL;
+    struct stun_attr* attribute;
+    char const* const username_fragment = transport->gatherer->ice_username_fragment;
+    size_t const username_fragment_length = strlen(username_fragment);
+    char const* const password = transport->gatherer->ice_password;
+    uint32_t priority;
+    bool nominated = false;
+    enum rawrtc_code error;
+
+    // Ignore if closed
+    if (transport->state == RAWRTC_ICE_TRANSPORT_STATE_CLOSED) {
+        return false;
+    }
+
+    // Decode (ignore anything other than a binding request)
+    if (stun_msg_decode(&message, buffer, NULL)
+            || stun_msg_method(message) != STUN_METHOD_BINDING
+            || stun_msg_class(message) != STUN_CLASS_REQUEST) {
+        goto out;
+    }
+    rawrtc_timestamp_once(&transport->timeline.checks_started);
+
+    // Nominating?
+    if (!stun_msg_attr(message, STUN_ATTR_USE_CAND)) {
+        goto out;
+    }
+
+    // Check username ('<local ufrag>:<remote ufrag>') and message integrity
+    attribute = stun_msg_attr(message, STUN_ATTR_USERNAME);
+    if (!attribute || strncmp(attribute->v.username, username_fragment, username_fragment_length)
+            || attribute->v.username[username_fragment_length] != ':') {
+        goto out;
+    }
+    if (stun_msg_chk_mi(message, (uint8_t const*) password, strlen(password))) {
+        DEBUG_NOTICE("Ignoring nomination from %J, message integrity check failed\n", source);
+        goto out;
+    }
+
+    // Nominate candidate pair
+    attribute = stun_msg_attr(message, STUN_ATTR_PRIORITY);
+    priority = attribute ? attribute->v.priority : 0;
+    error = lite_nominate_candidate_pair(transport, local_candidate, source, priority);
+    if (error) {
+        DEBUG_WARNING("Could not nominate candidate pair, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        goto out;
+    }
+    rawrtc_timestamp_once(&transport->timeline.nominated);
+    nominated = true;
+
+out:
+    // Rewind (trice still needs to handle the message)
+    mem_deref(message);
+    buffer->pos = position;
+    return nominated;
+}
+
+/*
+ * Get the valid candidate pairs of the ICE transport. The first
+ * candidate pair is the selected one.
+ */
+struct list* rawrtc_ice_transport_valid_candidate_pairs(
+        struct rawrtc_ice_transport* const transport
+) {
+    if (transport->gatherer->options->ice_lite) {
+        return &transport->lite_candidate_pairs;
+    } else {
+        return trice_validl(transport->gatherer->ice);
+    }
+}
+
+/*
+ * Get the selected candidate pair of the ICE transport (if any).
+ */
+struct ice_candpair* rawrtc_ice_transport_selected_candidate_pair(
+        struct rawrtc_ice_transport* const transport
+) {
+    // ICE lite: Selected by the remote peer's nomination
+    if (transport->gatherer->options->ice_lite) {
+        return list_ledata(list_head(&transport->lite_candidate_pairs));
+    }
+
+    // Selected or the valid candidate pair with the highest priority
+    if (!transport->gatherer->ice) {
+        return NULL;
+    }
+    if (is_valid_candidate_pair(transport, transport->selected_candidate_pair)) {
+        return transport->selected_candidate_pair;
+    }
+    return list_ledata(list_head(trice_validl(transport->gatherer->ice)));
+}
+
+/*
+ * Start the checklist using the ICE transport's options.
+ */
+static enum rawrtc_code start_checklist(
+        struct rawrtc_ice_transport* const transport
+) {
+    struct rawrtc_ice_transport_options* const options = get_options(transport);
+    struct stun* stun;
+    enum rawrtc_code error;
+
+    // Create STUN instance for connectivity checks (retransmission parameters)
+    error = rawrtc_error_to_code(stun_alloc(&stun, &options->stun_config, NULL, NULL));
+    if (error) {
+        return error;
+    }
+
+    // Start checklist
+    error = rawrtc_error_to_code(trice_checklist_start(
+            transport->gatherer->ice, stun, options->pacing_interval,
+            options->nomination == RAWRTC_ICE_NOMINATION_AGGRESSIVE,
+            ice_established_handler, ice_failed_handler, transport));
+    mem_deref(stun);
+    if (error) {
+        return error;
+    }
+
+    // Update timeline
+    rawrtc_timestamp_once(&transport->timeline.checks_started);
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Start the ICE transport.
  * TODO https://github.com/w3c/ortc/issues/607
@@ -223,10 +1050,12 @@ enum rawrtc_code rawrtc_ice_transport_start(
         struct rawrtc_ice_transport* const transport,
         struct rawrtc_ice_gatherer* const gatherer, // referenced
         struct rawrtc_ice_parameters* const remote_parameters, // referenced
-        enum rawrtc_ice_role const role
+        enum rawrtc_ice_role role
 ) {
+    bool ice_lite;
     bool ice_transport_closed;
     bool ice_gatherer_closed;
+    bool restart;
     enum trice_role translated_role;
     enum rawrtc_code error;
 
@@ -240,8 +1069,9 @@ enum rawrtc_code rawrtc_ice_transport_start(
         return RAWRTC_CODE_INVALID_ARGUMENT;
     }
 
-    // TODO: Handle ICE lite
-    if (remote_parameters->ice_lite) {
+    // TODO: Handle both sides being ICE lite (RFC 8445, section 6.1.1)
+    ice_lite = gatherer->options->ice_lite;
+    if (ice_lite && remote_parameters->ice_lite) {
         return RAWRTC_CODE_NOT_IMPLEMENTED;
     }
 
@@ -254,17 +1084,55 @@ enum rawrtc_code rawrtc_ice_transport_start(
         return RAWRTC_CODE_INVALID_STATE;
     }
 
-    // TODO: Handle ICE restart when called again
-    if (transport->state != RAWRTC_ICE_TRANSPORT_STATE_NEW) {
-        return RAWRTC_CODE_NOT_IMPLEMENTED;
-    }
-
     // Check if gatherer instance is different
     // TODO https://github.com/w3c/ortc/issues/607
     if (transport->gatherer != gatherer) {
         return RAWRTC_CODE_NOT_IMPLEMENTED;
     }
 
+    // ICE restart? (RFC 8445, section 9)
+    restart = transport->state != RAWRTC_ICE_TRANSPORT_STATE_NEW;
+    if (restart) {
+        // Unchanged remote parameters? Nothing to do.
+        if (str_cmp(transport->remote_parameters->username_fragment,
+                    remote_parameters->username_fragment) == 0
+                && str_cmp(transport->remote_parameters->password,
+                           remote_parameters->password) == 0) {
+            return RAWRTC_CODE_SUCCESS;
+        }
+
+        // Ensure the gatherer has been restarted (both sides need new parameters)
+        if (str_cmp(transport->local_username_fragment, gatherer->ice_username_fragment) == 0) {
+            DEBUG_WARNING("ICE restart requires the gatherer to be restarted first\n");
+            return RAWRTC_CODE_INVALID_STATE;
+        }
+
+        // Stop consent freshness checks and handling nominations
+        // Note: The DTLS transport (and everything on top of it) is being kept. It migrates to
+        //       the new selected candidate pair once established.
+        DEBUG_INFO("ICE restart\n");
+        rawrtc_timer_wheel_cancel(transport->consent_timer);
+        tmr_cancel(&transport->lite_timer);
+        list_flush(&transport->lite_candidate_pairs);
+        transport->nomination_sent = false;
+
+        // Forget candidate pairs of the previous session
+        // Note: The DTLS transport's route is being kept until the restarted session selected a
+        //       candidate pair (RFC 8445, section 9).
+        list_flush(&transport->candidate_pair_rtts);
+        transport->nominating_candidate_pair = mem_deref(transport->nominating_candidate_pair);
+        transport->selected_candidate_pair = mem_deref(transport->selected_candidate_pair);
+    }
+
+    // ICE lite agents are always controlled by the full agent (RFC 8445, section 6.1.1)
+    if (ice_lite && role != RAWRTC_ICE_ROLE_CONTROLLED) {
+        DEBUG_NOTICE("Switching role to 'controlled' (local ICE lite)\n");
+        role = RAWRTC_ICE_ROLE_CONTROLLED;
+    } else if (remote_parameters->ice_lite && role != RAWRTC_ICE_ROLE_CONTROLLING) {
+        DEBUG_NOTICE("Switching role to 'controlling' (remote ICE lite)\n");
+        role = RAWRTC_ICE_ROLE_CONTROLLING;
+    }
+
     // Set role (abort if unknown or something entirely weird)
     translated_role = rawrtc_ice_role_to_trice_role(role);
     error = rawrtc_error_to_code(trice_set_role(transport->gatherer->ice, translated_role));
@@ -272,8 +1140,8 @@ enum rawrtc_code rawrtc_ice_transport_start(
         return error;
     }
 
-    // New/first remote parameters?
-    if (transport->remote_parameters != remote_parameters) {
+    // New/first remote parameters (or new trice instance after a restart)?
+    if (restart || transport->remote_parameters != remote_parameters) {
         // Apply username fragment and password on trice
         error = rawrtc_error_to_code(trice_set_remote_ufrag(
                 transport->gatherer->ice, remote_parameters->username_fragment));
@@ -291,20 +1159,26 @@ enum rawrtc_code rawrtc_ice_transport_start(
         transport->remote_parameters = mem_ref(remote_parameters);
     }
 
+    // Remember local username fragment (to detect a restarted gatherer)
+    str_ncpy(transport->local_username_fragment, gatherer->ice_username_fragment,
+             sizeof(transport->local_username_fragment));
+
     // Set state to checking
     // TODO: Get more states from trice
     // TODO: Is this actually correct if we don't have any remote candidates?
     set_state(transport, RAWRTC_ICE_TRANSPORT_STATE_CHECKING);
 
+    // ICE lite: No checklist, wait for the remote peer to nominate candidate pairs
+    if (ice_lite) {
+        DEBUG_INFO("Waiting for nominations (ICE lite)\n");
+        gatherer->lite_transport = transport;
+        return RAWRTC_CODE_SUCCESS;
+    }
+
     // Start checklist (if remote candidates exist)
     if (!list_isempty(trice_rcandl(transport->gatherer->ice))) {
-        // TODO: Get config from struct
-        // TODO: Why are there no keep-alive messages?
-        // TODO: Set 'use_cand' properly
         DEBUG_INFO("Starting checklist due to start event\n");
-        error = rawrtc_error_to_code(trice_checklist_start(
-                transport->gatherer->ice, NULL, rawrtc_default_config.pacing_interval, true,
-                ice_established_handler, ice_failed_handler, transport));
+        error = start_checklist(transport);
         if (error) {
             return error;
         }
@@ -335,6 +1209,15 @@ enum rawrtc_code rawrtc_ice_transport_stop(
         trice_checklist_stop(transport->gatherer->ice);
     }
 
+    // Stop consent freshness checks
+    rawrtc_timer_wheel_cancel(transport->consent_timer);
+
+    // Stop handling nominations (if ICE lite)
+    tmr_cancel(&transport->lite_timer);
+    if (transport->gatherer->lite_transport == transport) {
+        transport->gatherer->lite_transport = NULL;
+    }
+
     // TODO: Remove remote candidates, role, username fragment and password from rew
 
     // TODO: Remove from RTCICETransportController (once we have it)
@@ -382,6 +1265,50 @@ enum rawrtc_code rawrtc_ice_transport_get_role(
     }
 }
 
+/*
+ * Set the ICE transport's options. Must be called before the ICE
+ * transport has been started.
+ */
+enum rawrtc_code rawrtc_ice_transport_set_options(
+        struct rawrtc_ice_transport* const transport,
+        struct rawrtc_ice_transport_options* const options // referenced
+) {
+    // Check arguments
+    if (!transport || !options) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (transport->state != RAWRTC_ICE_TRANSPORT_STATE_NEW) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Replace
+    mem_deref(transport->options);
+    transport->options = mem_ref(options);
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Get the connection setup timeline of an ICE transport (including the
+ * DTLS and SCTP transports on top of it).
+ */
+enum rawrtc_code rawrtc_ice_transport_get_setup_timeline(
+        struct rawrtc_setup_timeline* const timelinep, // de-referenced
+        struct rawrtc_ice_transport* const transport
+) {
+    // Check arguments
+    if (!timelinep || !transport) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Copy timeline (gathering events are being recorded by the gatherer)
+    *timelinep = transport->timeline;
+    timelinep->gathering_started = transport->gatherer->timeline.gathering_started;
+    timelinep->first_local_candidate = transport->gatherer->timeline.first_local_candidate;
+    return RAWRTC_CODE_SUCCESS;
+}
+
 /*
  * Add a remote candidate ot the ICE transport.
  * Note: 'candidate' must be NULL to inform the transport that the
@@ -514,22 +1441,18 @@ enum rawrtc_code rawrtc_ice_transport_add_remote_candidate(
         goto out;
     }
 
-    // TODO: Add TURN permission
+    // Add TURN permissions (if relaying)
+    rawrtc_ice_gatherer_add_turn_peer(transport->gatherer, &re_candidate->attr.addr);
 
     // Done
     DEBUG_PRINTF("Added remote candidate: %J\n", &address);
     error = RAWRTC_CODE_SUCCESS;
 
     // Start checklist (if not started)
-    // TODO: Get config from struct
-    // TODO: Why are there no keep-alive messages?
-    // TODO: Set 'use_cand' properly
-    if (transport->state != RAWRTC_ICE_TRANSPORT_STATE_NEW &&
-            !trice_checklist_isrunning(transport->gatherer->ice)) {
+    if (transport->state != RAWRTC_ICE_TRANSPORT_STATE_NEW && !transport->gatherer->options->ice_lite
+            && !trice_checklist_isrunning(transport->gatherer->ice)) {
         DEBUG_INFO("Starting checklist due to new remote candidate\n");
-        error = rawrtc_error_to_code(trice_checklist_start(
-                transport->gatherer->ice, NULL, rawrtc_default_config.pacing_interval, true,
-                ice_established_handler, ice_failed_handler, transport));
+        error = start_checklist(transport);
         if (error) {
             DEBUG_WARNING("Could not start checklist, reason: %s\n", rawrtc_code_to_str(error));
             goto out;
@@ -1 +1,54 @@
 #pragma once
+
+enum {
+    RAWRTC_ICE_TRANSPORT_CONSENT_INTERVAL = 5000, // in milliseconds
+    RAWRTC_ICE_TRANSPORT_CONSENT_JITTER = 20, // in percent
+    RAWRTC_ICE_TRANSPORT_CONSENT_TIMEOUT = 30000, // in milliseconds
+    RAWRTC_ICE_TRANSPORT_RTT_SMOOTHING = 8, // new samples weigh 1/8 (like TCP's SRTT)
+    RAWRTC_ICE_TRANSPORT_RESELECT_MIN_GAIN = 10, // in milliseconds
+    RAWRTC_ICE_TRANSPORT_RESELECT_MIN_GAIN_PERCENT = 25,
+    RAWRTC_ICE_TRANSPORT_RESELECT_HOLD_TIME = 15000, // in milliseconds
+};
+
+/*
+ * Round-trip time and consent (RFC 7675) of a valid candidate pair,
+ * measured by consent checks. Unanswered checks are being counted as
+ * losses, they never count as round-trip time samples.
+ */
+struct rawrtc_ice_candidate_pair_rtt {
+    struct le le;
+    struct ice_candpair* candidate_pair; // referenced
+    uint64_t check_sent; // in milliseconds, 0 if no check is outstanding
+    uint32_t rtt; // smoothed, in milliseconds, 0 if unknown
+    uint64_t last_success; // in milliseconds
+    uint32_t n_lost; // consent checks not answered before the next one has been sent
+    uint32_t n_consecutive_lost; // since the last answered consent check
+    bool expired; // consent expired, not being selected
+};
+
+/*
+ * Candidate pair nominated by the remote peer (ICE lite only).
+ * Note: An ICE lite agent has no checklist, so the candidate pair is
+ *       being tracked by the ICE transport instead of by trice.
+ */
+struct rawrtc_ice_lite_candidate_pair {
+    struct ice_candpair pair; // must be first, list elements point to it
+    struct le le;
+    struct ice_rcand remote_candidate;
+    bool announced;
+};
+
+struct list* rawrtc_ice_transport_valid_candidate_pairs(
+    struct rawrtc_ice_transport* const transport
+);
+
+struct ice_candpair* rawrtc_ice_transport_selected_candidate_pair(
+    struct rawrtc_ice_transport* const transport
+);
+
+bool rawrtc_ice_transport_lite_receive(
+    struct rawrtc_ice_transport* const transport,
+    struct ice_lcand* const local_candidate,
+    struct sa const* const source,
+    struct mbuf* const buffer
+);
@@ -0,0 +1,107 @@
+#include <rawrtc.h>
+#include "utils.h"
+
+/*
+ * Create new ICE transport options (using the default values).
+ */
+enum rawrtc_code rawrtc_ice_transport_options_create(
+        struct rawrtc_ice_transport_options** const optionsp // de-referenced
+) {
+    struct rawrtc_ice_transport_options* options;
+
+    // Check arguments
+    if (!optionsp) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    options = mem_zalloc(sizeof(*options), NULL);
+    if (!options) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    *options = rawrtc_default_ice_transport_options;
+
+    // Set pointer & done
+    *optionsp = options;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Set the interval between two connectivity checks.
+ * A shorter interval lowers the connection setup time at the cost of
+ * bursts of checks (RFC 8445, section 14 recommends 50 ms).
+ */
+enum rawrtc_code rawrtc_ice_transport_options_set_pacing_interval(
+        struct rawrtc_ice_transport_options* const options,
+        uint32_t const pacing_interval // in milliseconds
+) {
+    // Check arguments
+    if (!options || pacing_interval == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set value
+    options->pacing_interval = pacing_interval;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Set the nomination mode.
+ * Aggressive nomination lets the first valid candidate pair become the
+ * selected one while regular nomination waits for all checks to be
+ * done and nominates the candidate pair with the highest priority.
+ */
+enum rawrtc_code rawrtc_ice_transport_options_set_nomination(
+        struct rawrtc_ice_transport_options* const options,
+        enum rawrtc_ice_nomination const nomination
+) {
+    // Check arguments
+    if (!options) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check nomination mode
+    switch (nomination) {
+        case RAWRTC_ICE_NOMINATION_AGGRESSIVE:
+        case RAWRTC_ICE_NOMINATION_REGULAR:
+            break;
+        default:
+            return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set value
+    options->nomination = nomination;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Set the retransmission parameters of connectivity checks (RFC 5389,
+ * section 7.2.1).
+ *
+ * - `rto`: Initial retransmission timeout.
+ * - `rc`: Number of requests being sent.
+ * - `rm`: Multiplier of the retransmission timeout after the last
+ *   request.
+ * - `ti`: Transaction timeout (TCP).
+ */
+enum rawrtc_code rawrtc_ice_transport_options_set_check_retransmission(
+        struct rawrtc_ice_transport_options* const options,
+        uint32_t const rto, // in milliseconds
+        uint32_t const rc,
+        uint32_t const rm,
+        uint32_t const ti // in milliseconds
+) {
+    // Check arguments
+    if (!options || rto == 0 || rc == 0 || rm == 0 || ti == 0) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Set values
+    options->stun_config.rto = rto;
+    options->stun_config.rc = rc;
+    options->stun_config.rm = rm;
+    options->stun_config.ti = ti;
+    return RAWRTC_CODE_SUCCESS;
+}
@@ -0,0 +1,415 @@
+#include <errno.h> // errno, ENOBUFS
+#include <string.h> // memset, strncpy
+#include <unistd.h> // close
+#include <sys/socket.h> // socket, bind, recv
+#ifdef __linux__
+#include <linux/netlink.h> // NETLINK_ROUTE, sockaddr_nl, NLMSG_*
+#include <linux/rtnetlink.h> // RTM_*, RTMGRP_*
+#endif
+#include <rawrtc.h>
+#include "interface_cache.h"
+#include "main.h"
+
+#define DEBUG_MODULE "interface-cache"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+/*
+ * Add an interface address to a snapshot (unless filtered or already
+ * contained).
+ */
+static bool snapshot_interface_handler(
+        char const* interface, // not checked
+        struct sa const* address, // not checked
+        void* arg // not checked
+) {
+    struct list* const addresses = arg;
+    struct le* le;
+    struct rawrtc_interface_address* interface_address;
+
+    // Ignore loopback and linklocal addresses
+    if (sa_is_linklocal(address) || sa_is_loopback(address)) {
+        return false; // continue
+    }
+
+    // Ignore addresses gathered twice (e.g. on aliases)
+    for (le = list_head(addresses); le != NULL; le = le->next) {
+        interface_address = le->data;
+        if (sa_cmp(&interface_address->address, address, SA_ADDR)) {
+            return false; // continue
+        }
+    }
+
+    // Allocate
+    interface_address = mem_zalloc(sizeof(*interface_address), NULL);
+    if (!interface_address) {
+        DEBUG_WARNING("Could not allocate interface address\n");
+        return true; // stop
+    }
+
+    // Set fields
+    strncpy(interface_address->name, interface, sizeof(interface_address->name) - 1);
+    sa_cpy(&interface_address->address, address);
+
+    // Append
+    list_append(addresses, &interface_address->le, interface_address);
+    return false; // continue
+}
+
+/*
+ * Enumerate interface addresses.
+ */
+static enum rawrtc_code snapshot_create(
+        struct list* const addresses // not checked
+) {
+    list_init(addresses);
+    return rawrtc_error_to_code(net_if_apply(snapshot_interface_handler, addresses));
+}
+
+/*
+ * Move all interface addresses of a snapshot into another (empty)
+ * snapshot.
+ */
+static void snapshot_move(
+        struct list* const destination, // not checked
+        struct list* const source // not checked
+) {
+    struct le* le;
+    while ((le = list_head(source)) != NULL) {
+        list_unlink(le);
+        list_append(destination, le, le->data);
+    }
+}
+
+/*
+ * Check if two snapshots contain the same interface addresses.
+ */
+static bool snapshot_equals(
+        struct list* const a, // not checked
+        struct list* const b // not checked
+) {
+    struct le* le_a;
+    struct le* le_b;
+
+    // Compare length
+    if (list_count(a) != list_count(b)) {
+        return false;
+    }
+
+    // Compare addresses
+    for (le_a = list_head(a); le_a != NULL; le_a = le_a->next) {
+        struct rawrtc_interface_address* const address_a = le_a->data;
+        for (le_b = list_head(b); le_b != NULL; le_b = le_b->next) {
+            struct rawrtc_interface_address* const address_b = le_b->data;
+            if (sa_cmp(&address_a->address, &address_b->address, SA_ADDR)) {
+                break;
+            }
+        }
+        if (!le_b) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Refresh the snapshot and notify listeners (if anything changed).
+ */
+static void refresh_timer_handler(
+        void* arg
+) {
+    struct rawrtc_interface_cache* const cache = arg;
+    struct list addresses;
+    enum rawrtc_code error;
+    bool changed;
+    struct list pending;
+    struct le* le;
+
+    // Enumerate
+    error = snapshot_create(&addresses);
+    if (error) {
+        DEBUG_WARNING("Could not enumerate interfaces, reason: %s\n", rawrtc_code_to_str(error));
+        list_flush(&addresses);
+        list_flush(&cache->addresses);
+        cache->valid = false;
+        return;
+    }
+
+    // Replace snapshot
+    changed = !cache->valid || !snapshot_equals(&cache->addresses, &addresses);
+    list_flush(&cache->addresses);
+    snapshot_move(&cache->addresses, &addresses);
+    cache->valid = true;
+    if (!changed) {
+        return;
+    }
+    DEBUG_INFO("Interface addresses changed\n");
+
+    // Notify listeners
+    // Note: Listeners may remove themselves or others while being notified. Each listener is
+    //       moved back from the pending list right before being notified, so removing a
+    //       listener that has not been notified yet unlinks it from the pending list.
+    list_init(&pending);
+    while ((le = list_head(&cache->listeners)) != NULL) {
+        list_unlink(le);
+        list_append(&pending, le, le->data);
+    }
+    while ((le = list_head(&pending)) != NULL) {
+        struct rawrtc_interface_cache_listener* const listener = le->data;
+        list_unlink(le);
+        list_append(&cache->listeners, le, listener);
+        listener->handler(listener->arg);
+    }
+}
+
+#ifdef __linux__
+/*
+ * Handle rtnetlink messages.
+ */
+static void netlink_handler(
+        int flags,
+        void* arg
+) {
+    struct rawrtc_interface_cache* const cache = arg;
+    uint8_t buffer[8192];
+    int length;
+    struct nlmsghdr* header;
+    bool changed = false;
+    (void) flags;
+
+    // Drain socket
+    while ((length = (int) recv(cache->netlink_socket, buffer, sizeof(buffer), 0)) > 0) {
+        for (header = (struct nlmsghdr*) buffer; NLMSG_OK(header, (unsigned int) length);
+                header = NLMSG_NEXT(header, length)) {
+            switch (header->nlmsg_type) {
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                case RTM_NEWLINK:
+                case RTM_DELLINK:
+                    changed = true;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // Messages lost? Assume something changed.
+    if (length < 0 && errno == ENOBUFS) {
+        changed = true;
+    }
+
+    // Refresh (delayed, to coalesce bursts of messages)
+    if (changed) {
+        tmr_start(&cache->refresh_timer, RAWRTC_INTERFACE_CACHE_REFRESH_DELAY,
+                  refresh_timer_handler, cache);
+    }
+}
+
+/*
+ * Subscribe to rtnetlink link and address changes.
+ */
+static enum rawrtc_code netlink_open(
+        struct rawrtc_interface_cache* const cache
+) {
+    struct sockaddr_nl address;
+    enum rawrtc_code error;
+
+    // Create socket
+    cache->netlink_socket = socket(
+            AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (cache->netlink_socket < 0) {
+        return rawrtc_error_to_code(errno);
+    }
+
+    // Bind to link and address change groups
+    memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(cache->netlink_socket, (struct sockaddr*) &address, sizeof(address))) {
+        error = rawrtc_error_to_code(errno);
+        goto out;
+    }
+
+    // Listen
+    error = rawrtc_error_to_code(fd_listen(
+            cache->netlink_socket, FD_READ, netlink_handler, cache));
+
+out:
+    if (error) {
+        close(cache->netlink_socket);
+        cache->netlink_socket = -1;
+    }
+    return error;
+}
+#else
+/*
+ * Interface changes cannot be monitored on this platform.
+ */
+static enum rawrtc_code netlink_open(
+        struct rawrtc_interface_cache* const cache
+) {
+    (void) cache;
+    return RAWRTC_CODE_NOT_IMPLEMENTED;
+}
+#endif
+
+/*
+ * Initialise the interface cache.
+ */
+enum rawrtc_code rawrtc_interface_cache_init() {
+    struct rawrtc_interface_cache* cache;
+    enum rawrtc_code error;
+
+    // Allocate
+    cache = mem_zalloc(sizeof(*cache), NULL);
+    if (!cache) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    list_init(&cache->addresses);
+    cache->valid = false;
+    cache->netlink_socket = -1;
+    tmr_init(&cache->refresh_timer);
+    list_init(&cache->listeners);
+
+    // Monitor interface changes
+    // Note: Without monitoring, interfaces are being enumerated on every call.
+    error = netlink_open(cache);
+    if (error) {
+        DEBUG_NOTICE("Cannot monitor interface changes, reason: %s\n", rawrtc_code_to_str(error));
+    }
+
+    // Set pointer
+    rawrtc_global.interface_cache = cache;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Close the interface cache.
+ */
+void rawrtc_interface_cache_close() {
+    struct rawrtc_interface_cache* const cache = rawrtc_global.interface_cache;
+    if (!cache) {
+        return;
+    }
+
+    // Stop monitoring
+    tmr_cancel(&cache->refresh_timer);
+    if (cache->netlink_socket >= 0) {
+        fd_close(cache->netlink_socket);
+        close(cache->netlink_socket);
+    }
+
+    // Free snapshot
+    // Note: Listeners are owned by their creators.
+    list_flush(&cache->addresses);
+    list_clear(&cache->listeners);
+
+    // Un-reference
+    rawrtc_global.interface_cache = mem_deref(cache);
+}
+
+/*
+ * Apply a handler on each (non-loopback, non-link-local) interface
+ * address until the handler returns `true`.
+ */
+enum rawrtc_code rawrtc_interface_cache_apply(
+        net_ifaddr_h* const handler,
+        void* const arg
+) {
+    struct rawrtc_interface_cache* const cache = rawrtc_global.interface_cache;
+    struct list addresses;
+    struct list* snapshot;
+    struct le* le;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!handler) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (!cache) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Use snapshot (if valid) or enumerate now
+    // Note: The snapshot is only being kept if changes can be monitored.
+    snapshot = cache->netlink_socket >= 0 ? &cache->addresses : &addresses;
+    if (!cache->valid || snapshot == &addresses) {
+        error = snapshot_create(snapshot);
+        if (error) {
+            list_flush(snapshot);
+            return error;
+        }
+        cache->valid = snapshot == &cache->addresses;
+    }
+
+    // Apply
+    for (le = list_head(snapshot); le != NULL; le = le->next) {
+        struct rawrtc_interface_address* const address = le->data;
+        if (handler(address->name, &address->address, arg)) {
+            break;
+        }
+    }
+
+    // Free snapshot (if not kept)
+    if (snapshot == &addresses) {
+        list_flush(&addresses);
+    }
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Destructor for an existing interface change listener.
+ */
+static void rawrtc_interface_cache_listener_destroy(
+        void* arg
+) {
+    struct rawrtc_interface_cache_listener* const listener = arg;
+
+    // Remove from listeners
+    list_unlink(&listener->le);
+}
+
+/*
+ * Listen for interface address changes. Un-reference the listener to
+ * stop listening.
+ */
+enum rawrtc_code rawrtc_interface_cache_listen(
+        struct rawrtc_interface_cache_listener** const listenerp, // de-referenced
+        rawrtc_interface_cache_change_handler* const handler,
+        void* const arg
+) {
+    struct rawrtc_interface_cache* const cache = rawrtc_global.interface_cache;
+    struct rawrtc_interface_cache_listener* listener;
+
+    // Check arguments
+    if (!listenerp || !handler) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (!cache) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Allocate
+    listener = mem_zalloc(sizeof(*listener), rawrtc_interface_cache_listener_destroy);
+    if (!listener) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    listener->handler = handler;
+    listener->arg = arg;
+
+    // Append to listeners
+    list_append(&cache->listeners, &listener->le, listener);
+
+    // Set pointer
+    *listenerp = listener;
+    return RAWRTC_CODE_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <net/if.h> // IFNAMSIZ
+#include <rawrtc.h>
+
+enum {
+    RAWRTC_INTERFACE_CACHE_REFRESH_DELAY = 100, // in milliseconds
+};
+
+/*
+ * Interface change handler.
+ */
+typedef void (rawrtc_interface_cache_change_handler)(
+    void* const arg
+);
+
+/*
+ * Cached interface address.
+ */
+struct rawrtc_interface_address {
+    struct le le;
+    char name[IFNAMSIZ];
+    struct sa address;
+};
+
+/*
+ * Interface change listener.
+ */
+struct rawrtc_interface_cache_listener {
+    struct le le;
+    rawrtc_interface_cache_change_handler* handler;
+    void* arg;
+};
+
+/*
+ * Process-wide interface address snapshot.
+ * Note: The snapshot is only being kept (and listeners are only being
+ *       notified) if interface changes can be monitored (rtnetlink).
+ */
+struct rawrtc_interface_cache {
+    struct list addresses;
+    bool valid;
+    int netlink_socket; // -1 if unavailable
+    struct tmr refresh_timer;
+    struct list listeners;
+};
+
+enum rawrtc_code rawrtc_interface_cache_init();
+
+void rawrtc_interface_cache_close();
+
+enum rawrtc_code rawrtc_interface_cache_apply(
+    net_ifaddr_h* const handler,
+    void* const arg
+);
+
+enum rawrtc_code rawrtc_interface_cache_listen(
+    struct rawrtc_interface_cache_listener** const listenerp, // de-referenced
+    rawrtc_interface_cache_change_handler* const handler,
+    void* const arg
+);
@@ -1,6 +1,12 @@
 #include <pthread.h> // pthread_*
 #include <rawrtc.h>
 #include "main.h"
+#include "certificate_pool.h"
+#include "dtls_context.h"
+#include "dtls_session.h"
+#include "dns_cache.h"
+#include "interface_cache.h"
+#include "timer_wheel.h"
 
 #define DEBUG_MODULE "rawrtc-main"
 //#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
@@ -14,6 +20,7 @@ struct rawrtc_global rawrtc_global;
  */
 enum rawrtc_code rawrtc_init() {
     int err;
+    enum rawrtc_code error;
     pthread_mutexattr_t mutex_attribute;
 
     // Initialise re
@@ -48,6 +55,52 @@ enum rawrtc_code rawrtc_init() {
     // Set usrsctp initialised counter
     rawrtc_global.usrsctp_initialized = 0;
 
+    // Initialise retired certificate pool list
+    list_init(&rawrtc_global.retired_certificate_pools);
+
+    // Initialise UDP mux list
+    list_init(&rawrtc_global.udp_muxes);
+
+    // Create DTLS context cache
+    err = hash_alloc(&rawrtc_global.dtls_contexts, 16);
+    if (err) {
+        DEBUG_WARNING("Failed to create DTLS context cache, reason: %m\n", err);
+        return rawrtc_error_to_code(err);
+    }
+
+    // Create DTLS session cache
+    error = rawrtc_dtls_session_cache_init();
+    if (error) {
+        DEBUG_WARNING("Failed to create DTLS session cache, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        return error;
+    }
+
+    // Create DNS cache
+    error = rawrtc_dns_cache_init();
+    if (error) {
+        DEBUG_WARNING("Failed to create DNS cache, reason: %s\n", rawrtc_code_to_str(error));
+        return error;
+    }
+
+    // Create interface cache
+    error = rawrtc_interface_cache_init();
+    if (error) {
+        DEBUG_WARNING("Failed to create interface cache, reason: %s\n",
+                      rawrtc_code_to_str(error));
+        return error;
+    }
+
+    // Create timer wheel
+    error = rawrtc_timer_wheel_init();
+    if (error) {
+        DEBUG_WARNING("Failed to create timer wheel, reason: %s\n", rawrtc_code_to_str(error));
+        return error;
+    }
+
+    // Order default DTLS cipher suites by CPU capabilities
+    rawrtc_dtls_context_order_cipher_suites();
+
     // Done
     return RAWRTC_CODE_SUCCESS;
 }
@@ -60,6 +113,25 @@ enum rawrtc_code rawrtc_close() {
 
     // TODO: Close usrsctp if initialised
 
+    // Stop certificate pool (waits for workers still finishing)
+    rawrtc_certificate_pool_close();
+
+    // Destroy DTLS context cache
+    // Note: Contexts are owned by their transports which must have been destroyed already.
+    rawrtc_global.dtls_contexts = mem_deref(rawrtc_global.dtls_contexts);
+
+    // Destroy DTLS session cache
+    rawrtc_dtls_session_cache_close();
+
+    // Destroy DNS cache
+    rawrtc_dns_cache_close();
+
+    // Destroy interface cache
+    rawrtc_interface_cache_close();
+
+    // Destroy timer wheel
+    rawrtc_timer_wheel_close();
+
     // Destroy mutex
     err = pthread_mutex_destroy(&rawrtc_global.mutex);
     if (err) {
@@ -11,6 +11,14 @@ struct rawrtc_global {
     uint_fast32_t usrsctp_initialized;
     struct tmr usrsctp_tick_timer;
     size_t usrsctp_chunk_size;
+    struct hash* dtls_contexts;
+    struct rawrtc_certificate_pool* certificate_pool;
+    struct list retired_certificate_pools; // workers still finishing
+    struct rawrtc_dtls_session_cache* dtls_session_cache;
+    struct list udp_muxes;
+    struct rawrtc_dns_cache* dns_cache;
+    struct rawrtc_interface_cache* interface_cache;
+    struct rawrtc_timer_wheel* timer_wheel;
 };
 
 extern struct rawrtc_global rawrtc_global;
@@ -420,6 +420,16 @@ static enum rawrtc_code send_message(
     return RAWRTC_CODE_SUCCESS;
 }
 
+/*
+ * Record the first data channel being opened in the setup timeline.
+ */
+static void timeline_data_channel_open(
+        struct rawrtc_sctp_transport* const transport // not checked
+) {
+    rawrtc_timestamp_once(
+            &transport->dtls_transport->ice_transport->timeline.first_data_channel_open);
+}
+
 /*
  * Change the states of all data channels.
  * Caller MUST ensure that the same state is not set twice.
@@ -440,6 +450,9 @@ static void set_data_channel_states(
 
         // Update state
         if (!from_state || channel->state == *from_state) {
+            if (to_state == RAWRTC_DATA_CHANNEL_STATE_OPEN) {
+                timeline_data_channel_open(transport);
+            }
             rawrtc_data_channel_set_state(channel, to_state);
         }
     }
@@ -516,6 +529,7 @@ static void set_state(
         enum rawrtc_data_channel_state const from_channel_state =
                 RAWRTC_DATA_CHANNEL_STATE_CONNECTING;
         DEBUG_INFO("SCTP connection established\n");
+        rawrtc_timestamp_once(&transport->dtls_transport->ice_transport->timeline.sctp_established);
 
         // Send deferred messages
         error = sctp_send_deferred_messages(transport);
@@ -2208,6 +2222,7 @@ static void channel_register(
 
     // Update data channel state
     if (transport->state == RAWRTC_SCTP_TRANSPORT_STATE_CONNECTED) {
+        timeline_data_channel_open(transport);
         rawrtc_data_channel_set_state(channel, RAWRTC_DATA_CHANNEL_STATE_OPEN);
     }
 }
@@ -0,0 +1,333 @@
+#include <string.h> // memcpy, memmove
+#include <netinet/in.h> // htons
+#include <rawrtc.h>
+#include "tcp_framing.h"
+
+#define DEBUG_MODULE "tcp-framing"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+/*
+ * Check if a frame is a STUN message by its first byte (RFC 7983,
+ * section 7).
+ */
+static inline bool is_stun_frame(
+        uint8_t const first_byte
+) {
+    return first_byte <= 3;
+}
+
+/*
+ * Dispatch a received frame.
+ */
+static void dispatch_frame(
+        struct rawrtc_tcp_framing* const framing, // not checked
+        struct mbuf* const frame // not checked
+) {
+    if (!framing->frame_handler(&framing->peer_address, frame, framing->arg)) {
+        DEBUG_PRINTF("Unhandled frame of size %zu from %J\n",
+                     mbuf_get_left(frame), &framing->peer_address);
+    }
+}
+
+/*
+ * Handle received TCP segments.
+ */
+static bool tcp_receive_handler(
+        int* err,
+        struct mbuf* buffer,
+        bool* estab,
+        void* arg
+) {
+    struct rawrtc_tcp_framing* const framing = arg;
+    size_t start;
+    size_t end;
+    size_t read;
+    size_t keep;
+    (void) estab;
+
+    // Put back a partial header in front of the segment
+    if (framing->header_length > 0) {
+        *err = mbuf_shift(buffer, (ssize_t) framing->header_length);
+        if (*err) {
+            return true;
+        }
+        buffer->pos -= framing->header_length;
+        memcpy(mbuf_buf(buffer), framing->header, framing->header_length);
+        framing->header_length = 0;
+    }
+    start = buffer->pos;
+    end = buffer->end;
+    read = start;
+    keep = start; // end of the STUN frames being kept in the stream
+
+    // Keep the frame handler alive while dispatching
+    mem_ref(framing);
+
+    if (framing->passthrough_left > 0) {
+        // Continue a STUN frame
+        size_t const length = min(framing->passthrough_left, end - read);
+        read += length;
+        keep += length;
+        framing->passthrough_left -= length;
+    } else if (framing->pending) {
+        // Continue a frame split across segments
+        size_t const length = min(framing->pending_left, end - read);
+        *err = mbuf_write_mem(framing->pending, buffer->buf + read, length);
+        if (*err) {
+            goto out;
+        }
+        read += length;
+        framing->pending_left -= length;
+
+        // Complete?
+        if (framing->pending_left == 0) {
+            struct mbuf* const frame = framing->pending;
+            framing->pending = NULL;
+            frame->pos = 0;
+            dispatch_frame(framing, frame);
+            mem_deref(frame);
+        }
+    }
+
+    // Parse frames
+    while (read < end) {
+        size_t const left = end - read;
+        uint16_t length;
+
+        // Skip empty frames
+        if (left >= RAWRTC_TCP_FRAMING_HEADER_SIZE) {
+            length = (uint16_t) (buffer->buf[read] << 8 | buffer->buf[read + 1]);
+            if (length == 0) {
+                read += RAWRTC_TCP_FRAMING_HEADER_SIZE;
+                continue;
+            }
+        }
+
+        // Incomplete header (the first byte is needed for classification)
+        if (left < RAWRTC_TCP_FRAMING_HEADER_SIZE + 1) {
+            memcpy(framing->header, buffer->buf + read, left);
+            framing->header_length = left;
+            read = end;
+            break;
+        }
+
+        if (is_stun_frame(buffer->buf[read + RAWRTC_TCP_FRAMING_HEADER_SIZE])) {
+            // Keep STUN frame (including its header) in the stream
+            size_t const frame_length = RAWRTC_TCP_FRAMING_HEADER_SIZE + length;
+            size_t const available = min(frame_length, left);
+            if (keep != read) {
+                memmove(buffer->buf + keep, buffer->buf + read, available);
+            }
+            read += available;
+            keep += available;
+            framing->passthrough_left = frame_length - available;
+        } else if (RAWRTC_TCP_FRAMING_HEADER_SIZE + length <= left) {
+            // Dispatch complete frame (window on the segment, no copy)
+            buffer->pos = read + RAWRTC_TCP_FRAMING_HEADER_SIZE;
+            buffer->end = buffer->pos + length;
+            dispatch_frame(framing, buffer);
+            buffer->end = end;
+            read += RAWRTC_TCP_FRAMING_HEADER_SIZE + length;
+        } else {
+            // Copy partial frame
+            framing->pending = mbuf_alloc(length);
+            if (!framing->pending) {
+                *err = ENOMEM;
+                goto out;
+            }
+            *err = mbuf_write_mem(
+                    framing->pending, buffer->buf + read + RAWRTC_TCP_FRAMING_HEADER_SIZE,
+                    left - RAWRTC_TCP_FRAMING_HEADER_SIZE);
+            if (*err) {
+                framing->pending = mem_deref(framing->pending);
+                goto out;
+            }
+            framing->pending_left = length - (left - RAWRTC_TCP_FRAMING_HEADER_SIZE);
+            read = end;
+        }
+    }
+
+out:
+    mem_deref(framing);
+
+    // Hand remaining STUN frames to the ICE agent
+    buffer->pos = start;
+    buffer->end = keep;
+    return keep == start;
+}
+
+/*
+ * Send batched frames.
+ */
+static void flush_timer_handler(
+        void* arg
+) {
+    struct rawrtc_tcp_framing* const framing = arg;
+    enum rawrtc_code const error = rawrtc_tcp_framing_flush(framing);
+    if (error) {
+        DEBUG_WARNING("Could not send frames to %J, reason: %s\n",
+                      &framing->peer_address, rawrtc_code_to_str(error));
+    }
+}
+
+/*
+ * Destructor for existing TCP framing.
+ */
+static void rawrtc_tcp_framing_destroy(
+        void* arg
+) {
+    struct rawrtc_tcp_framing* const framing = arg;
+
+    // Remove from list & stop timer
+    list_unlink(&framing->le);
+    tmr_cancel(&framing->flush_timer);
+
+    // Un-reference
+    mem_deref(framing->send_buffer);
+    mem_deref(framing->pending);
+    mem_deref(framing->helper);
+    mem_deref(framing->connection);
+}
+
+/*
+ * Attach RFC 4571 framing to an ICE-TCP connection.
+ */
+enum rawrtc_code rawrtc_tcp_framing_create(
+        struct rawrtc_tcp_framing** const framingp, // de-referenced
+        struct tcp_conn* const connection, // referenced
+        udp_helper_recv_h* const frame_handler,
+        void* const arg
+) {
+    struct rawrtc_tcp_framing* framing;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!framingp || !connection || !frame_handler) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    framing = mem_zalloc(sizeof(*framing), rawrtc_tcp_framing_destroy);
+    if (!framing) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/reference
+    framing->connection = mem_ref(connection);
+    framing->header_length = 0;
+    framing->passthrough_left = 0;
+    framing->pending_left = 0;
+    tmr_init(&framing->flush_timer);
+    framing->frame_handler = frame_handler;
+    framing->arg = arg;
+
+    // Get peer address
+    error = rawrtc_error_to_code(tcp_conn_peer_get(connection, &framing->peer_address));
+    if (error) {
+        goto out;
+    }
+
+    // Register TCP helper
+    // Note: The helper is called before the ICE agent's helper as it has a lower layer.
+    error = rawrtc_error_to_code(tcp_register_helper(
+            &framing->helper, connection, RAWRTC_LAYER_CLASSIFIER, NULL, NULL,
+            tcp_receive_handler, framing));
+    if (error) {
+        goto out;
+    }
+
+out:
+    if (error) {
+        mem_deref(framing);
+    } else {
+        // Set pointer
+        *framingp = framing;
+    }
+    return error;
+}
+
+/*
+ * Frame and queue a message. Queued messages will be sent together on
+ * the next iteration of the event loop (or once the batch is full).
+ */
+enum rawrtc_code rawrtc_tcp_framing_send(
+        struct rawrtc_tcp_framing* const framing,
+        struct mbuf* const buffer
+) {
+    size_t const length = mbuf_get_left(buffer);
+    int err;
+
+    // Check arguments
+    if (!framing || !buffer) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check length
+    if (length > RAWRTC_TCP_FRAMING_MAX_FRAME_SIZE) {
+        return RAWRTC_CODE_MESSAGE_TOO_LONG;
+    }
+
+    // Allocate batch (if needed)
+    if (!framing->send_buffer) {
+        framing->send_buffer = mbuf_alloc(RAWRTC_TCP_FRAMING_SEND_BATCH_SIZE);
+        if (!framing->send_buffer) {
+            return RAWRTC_CODE_NO_MEMORY;
+        }
+    }
+
+    // Append frame
+    err = mbuf_write_u16(framing->send_buffer, htons((uint16_t) length));
+    if (!err) {
+        err = mbuf_write_mem(framing->send_buffer, mbuf_buf(buffer), length);
+    }
+    if (err) {
+        return rawrtc_error_to_code(err);
+    }
+
+    // Batch full?
+    if (framing->send_buffer->end >= RAWRTC_TCP_FRAMING_SEND_BATCH_SIZE) {
+        return rawrtc_tcp_framing_flush(framing);
+    }
+
+    // Send on the next iteration of the event loop
+    if (!tmr_isrunning(&framing->flush_timer)) {
+        tmr_start(&framing->flush_timer, 0, flush_timer_handler, framing);
+    }
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Send queued frames.
+ */
+enum rawrtc_code rawrtc_tcp_framing_flush(
+        struct rawrtc_tcp_framing* const framing
+) {
+    struct mbuf* buffer;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!framing) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Stop timer
+    tmr_cancel(&framing->flush_timer);
+
+    // Nothing queued?
+    buffer = framing->send_buffer;
+    if (!buffer) {
+        return RAWRTC_CODE_SUCCESS;
+    }
+    framing->send_buffer = NULL;
+
+    // Send all frames at once
+    buffer->pos = 0;
+    DEBUG_PRINTF("Sending %zu bytes of frames to %J\n",
+                 mbuf_get_left(buffer), &framing->peer_address);
+    error = rawrtc_error_to_code(tcp_send(framing->connection, buffer));
+
+    // Un-reference & done
+    mem_deref(buffer);
+    return error;
+}
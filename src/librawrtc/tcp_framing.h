@@ -0,0 +1,53 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    RAWRTC_TCP_FRAMING_HEADER_SIZE = 2,
+    RAWRTC_TCP_FRAMING_MAX_FRAME_SIZE = UINT16_MAX,
+    RAWRTC_TCP_FRAMING_SEND_BATCH_SIZE = 16384, // flushed immediately once exceeded
+};
+
+/*
+ * RFC 4571 framing on an ICE-TCP connection.
+ *
+ * Received frames are being dispatched to the frame handler without
+ * copying them (a window on the received buffer). Only a frame split
+ * across segments is being copied into `pending`. STUN frames are left
+ * in the stream for the ICE agent (which does its own framing) and a
+ * header split across segments is being put back in front of the next
+ * segment.
+ *
+ * Outgoing frames are being batched in `send_buffer` and written in a
+ * single send call on the next iteration of the event loop.
+ */
+struct rawrtc_tcp_framing {
+    struct le le;
+    struct tcp_conn* connection; // referenced
+    struct tcp_helper* helper;
+    struct sa peer_address;
+    uint8_t header[RAWRTC_TCP_FRAMING_HEADER_SIZE + 1]; // length and first byte of a frame
+    size_t header_length;
+    size_t passthrough_left; // remaining bytes of a STUN frame
+    struct mbuf* pending; // nullable
+    size_t pending_left;
+    struct mbuf* send_buffer; // nullable
+    struct tmr flush_timer;
+    udp_helper_recv_h* frame_handler;
+    void* arg;
+};
+
+enum rawrtc_code rawrtc_tcp_framing_create(
+    struct rawrtc_tcp_framing** const framingp, // de-referenced
+    struct tcp_conn* const connection, // referenced
+    udp_helper_recv_h* const frame_handler,
+    void* const arg
+);
+
+enum rawrtc_code rawrtc_tcp_framing_send(
+    struct rawrtc_tcp_framing* const framing,
+    struct mbuf* const buffer
+);
+
+enum rawrtc_code rawrtc_tcp_framing_flush(
+    struct rawrtc_tcp_framing* const framing
+);
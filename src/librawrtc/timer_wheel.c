@@ -0,0 +1,270 @@
+#include <string.h> // memset
+#include <rawrtc.h>
+#include "timer_wheel.h"
+#include "main.h"
+
+#define DEBUG_MODULE "timer-wheel"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+static void tick_timer_handler(
+    void* arg
+);
+
+/*
+ * Expire the timers of the current slot and advance by one slot.
+ */
+static void tick(
+        struct rawrtc_timer_wheel* const wheel // not checked
+) {
+    struct list* const slot = &wheel->slots[wheel->current_slot];
+    struct list due;
+    struct le* le;
+
+    // Advance
+    wheel->current_slot = (wheel->current_slot + 1) % RAWRTC_TIMER_WHEEL_SLOTS;
+
+    // Collect due timers, count down the others
+    list_init(&due);
+    le = list_head(slot);
+    while (le) {
+        struct rawrtc_timer_wheel_timer* const timer = le->data;
+        le = le->next;
+        if (timer->rounds > 0) {
+            --timer->rounds;
+            continue;
+        }
+        list_unlink(&timer->le);
+        list_append(&due, &timer->le, timer);
+    }
+
+    // Call handlers
+    // Note: Handlers may start or cancel any timer (including due ones).
+    while ((le = list_head(&due)) != NULL) {
+        struct rawrtc_timer_wheel_timer* const timer = le->data;
+        list_unlink(le);
+        --wheel->n_timers;
+        timer->handler(timer->arg);
+    }
+}
+
+/*
+ * Schedule the next tick (if there are any timers).
+ */
+static void schedule_tick(
+        struct rawrtc_timer_wheel* const wheel // not checked
+) {
+    uint64_t const now = tmr_jiffies();
+
+    if (wheel->n_timers == 0) {
+        tmr_cancel(&wheel->tick_timer);
+        return;
+    }
+    tmr_start(&wheel->tick_timer, wheel->next_tick > now ? wheel->next_tick - now : 0,
+              tick_timer_handler, wheel);
+}
+
+/*
+ * Process all ticks that are due (catching up after delays of the
+ * event loop).
+ */
+static void tick_timer_handler(
+        void* arg
+) {
+    struct rawrtc_timer_wheel* const wheel = arg;
+    uint64_t const now = tmr_jiffies();
+
+    while (wheel->next_tick <= now && wheel->n_timers > 0) {
+        wheel->next_tick += RAWRTC_TIMER_WHEEL_TICK;
+        tick(wheel);
+    }
+    schedule_tick(wheel);
+}
+
+/*
+ * Initialise the timer wheel.
+ */
+enum rawrtc_code rawrtc_timer_wheel_init() {
+    struct rawrtc_timer_wheel* wheel;
+    size_t i;
+
+    // Allocate
+    wheel = mem_zalloc(sizeof(*wheel), NULL);
+    if (!wheel) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields
+    for (i = 0; i < RAWRTC_TIMER_WHEEL_SLOTS; ++i) {
+        list_init(&wheel->slots[i]);
+    }
+    wheel->current_slot = 0;
+    wheel->n_timers = 0;
+    tmr_init(&wheel->tick_timer);
+
+    // Set pointer
+    rawrtc_global.timer_wheel = wheel;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Close the timer wheel.
+ * Note: Timers are owned by their creators and will not be called.
+ */
+void rawrtc_timer_wheel_close() {
+    struct rawrtc_timer_wheel* const wheel = rawrtc_global.timer_wheel;
+    size_t i;
+    if (!wheel) {
+        return;
+    }
+
+    // Stop ticking & unlink timers
+    tmr_cancel(&wheel->tick_timer);
+    for (i = 0; i < RAWRTC_TIMER_WHEEL_SLOTS; ++i) {
+        list_clear(&wheel->slots[i]);
+    }
+
+    // Un-reference
+    rawrtc_global.timer_wheel = mem_deref(wheel);
+}
+
+/*
+ * Initialise a timer wheel timer.
+ */
+void rawrtc_timer_wheel_timer_init(
+        struct rawrtc_timer_wheel_timer* const timer
+) {
+    if (!timer) {
+        return;
+    }
+    memset(timer, 0, sizeof(*timer));
+}
+
+/*
+ * Destructor for an allocated timer wheel timer.
+ */
+static void rawrtc_timer_wheel_timer_destroy(
+        void* arg
+) {
+    struct rawrtc_timer_wheel_timer* const timer = arg;
+
+    // Stop (if running)
+    rawrtc_timer_wheel_cancel(timer);
+}
+
+/*
+ * Allocate a timer wheel timer (for structs that cannot embed one).
+ * Un-referencing the timer stops it.
+ */
+enum rawrtc_code rawrtc_timer_wheel_timer_alloc(
+        struct rawrtc_timer_wheel_timer** const timerp // de-referenced
+) {
+    struct rawrtc_timer_wheel_timer* timer;
+
+    // Check arguments
+    if (!timerp) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    timer = mem_zalloc(sizeof(*timer), rawrtc_timer_wheel_timer_destroy);
+    if (!timer) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set pointer
+    *timerp = timer;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Start (or restart) a timer wheel timer. The delay will be rounded up
+ * to the tick resolution.
+ */
+enum rawrtc_code rawrtc_timer_wheel_start(
+        struct rawrtc_timer_wheel_timer* const timer,
+        uint32_t const delay, // in milliseconds
+        rawrtc_timer_wheel_handler* const handler,
+        void* const arg
+) {
+    struct rawrtc_timer_wheel* const wheel = rawrtc_global.timer_wheel;
+    uint32_t ticks;
+    size_t slot;
+
+    // Check arguments
+    if (!timer || !handler) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Check state
+    if (!wheel) {
+        return RAWRTC_CODE_INVALID_STATE;
+    }
+
+    // Stop (if running)
+    rawrtc_timer_wheel_cancel(timer);
+
+    // Calculate slot and number of revolutions
+    // Note: At least one tick so a timer never expires within the current tick.
+    ticks = (delay + RAWRTC_TIMER_WHEEL_TICK - 1) / RAWRTC_TIMER_WHEEL_TICK;
+    if (ticks == 0) {
+        ticks = 1;
+    }
+    slot = (wheel->current_slot + ticks - 1) % RAWRTC_TIMER_WHEEL_SLOTS;
+    timer->rounds = (ticks - 1) / RAWRTC_TIMER_WHEEL_SLOTS;
+
+    // Set fields & add to slot
+    timer->handler = handler;
+    timer->arg = arg;
+    list_append(&wheel->slots[slot], &timer->le, timer);
+
+    // Start ticking (if first timer)
+    if (wheel->n_timers++ == 0) {
+        wheel->next_tick = tmr_jiffies() + RAWRTC_TIMER_WHEEL_TICK;
+        schedule_tick(wheel);
+    }
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Stop a timer wheel timer (if running).
+ */
+void rawrtc_timer_wheel_cancel(
+        struct rawrtc_timer_wheel_timer* const timer
+) {
+    struct rawrtc_timer_wheel* const wheel = rawrtc_global.timer_wheel;
+
+    if (!timer || !timer->le.list) {
+        return;
+    }
+
+    // Remove from slot
+    list_unlink(&timer->le);
+    if (wheel) {
+        --wheel->n_timers;
+    }
+}
+
+/*
+ * Check if a timer wheel timer is running.
+ */
+bool rawrtc_timer_wheel_isrunning(
+        struct rawrtc_timer_wheel_timer const* const timer
+) {
+    return timer && timer->le.list;
+}
+
+/*
+ * Spread an interval randomly by +/- `percent` percent (to prevent
+ * many sessions from sending in bursts).
+ */
+uint32_t rawrtc_timer_wheel_jitter(
+        uint32_t const interval, // in milliseconds
+        uint_fast8_t const percent
+) {
+    uint32_t const range = (uint32_t) ((uint64_t) interval * percent / 100);
+    if (range == 0) {
+        return interval;
+    }
+    return interval - range + rand_u32() % (2 * range + 1);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    RAWRTC_TIMER_WHEEL_TICK = 100, // in milliseconds
+    RAWRTC_TIMER_WHEEL_SLOTS = 512, // one revolution takes 51.2 seconds
+};
+
+/*
+ * Timer wheel timer handler.
+ */
+typedef void (rawrtc_timer_wheel_handler)(
+    void* arg
+);
+
+/*
+ * Timer wheel timer (embedded into its owner, like `struct tmr`).
+ */
+struct rawrtc_timer_wheel_timer {
+    struct le le;
+    uint32_t rounds; // remaining revolutions
+    rawrtc_timer_wheel_handler* handler;
+    void* arg;
+};
+
+/*
+ * Process-wide hashed timing wheel for long-running periodic timers
+ * (e.g. keep-alives and consent freshness checks) of many sessions.
+ * Timers are being expired with a resolution of one tick.
+ */
+struct rawrtc_timer_wheel {
+    struct list slots[RAWRTC_TIMER_WHEEL_SLOTS];
+    size_t current_slot;
+    size_t n_timers;
+    uint64_t next_tick; // in milliseconds (jiffies)
+    struct tmr tick_timer;
+};
+
+enum rawrtc_code rawrtc_timer_wheel_init();
+
+void rawrtc_timer_wheel_close();
+
+void rawrtc_timer_wheel_timer_init(
+    struct rawrtc_timer_wheel_timer* const timer
+);
+
+enum rawrtc_code rawrtc_timer_wheel_timer_alloc(
+    struct rawrtc_timer_wheel_timer** const timerp // de-referenced
+);
+
+enum rawrtc_code rawrtc_timer_wheel_start(
+    struct rawrtc_timer_wheel_timer* const timer,
+    uint32_t const delay, // in milliseconds
+    rawrtc_timer_wheel_handler* const handler,
+    void* const arg
+);
+
+void rawrtc_timer_wheel_cancel(
+    struct rawrtc_timer_wheel_timer* const timer
+);
+
+bool rawrtc_timer_wheel_isrunning(
+    struct rawrtc_timer_wheel_timer const* const timer
+);
+
+uint32_t rawrtc_timer_wheel_jitter(
+    uint32_t const interval, // in milliseconds
+    uint_fast8_t const percent
+);
@@ -0,0 +1,679 @@
+#include <errno.h> // errno
+#include <string.h> // memchr, strlen
+#include <sys/socket.h> // setsockopt, bind, SO_REUSEPORT
+#if defined(__linux__)
+#include <linux/filter.h> // struct sock_filter, struct sock_fprog, BPF_*
+#endif
+#include <rawrtc.h>
+#include "udp_mux.h"
+#include "candidate_helper.h"
+#include "main.h"
+#include "utils.h"
+
+#define DEBUG_MODULE "udp-mux"
+//#define RAWRTC_DEBUG_MODULE_LEVEL 7 // Note: Uncomment this to debug this module only
+#include "debug.h"
+
+enum {
+    STUN_TYPE_BINDING_REQUEST = 0x0001,
+};
+
+/*
+ * Read a 16-bit unsigned integer in network byte order.
+ */
+static inline uint16_t read_u16(
+        uint8_t const* const data
+) {
+    return (uint16_t) ((data[0] << 8) | data[1]);
+}
+
+/*
+ * Parse a STUN message's type and USERNAME attribute without decoding
+ * the whole message.
+ * Returns `false` if the buffer does not contain a STUN message.
+ */
+static bool parse_stun_message(
+        bool* const is_binding_requestp, // de-referenced
+        struct pl* const usernamep, // de-referenced
+        struct mbuf* const buffer
+) {
+    uint8_t const* const data = mbuf_buf(buffer);
+    size_t const left = mbuf_get_left(buffer);
+    size_t length;
+    size_t offset;
+
+    // Validate header
+    if (left < STUN_HEADER_SIZE || (data[0] & 0xc0) != 0) {
+        return false;
+    }
+    if (((uint32_t) data[4] << 24 | (uint32_t) data[5] << 16
+            | (uint32_t) data[6] << 8 | (uint32_t) data[7]) != STUN_MAGIC_COOKIE) {
+        return false;
+    }
+    length = read_u16(&data[2]);
+    if (STUN_HEADER_SIZE + length > left) {
+        return false;
+    }
+
+    // Set type and find USERNAME attribute
+    *is_binding_requestp = read_u16(&data[0]) == STUN_TYPE_BINDING_REQUEST;
+    *usernamep = pl_null;
+    for (offset = STUN_HEADER_SIZE; offset + 4 <= STUN_HEADER_SIZE + length;) {
+        uint16_t const type = read_u16(&data[offset]);
+        size_t const attribute_length = read_u16(&data[offset + 2]);
+        if (offset + 4 + attribute_length > STUN_HEADER_SIZE + length) {
+            return false;
+        }
+        if (type == STUN_ATTR_USERNAME) {
+            usernamep->p = (char const*) &data[offset + 4];
+            usernamep->l = attribute_length;
+            break;
+        }
+        offset += 4 + ((attribute_length + 3) & ~((size_t) 3));
+    }
+    return true;
+}
+
+/*
+ * Split a STUN USERNAME (`<receiver>:<sender>`) and get either side.
+ */
+static bool get_username_fragment(
+        struct pl* const username_fragmentp, // de-referenced
+        struct pl const* const username,
+        bool const receiver
+) {
+    char const* const colon = pl_isset(username) ? memchr(username->p, ':', username->l) : NULL;
+    if (!colon) {
+        return false;
+    }
+
+    if (receiver) {
+        username_fragmentp->p = username->p;
+        username_fragmentp->l = (size_t) (colon - username->p);
+    } else {
+        username_fragmentp->p = colon + 1;
+        username_fragmentp->l = username->l - (size_t) (colon - username->p) - 1;
+    }
+    return true;
+}
+
+/*
+ * Check if an entry matches a username fragment.
+ */
+static bool entry_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_udp_mux_entry* const entry = le->data;
+    return pl_strcmp(arg, entry->username_fragment) == 0;
+}
+
+/*
+ * Find an entry by username fragment.
+ */
+static struct rawrtc_udp_mux_entry* entry_lookup(
+        struct rawrtc_udp_mux* const mux,
+        struct pl* const username_fragment
+) {
+    return list_ledata(hash_lookup(
+            mux->entries, hash_joaat((uint8_t const*) username_fragment->p, username_fragment->l),
+            entry_lookup_handler, username_fragment));
+}
+
+/*
+ * Check if a route matches a remote address.
+ */
+static bool route_lookup_handler(
+        struct le* le,
+        void* arg
+) {
+    struct rawrtc_udp_mux_route* const route = le->data;
+    return sa_cmp(&route->address, arg, SA_ALL);
+}
+
+/*
+ * Find a route by remote address.
+ */
+static struct rawrtc_udp_mux_route* route_lookup(
+        struct rawrtc_udp_mux* const mux,
+        struct sa const* const address
+) {
+    return list_ledata(hash_lookup(
+            mux->routes, sa_hash(address, SA_ALL), route_lookup_handler, (void*) address));
+}
+
+/*
+ * Destructor for an existing route.
+ */
+static void rawrtc_udp_mux_route_destroy(
+        void* arg
+) {
+    struct rawrtc_udp_mux_route* const route = arg;
+
+    // Remove from mux and entry
+    hash_unlink(&route->le);
+    list_unlink(&route->entry_le);
+
+    // Un-reference
+    mem_deref(route->socket);
+}
+
+/*
+ * Demultiplex received packets to the ICE agent or candidate helper of
+ * the corresponding gatherer.
+ */
+static bool receive_helper(
+        struct sa* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_udp_mux* const mux = arg;
+    struct rawrtc_udp_mux_route* route;
+    struct rawrtc_udp_mux_entry* entry;
+    bool is_binding_request;
+    struct pl username;
+    struct pl username_fragment;
+
+    // STUN
+    if (parse_stun_message(&is_binding_request, &username, buffer)) {
+        // Binding request: Route by username fragment
+        // Note: The remote address is not being learned as message integrity has not been
+        //       checked yet. The ICE agent's triggered check will add the route.
+        if (is_binding_request) {
+            if (!get_username_fragment(&username_fragment, &username, true)
+                    || !(entry = entry_lookup(mux, &username_fragment))) {
+                DEBUG_PRINTF("Dropping STUN request from %J with unknown username\n", source);
+                ++mux->n_dropped;
+                return true;
+            }
+            rawrtc_candidate_helper_inspect_stun(entry->candidate_helper, source, buffer);
+            trice_lcand_recv_packet(entry->candidate_helper->candidate, source, buffer);
+            return true;
+        }
+
+        // Other (e.g. responses): Route by remote address
+        route = route_lookup(mux, source);
+        if (route) {
+            trice_lcand_recv_packet(route->entry->candidate_helper->candidate, source, buffer);
+            return true;
+        }
+
+        // Unknown: Continue with other helpers (e.g. STUN keep-alive)
+        return false;
+    }
+
+    // Everything else: Route by remote address
+    route = route_lookup(mux, source);
+    if (!route) {
+        DEBUG_PRINTF("Dropping packet from unknown remote address %J\n", source);
+        ++mux->n_dropped;
+        return true;
+    }
+    return rawrtc_candidate_helper_receive(route->entry->candidate_helper, source, buffer);
+}
+
+/*
+ * Learn remote addresses from outgoing connectivity checks so that
+ * the responses can be routed.
+ */
+static bool send_helper(
+        int* err,
+        struct sa* destination,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_udp_mux* const mux = arg;
+    struct rawrtc_udp_mux_entry* entry;
+    bool is_binding_request;
+    struct pl username;
+    struct pl username_fragment;
+    (void) err;
+
+    // Binding request with our username fragment (`<remote>:<local>`)?
+    if (parse_stun_message(&is_binding_request, &username, buffer) && is_binding_request
+            && get_username_fragment(&username_fragment, &username, false)) {
+        entry = entry_lookup(mux, &username_fragment);
+        if (entry) {
+            rawrtc_udp_mux_learn_route(entry, destination);
+        }
+    }
+
+    // Continue sending
+    return false;
+}
+
+/*
+ * Handle packets no helper took care of.
+ */
+static void receive_handler(
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_udp_mux* const mux = arg;
+    (void) buffer;
+
+    DEBUG_PRINTF("Dropping unhandled packet from %J\n", source);
+    ++mux->n_dropped;
+}
+
+/*
+ * Steer STUN binding requests to the shard (socket of the SO_REUSEPORT
+ * group) encoded in the local username fragment of the USERNAME
+ * attribute (see `rawrtc_udp_mux_steer_username_fragment`).
+ *
+ * Everything else falls back to the kernel's hash based selection
+ * unless a connected route socket of the shard that owns the remote
+ * address takes precedence (see `open_route_socket`).
+ */
+static int attach_username_steering(
+        int const fd,
+        uint16_t const n_shards
+) {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // Note: Classic BPF cannot loop, so the attributes are being walked unrolled. The program
+    //       starts at the UDP payload. Returning an invalid index selects by hash.
+    struct sock_filter code[5 + RAWRTC_UDP_MUX_STEERING_MAX_ATTRIBUTES * 7 + 4];
+    struct sock_fprog program;
+    size_t const found = ARRAY_SIZE(code) - 3;
+    size_t i = 0;
+    size_t attribute;
+
+    // Binding request with magic cookie? Otherwise, select by hash.
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 4);
+    code[i] = (struct sock_filter) BPF_JUMP(
+            BPF_JMP | BPF_JEQ | BPF_K, STUN_MAGIC_COOKIE, 0, (uint8_t) (found - 1 - i - 1));
+    ++i;
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 0);
+    code[i] = (struct sock_filter) BPF_JUMP(
+            BPF_JMP | BPF_JEQ | BPF_K, STUN_TYPE_BINDING_REQUEST, 0, (uint8_t) (found - 1 - i - 1));
+    ++i;
+
+    // Walk attributes until USERNAME has been found (X = attribute offset)
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_LDX | BPF_IMM, STUN_HEADER_SIZE);
+    for (attribute = 0; attribute < RAWRTC_UDP_MUX_STEERING_MAX_ATTRIBUTES; ++attribute) {
+        code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_IND, 0); // A = type
+        code[i] = (struct sock_filter) BPF_JUMP(
+                BPF_JMP | BPF_JEQ | BPF_K, STUN_ATTR_USERNAME, (uint8_t) (found - i - 1), 0);
+        ++i;
+        code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_H | BPF_IND, 2); // A = length
+        code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_ADD | BPF_K, 3 + 4);
+        code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_AND | BPF_K, ~(uint32_t) 3);
+        code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_ADD | BPF_X, 0);
+        code[i++] = (struct sock_filter) BPF_STMT(BPF_MISC | BPF_TAX, 0); // X = next attribute
+    }
+
+    // Not found: Select by hash
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_K, n_shards);
+
+    // Found: Shard = first character of the local username fragment % n_shards
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_LD | BPF_B | BPF_IND, 4);
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, n_shards);
+    code[i++] = (struct sock_filter) BPF_STMT(BPF_RET | BPF_A, 0);
+
+    // Attach
+    program.len = (unsigned short) i;
+    program.filter = code;
+    if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program))) {
+        return errno;
+    }
+    return 0;
+#else
+    (void) fd; (void) n_shards;
+    return ENOTSUP;
+#endif
+}
+
+/*
+ * Create and bind a UDP socket with SO_REUSEPORT. If `peer` is set, the
+ * socket will be connected to it.
+ */
+static int listen_reuse_port(
+        struct udp_sock** const socketp, // de-referenced
+        struct sa const* const address,
+        struct sa const* const peer, // nullable
+        uint16_t const n_shards,
+        udp_recv_h* const receive_handler,
+        void* const arg
+) {
+    struct udp_sock* udp_socket;
+    int fd;
+    int const enable = 1;
+    int err;
+
+    // Create socket (unbound)
+    err = udp_open(&udp_socket, sa_af(address));
+    if (err) {
+        return err;
+    }
+    fd = udp_sock_fd(udp_socket, sa_af(address));
+
+    // Enable SO_REUSEPORT
+#if defined(SO_REUSEPORT)
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable))) {
+        err = errno;
+        goto out;
+    }
+#else
+    (void) enable;
+    err = ENOTSUP;
+    goto out;
+#endif
+
+    // Bind
+    if (bind(fd, &address->u.sa, address->len)) {
+        err = errno;
+        goto out;
+    }
+
+    // Attach steering program (applies to the whole group)
+    // Note: This must happen after binding, otherwise the socket would have its own group and
+    //       other sockets could not bind to the port.
+    if (!peer && n_shards > 1) {
+        err = attach_username_steering(fd, n_shards);
+        if (err) {
+            DEBUG_WARNING("Could not attach steering program, reason: %m\n", err);
+            goto out;
+        }
+    }
+
+    // Connect
+    // Note: A connected socket takes precedence over the group's other sockets for packets
+    //       from its peer.
+    if (peer && connect(fd, &peer->u.sa, peer->len)) {
+        err = errno;
+        goto out;
+    }
+
+    // Set receive handler
+    udp_handler_set(udp_socket, receive_handler, arg);
+
+out:
+    if (err) {
+        mem_deref(udp_socket);
+    } else {
+        // Set pointer
+        *socketp = udp_socket;
+    }
+    return err;
+}
+
+/*
+ * Handle packets received on a route socket as if they had been
+ * received on the mux's socket.
+ */
+static void route_receive_handler(
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct rawrtc_udp_mux* const mux = arg;
+
+    // Demultiplex (or continue with the mux socket's other helpers)
+    if (!receive_helper((struct sa*) source, buffer, mux)) {
+        udp_recv_helper(mux->socket, source, buffer, mux->helper);
+    }
+}
+
+/*
+ * Open a socket connected to the remote address of a route so that
+ * the kernel delivers its packets to this shard (sharded mux only).
+ * Without it, packets that cannot be steered by the username fragment
+ * (e.g. responses and DTLS) would land on an arbitrary shard.
+ */
+static void open_route_socket(
+        struct rawrtc_udp_mux_route* const route
+) {
+    struct rawrtc_udp_mux* const mux = route->entry->mux;
+    int err;
+
+    // Sharded?
+    if (mux->n_shards < 2) {
+        return;
+    }
+
+    // Bind & connect
+    err = listen_reuse_port(
+            &route->socket, &mux->address, &route->address, mux->n_shards,
+            route_receive_handler, mux);
+    if (err) {
+        DEBUG_WARNING("Could not open route socket for %J, reason: %m\n", &route->address, err);
+    }
+}
+
+/*
+ * Associate a remote address with an entry. An existing route to
+ * another entry will be moved.
+ * Note: The address must have been authenticated (e.g. the destination
+ *       of our own connectivity check), otherwise anyone able to spoof a
+ *       packet could take over another peer's route.
+ */
+void rawrtc_udp_mux_learn_route(
+        struct rawrtc_udp_mux_entry* const entry,
+        struct sa const* const address
+) {
+    struct rawrtc_udp_mux_route* route;
+
+    // Check arguments
+    if (!entry || !address) {
+        return;
+    }
+
+    // Existing route
+    route = route_lookup(entry->mux, address);
+    if (route) {
+        if (route->entry != entry) {
+            // Note: A remote address can only be routed to one gatherer at a time.
+            DEBUG_NOTICE("Remote address %J moved to another gatherer\n", address);
+            list_unlink(&route->entry_le);
+            list_append(&entry->routes, &route->entry_le, route);
+            route->entry = entry;
+        }
+        return;
+    }
+
+    // Too many routes? Replace the oldest one.
+    if (list_count(&entry->routes) >= RAWRTC_UDP_MUX_MAX_ROUTES_PER_ENTRY) {
+        route = list_ledata(list_head(&entry->routes));
+        DEBUG_NOTICE("Too many routes, dropping route for %J\n", &route->address);
+        mem_deref(route);
+    }
+
+    // Allocate
+    route = mem_zalloc(sizeof(*route), rawrtc_udp_mux_route_destroy);
+    if (!route) {
+        return;
+    }
+
+    // Set fields and add to mux and entry
+    // Note: The entry owns the route.
+    route->address = *address;
+    route->entry = entry;
+    hash_append(entry->mux->routes, sa_hash(address, SA_ALL), &route->le, route);
+    list_append(&entry->routes, &route->entry_le, route);
+    open_route_socket(route);
+    DEBUG_PRINTF("Learned route for %J\n", address);
+}
+
+/*
+ * Destructor for an existing UDP mux.
+ */
+static void rawrtc_udp_mux_destroy(
+        void* arg
+) {
+    struct rawrtc_udp_mux* const mux = arg;
+
+    // Remove from global list
+    list_unlink(&mux->le);
+
+    // Un-reference
+    mem_deref(mux->helper);
+    mem_deref(mux->socket);
+    mem_deref(mux->routes);
+    mem_deref(mux->entries);
+}
+
+/*
+ * Get the UDP mux for a local address (including the port). The mux
+ * will be created if it does not exist yet. If `n_shards` is not 0,
+ * the socket will be bound with SO_REUSEPORT.
+ * `*muxp` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_udp_mux_get(
+        struct rawrtc_udp_mux** const muxp, // de-referenced
+        struct sa const* const address,
+        uint16_t const n_shards
+) {
+    struct le* le;
+    struct rawrtc_udp_mux* mux;
+    int err;
+
+    // Check arguments
+    if (!muxp || !address) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Find existing mux
+    for (le = list_head(&rawrtc_global.udp_muxes); le != NULL; le = le->next) {
+        mux = le->data;
+        if (sa_cmp(&mux->address, address, SA_ALL)) {
+            *muxp = mem_ref(mux);
+            return RAWRTC_CODE_SUCCESS;
+        }
+    }
+
+    // Allocate
+    mux = mem_zalloc(sizeof(*mux), rawrtc_udp_mux_destroy);
+    if (!mux) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+    mux->address = *address;
+    mux->n_shards = n_shards;
+
+    // Create hash tables
+    err = hash_alloc(&mux->entries, 256);
+    if (err) {
+        goto out;
+    }
+    err = hash_alloc(&mux->routes, 256);
+    if (err) {
+        goto out;
+    }
+
+    // Bind socket and attach demultiplexer
+    // Note: The demultiplexer is called before any other helper (lowest layer).
+    if (n_shards > 0) {
+        err = listen_reuse_port(&mux->socket, address, NULL, n_shards, receive_handler, mux);
+    } else {
+        err = udp_listen(&mux->socket, address, receive_handler, mux);
+    }
+    if (err) {
+        DEBUG_WARNING("Could not bind UDP mux socket to %J, reason: %m\n", address, err);
+        goto out;
+    }
+    err = udp_register_helper(
+            &mux->helper, mux->socket, RAWRTC_LAYER_UDP_MUX, send_helper, receive_helper, mux);
+    if (err) {
+        goto out;
+    }
+
+    // Add to global list
+    // Note: The list does not hold a reference, the mux removes itself once destroyed.
+    list_append(&rawrtc_global.udp_muxes, &mux->le, mux);
+    DEBUG_PRINTF("Created UDP mux on %J\n", address);
+
+out:
+    if (err) {
+        mem_deref(mux);
+    } else {
+        // Set pointer
+        *muxp = mux;
+    }
+    return rawrtc_error_to_code(err);
+}
+
+/*
+ * Destructor for an existing UDP mux entry.
+ */
+static void rawrtc_udp_mux_entry_destroy(
+        void* arg
+) {
+    struct rawrtc_udp_mux_entry* const entry = arg;
+
+    // Remove from mux
+    hash_unlink(&entry->le);
+
+    // Un-reference
+    list_flush(&entry->routes);
+    mem_deref(entry->username_fragment);
+    mem_deref(entry->mux);
+}
+
+/*
+ * Add a candidate helper (using the mux's socket) to a UDP mux.
+ * `*entryp` must be unreferenced.
+ */
+enum rawrtc_code rawrtc_udp_mux_add(
+        struct rawrtc_udp_mux_entry** const entryp, // de-referenced
+        struct rawrtc_udp_mux* const mux,
+        struct rawrtc_candidate_helper* const candidate_helper,
+        char const* const username_fragment // copied
+) {
+    struct rawrtc_udp_mux_entry* entry;
+    enum rawrtc_code error;
+
+    // Check arguments
+    if (!entryp || !mux || !candidate_helper || !username_fragment) {
+        return RAWRTC_CODE_INVALID_ARGUMENT;
+    }
+
+    // Allocate
+    entry = mem_zalloc(sizeof(*entry), rawrtc_udp_mux_entry_destroy);
+    if (!entry) {
+        return RAWRTC_CODE_NO_MEMORY;
+    }
+
+    // Set fields/reference/copy
+    // Note: The username fragment is being copied as the gatherer replaces its own on an ICE
+    //       restart while the entry of the previous session is still in use.
+    entry->mux = mem_ref(mux);
+    entry->candidate_helper = candidate_helper;
+    list_init(&entry->routes);
+    error = rawrtc_strdup(&entry->username_fragment, username_fragment);
+    if (error) {
+        mem_deref(entry);
+        return error;
+    }
+
+    // Add to mux
+    hash_append(mux->entries, hash_joaat(
+            (uint8_t const*) entry->username_fragment, strlen(entry->username_fragment)),
+            &entry->le, entry);
+
+    // Set pointer
+    *entryp = entry;
+    return RAWRTC_CODE_SUCCESS;
+}
+
+/*
+ * Encode the shard into a random local username fragment so that the
+ * steering program delivers incoming STUN binding requests to this
+ * shard: `<first character> % n_shards == shard`.
+ */
+void rawrtc_udp_mux_steer_username_fragment(
+        char* const username_fragment,
+        uint16_t const n_shards,
+        uint16_t const shard
+) {
+    uint8_t first;
+
+    // Check arguments
+    if (!username_fragment || n_shards < 2 || n_shards > RAWRTC_UDP_MUX_MAX_SHARDS
+            || shard >= n_shards) {
+        return;
+    }
+
+    // Pick a random lower-case letter for that shard
+    first = (uint8_t) ('a' + (shard + n_shards - 'a' % n_shards) % n_shards);
+    username_fragment[0] = (char) (first + n_shards * (rand_u16() % (('z' - first) / n_shards + 1)));
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <rawrtc.h>
+
+enum {
+    RAWRTC_UDP_MUX_MAX_ROUTES_PER_ENTRY = 64, // the oldest route will be replaced once exceeded
+    RAWRTC_UDP_MUX_MAX_SHARDS = 26, // shard is encoded as a lower-case letter
+    RAWRTC_UDP_MUX_STEERING_MAX_ATTRIBUTES = 8, // STUN attributes searched for USERNAME
+};
+
+/*
+ * Shared UDP socket for the host candidates of many ICE gatherers.
+ * Incoming STUN requests are being demultiplexed by the local ICE
+ * username fragment, everything else by the remote address.
+ */
+struct rawrtc_udp_mux {
+    struct le le;
+    struct sa address;
+    struct udp_sock* socket;
+    struct udp_helper* helper;
+    struct hash* entries; // by username fragment
+    struct hash* routes; // by remote address
+    uint16_t n_shards; // 0 if SO_REUSEPORT is disabled
+    uint64_t n_dropped;
+};
+
+/*
+ * Host candidate of an ICE gatherer using the UDP mux.
+ */
+struct rawrtc_udp_mux_entry {
+    struct le le;
+    struct rawrtc_udp_mux* mux; // referenced
+    struct rawrtc_candidate_helper* candidate_helper;
+    char* username_fragment; // copied
+    struct list routes;
+};
+
+/*
+ * Remote address learned from authenticated STUN traffic (our own
+ * connectivity checks or authenticated requests).
+ */
+struct rawrtc_udp_mux_route {
+    struct le le;
+    struct le entry_le;
+    struct sa address;
+    struct rawrtc_udp_mux_entry* entry;
+    struct udp_sock* socket; // nullable, connected to the address (sharded mux only)
+};
+
+enum rawrtc_code rawrtc_udp_mux_get(
+    struct rawrtc_udp_mux** const muxp, // de-referenced
+    struct sa const* const address,
+    uint16_t const n_shards
+);
+
+enum rawrtc_code rawrtc_udp_mux_add(
+    struct rawrtc_udp_mux_entry** const entryp, // de-referenced
+    struct rawrtc_udp_mux* const mux,
+    struct rawrtc_candidate_helper* const candidate_helper,
+    char const* const username_fragment // copied
+);
+
+void rawrtc_udp_mux_learn_route(
+    struct rawrtc_udp_mux_entry* const entry,
+    struct sa const* const address
+);
+
+void rawrtc_udp_mux_steer_username_fragment(
+    char* const username_fragment,
+    uint16_t const n_shards,
+    uint16_t const shard
+);
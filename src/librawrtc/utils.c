@@ -15,11 +15,10 @@
  * Default rawrtc options.
  */
 struct rawrtc_config rawrtc_default_config = {
-    .pacing_interval = 20,
     .ipv4_enable = true,
     .ipv6_enable = true,
     .udp_enable = true,
-    .tcp_enable = false, // TODO: true by default
+    .tcp_enable = true,
     .sign_algorithm = RAWRTC_CERTIFICATE_SIGN_ALGORITHM_SHA256,
     .ice_server_normal_transport = RAWRTC_ICE_SERVER_TRANSPORT_UDP,
     .ice_server_secure_transport = RAWRTC_ICE_SERVER_TRANSPORT_TLS,
@@ -52,6 +51,23 @@ struct rawrtc_data_channel_options rawrtc_default_data_channel_options = {
     .deliver_partially = false
 };
 
+/*
+ * Default ICE transport options.
+ * Note: The retransmission parameters are trice's defaults for
+ *       connectivity checks.
+ */
+struct rawrtc_ice_transport_options rawrtc_default_ice_transport_options = {
+    .pacing_interval = 20,
+    .nomination = RAWRTC_ICE_NOMINATION_AGGRESSIVE,
+    .stun_config = {
+        100,
+        4,
+        STUN_DEFAULT_RM,
+        STUN_DEFAULT_TI,
+        0x00
+    }
+};
+
 /*
  * Translate a rawrtc return code to a string.
  */
@@ -99,6 +115,8 @@ char const* rawrtc_code_to_str(
             return "stop iteration";
         case RAWRTC_CODE_NOT_PERMITTED:
             return "not permitted";
+        case RAWRTC_CODE_IO_ERROR:
+            return "I/O error";
         default:
             return "(no error translation)";
     }
@@ -131,6 +149,10 @@ enum rawrtc_code rawrtc_error_to_code(
             return RAWRTC_CODE_NO_MEMORY;
         case EPERM:
             return RAWRTC_CODE_NOT_PERMITTED;
+        case EIO:
+            return RAWRTC_CODE_IO_ERROR;
+        case ENOSPC:
+            return RAWRTC_CODE_INSUFFICIENT_SPACE;
         default:
             return RAWRTC_CODE_UNKNOWN_ERROR;
     }
@@ -979,3 +1001,14 @@ enum rawrtc_code rawrtc_sdprintf(
     va_end(args);
     return rawrtc_error_to_code(err);
 }
+
+/*
+ * Set a timestamp to the current time (unless already set).
+ */
+void rawrtc_timestamp_once(
+        uint64_t* const timestampp // de-referenced
+) {
+    if (*timestampp == 0) {
+        *timestampp = tmr_jiffies();
+    }
+}
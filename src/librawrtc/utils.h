@@ -6,6 +6,7 @@
 extern struct rawrtc_config rawrtc_default_config;
 extern struct rawrtc_certificate_options rawrtc_default_certificate_options;
 extern struct rawrtc_data_channel_options rawrtc_default_data_channel_options;
+extern struct rawrtc_ice_transport_options rawrtc_default_ice_transport_options;
 
 enum ice_cand_type rawrtc_ice_candidate_type_to_ice_cand_type(
     enum rawrtc_ice_candidate_type const type
@@ -78,3 +79,7 @@ enum rawrtc_code rawrtc_colon_hex_to_bin(
     size_t const buffer_size,
     char* source
 );
+
+void rawrtc_timestamp_once(
+    uint64_t* const timestampp // de-referenced
+);
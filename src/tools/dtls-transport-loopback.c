@@ -1,3 +1,9 @@
+#include <stdlib.h> // getenv
+#include <string.h> // strcmp
+#include <time.h> // clock_gettime
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // __rdtsc
+#endif
 #include <rawrtc.h>
 #include "../librawrtc/dtls_transport.h" /* TODO: Replace with <rawrtc_internal/dtls_transport.h> */
 #include "helper/utils.h"
@@ -16,7 +22,9 @@ struct dtls_transport_client {
     struct rawrtc_ice_parameters* ice_parameters;
     struct rawrtc_dtls_parameters* dtls_parameters;
     enum rawrtc_ice_role role;
+    struct rawrtc_certificate_options* certificate_options;
     struct rawrtc_certificate* certificate;
+    uint64_t handshake_start;
     struct rawrtc_ice_gatherer* gatherer;
     struct rawrtc_ice_transport* ice_transport;
     struct rawrtc_dtls_transport* dtls_transport;
@@ -38,6 +46,82 @@ static void ice_gatherer_local_candidate_handler(
             arg, candidate, client->other_client->ice_transport);
 }
 
+/*
+ * Number of packets and packet size used by the send benchmark.
+ */
+enum {
+    SEND_BENCHMARK_PACKETS = 1000,
+    SEND_BENCHMARK_PACKET_SIZE = 1024,
+};
+
+/*
+ * Get a timestamp in nanoseconds.
+ */
+static uint64_t get_nanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+/*
+ * Get the CPU's timestamp counter (or 0 if unavailable).
+ */
+static uint64_t get_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/*
+ * Measure the cost of sending packets on a connected DTLS transport.
+ */
+static void send_benchmark(
+        struct dtls_transport_client* const client
+) {
+    struct mbuf* buffer;
+    size_t i;
+    uint64_t start_ns;
+    uint64_t start_cycles;
+    uint64_t elapsed_ns;
+    uint64_t elapsed_cycles;
+    enum rawrtc_code error;
+
+    // Prepare packet
+    buffer = mbuf_alloc(SEND_BENCHMARK_PACKET_SIZE);
+    if (!buffer) {
+        DEBUG_WARNING("(%s) Could not allocate benchmark packet\n", client->name);
+        return;
+    }
+    mbuf_fill(buffer, 0xdb, SEND_BENCHMARK_PACKET_SIZE);
+
+    // Send packets
+    start_ns = get_nanoseconds();
+    start_cycles = get_cycles();
+    for (i = 0; i < SEND_BENCHMARK_PACKETS; ++i) {
+        mbuf_set_pos(buffer, 0);
+        error = rawrtc_dtls_transport_send(client->dtls_transport, buffer);
+        if (error) {
+            DEBUG_WARNING("(%s) Benchmark send failed, reason: %s\n",
+                          client->name, rawrtc_code_to_str(error));
+            break;
+        }
+    }
+    elapsed_cycles = get_cycles() - start_cycles;
+    elapsed_ns = get_nanoseconds() - start_ns;
+
+    // Print results
+    if (i > 0) {
+        DEBUG_INFO("(%s) Sent %zu packets of %d bytes: %"PRIu64" ns/packet, %"PRIu64
+                   " cycles/packet, %"PRIu64" MB/s\n", client->name, i, SEND_BENCHMARK_PACKET_SIZE,
+                   elapsed_ns / i, elapsed_cycles / i,
+                   elapsed_ns > 0 ? (uint64_t) i * SEND_BENCHMARK_PACKET_SIZE * 1000 / elapsed_ns
+                                  : 0);
+    }
+    mem_deref(buffer);
+}
+
 static void dtls_transport_state_change_handler(
         enum rawrtc_dtls_transport_state const state, // read-only
         void* const arg
@@ -64,15 +148,28 @@ static void dtls_transport_state_change_handler(
         }
         mem_deref(buffer);
     }
+
+    // Connecting? Start measuring handshake duration
+    if (state == RAWRTC_DTLS_TRANSPORT_STATE_CONNECTING) {
+        client->handshake_start = get_nanoseconds();
+    }
+
+    // Connected? Print handshake duration and measure per-packet send cost
+    if (state == RAWRTC_DTLS_TRANSPORT_STATE_CONNECTED) {
+        DEBUG_INFO("(%s) DTLS handshake completed in %"PRIu64" us\n",
+                   client->name, (get_nanoseconds() - client->handshake_start) / 1000);
+        send_benchmark(client);
+    }
 }
 
 static void client_init(
         struct dtls_transport_client* const local
 ) {
     struct rawrtc_certificate* certificates[1];
+    char const* cipher_suites[] = {getenv("DTLS_CIPHER_SUITE")};
 
     // Generate certificates
-    EOE(rawrtc_certificate_generate(&local->certificate, NULL));
+    EOE(rawrtc_certificate_generate(&local->certificate, local->certificate_options));
     certificates[0] = local->certificate;
 
     // Create ICE gatherer
@@ -91,6 +188,12 @@ static void client_init(
     EOE(rawrtc_dtls_transport_create(
             &local->dtls_transport, local->ice_transport, certificates, ARRAY_SIZE(certificates),
             dtls_transport_state_change_handler, default_dtls_transport_error_handler, local));
+
+    // Set cipher suite (optional, to compare bulk encryption throughput)
+    if (cipher_suites[0]) {
+        EOE(rawrtc_dtls_transport_set_cipher_suites(
+                local->dtls_transport, cipher_suites, ARRAY_SIZE(cipher_suites)));
+    }
 }
 
 static void client_start(
@@ -134,6 +237,38 @@ static void client_stop(
     client->certificate = mem_deref(client->certificate);
 }
 
+/*
+ * Create certificate options from the key type in the `DTLS_KEY_TYPE`
+ * environment variable (rsa, ec or ed25519) to compare handshake
+ * durations. Defaults will be used if not set.
+ */
+static struct rawrtc_certificate_options* certificate_options_from_env() {
+    struct rawrtc_certificate_options* options = NULL;
+    char const* const key_type = getenv("DTLS_KEY_TYPE");
+
+    if (!key_type) {
+        return NULL;
+    } else if (strcmp(key_type, "rsa") == 0) {
+        EOE(rawrtc_certificate_options_create(
+                &options, RAWRTC_CERTIFICATE_KEY_TYPE_RSA, NULL, 0,
+                RAWRTC_CERTIFICATE_SIGN_ALGORITHM_NONE, NULL, 2048));
+    } else if (strcmp(key_type, "ec") == 0) {
+        EOE(rawrtc_certificate_options_create(
+                &options, RAWRTC_CERTIFICATE_KEY_TYPE_EC, NULL, 0,
+                RAWRTC_CERTIFICATE_SIGN_ALGORITHM_NONE, "prime256v1", 0));
+    } else if (strcmp(key_type, "ed25519") == 0) {
+        EOE(rawrtc_certificate_options_create(
+                &options, RAWRTC_CERTIFICATE_KEY_TYPE_ED25519, NULL, 0,
+                RAWRTC_CERTIFICATE_SIGN_ALGORITHM_NONE, NULL, 0));
+    } else {
+        DEBUG_WARNING("Unknown key type: %s\n", key_type);
+        exit(1);
+    }
+
+    DEBUG_INFO("Using key type: %s\n", key_type);
+    return options;
+}
+
 static void exit_with_usage(char* program) {
     DEBUG_WARNING("Usage: %s [<ice-candidate-type> ...]", program);
     exit(1);
@@ -143,6 +278,7 @@ int main(int argc, char* argv[argc + 1]) {
     char** ice_candidate_types = NULL;
     size_t n_ice_candidate_types = 0;
     struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_certificate_options* certificate_options;
     char* const stun_google_com_urls[] = {"stun:stun.l.google.com:19302",
                                           "stun:stun1.l.google.com:19302"};
     char* const turn_threema_ch_urls[] = {"turn:turn.threema.ch:443"};
@@ -176,11 +312,15 @@ int main(int argc, char* argv[argc + 1]) {
             "threema-angular", "Uv0LcCq3kyx6EiRwQW5jVigkhzbp70CjN2CJqzmRxG3UGIdJHSJV6tpo7Gj7YnGB",
             RAWRTC_ICE_CREDENTIAL_TYPE_PASSWORD));
 
+    // Get certificate options (optional)
+    certificate_options = certificate_options_from_env();
+
     // Setup client A
     a.name = "A";
     a.ice_candidate_types = ice_candidate_types;
     a.n_ice_candidate_types = n_ice_candidate_types;
     a.gather_options = gather_options;
+    a.certificate_options = certificate_options;
     a.role = RAWRTC_ICE_ROLE_CONTROLLING;
     a.other_client = &b;
 
@@ -189,6 +329,7 @@ int main(int argc, char* argv[argc + 1]) {
     b.ice_candidate_types = ice_candidate_types;
     b.n_ice_candidate_types = n_ice_candidate_types;
     b.gather_options = gather_options;
+    b.certificate_options = certificate_options;
     b.role = RAWRTC_ICE_ROLE_CONTROLLED;
     b.other_client = &a;
 
@@ -209,6 +350,7 @@ int main(int argc, char* argv[argc + 1]) {
     client_stop(&b);
 
     // Free
+    mem_deref(certificate_options);
     mem_deref(gather_options);
 
     // Bye
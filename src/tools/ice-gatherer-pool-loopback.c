@@ -0,0 +1,225 @@
+#include <rawrtc.h>
+#include "helper/utils.h"
+#include "helper/handler.h"
+
+#define DEBUG_MODULE "ice-gatherer-pool-loopback-app"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    POOL_SIZE = 2,
+    TIMEOUT = 15000, // in milliseconds
+};
+
+// Note: The mapped address must differ from the base, otherwise the gatherer drops the candidate.
+static char const stun_mapped_address[] = "192.0.2.1"; // TEST-NET-1 (RFC 5737)
+
+/*
+ * Minimal STUN server stand-in (RFC 5389) for loopback testing.
+ * Answers binding requests with a fixed mapped address.
+ */
+struct stun_server {
+    struct udp_sock* socket;
+    struct sa address;
+    uint64_t n_requests;
+};
+
+// Note: Shadows struct client
+struct pool_client {
+    char* name;
+    char** ice_candidate_types;
+    size_t n_ice_candidate_types;
+    struct rawrtc_ice_gatherer* gatherer;
+    uint_fast16_t n_srflx_candidates;
+    bool complete;
+};
+
+static struct stun_server server = {0};
+static struct pool_client clients[POOL_SIZE] = {0};
+static struct tmr timeout_timer;
+static int exit_code = 1;
+
+static void server_receive_handler(
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct stun_msg* message = NULL;
+    struct sa mapped;
+    (void) arg;
+
+    // Binding request?
+    if (stun_msg_decode(&message, buffer, NULL)) {
+        return;
+    }
+    if (stun_msg_class(message) != STUN_CLASS_REQUEST
+            || stun_msg_method(message) != STUN_METHOD_BINDING) {
+        goto out;
+    }
+    ++server.n_requests;
+
+    // Reply with the fixed mapped address (keeping the source port)
+    if (sa_set_str(&mapped, stun_mapped_address, sa_port(source))) {
+        goto out;
+    }
+    stun_reply(IPPROTO_UDP, server.socket, source, 0, message, NULL, 0, false, 1,
+               STUN_ATTR_XOR_MAPPED_ADDR, &mapped);
+
+out:
+    mem_deref(message);
+}
+
+static void server_start(void) {
+    struct sa address;
+
+    // Bind on loopback
+    EOR(sa_set_str(&address, "127.0.0.1", 0));
+    EOR(udp_listen(&server.socket, &address, server_receive_handler, NULL));
+    EOR(udp_local_get(server.socket, &server.address));
+    DEBUG_INFO("(STUN) Listening on %J\n", &server.address);
+}
+
+static void server_stop(void) {
+    server.socket = mem_deref(server.socket);
+}
+
+/*
+ * Stop once every pooled gatherer completed with a server reflexive
+ * candidate of its own.
+ */
+static void check_done(void) {
+    size_t i;
+    for (i = 0; i < ARRAY_SIZE(clients); ++i) {
+        if (!clients[i].complete) {
+            return;
+        }
+    }
+
+    // Check candidates
+    exit_code = 0;
+    for (i = 0; i < ARRAY_SIZE(clients); ++i) {
+        if (clients[i].n_srflx_candidates == 0) {
+            DEBUG_WARNING("(%s) No server reflexive candidate gathered\n", clients[i].name);
+            exit_code = 1;
+        }
+    }
+    DEBUG_INFO("All pooled gatherers complete (%"PRIu64" binding requests)\n", server.n_requests);
+    re_cancel();
+}
+
+static void timeout_handler(
+        void* arg
+) {
+    (void) arg;
+    DEBUG_WARNING("Timeout: Pooled gatherers did not complete (%"PRIu64" binding requests)\n",
+                  server.n_requests);
+    re_cancel();
+}
+
+static void ice_gatherer_state_change_handler(
+        enum rawrtc_ice_gatherer_state const state, // read-only
+        void* const arg
+) {
+    struct pool_client* const client = arg;
+
+    // Print state
+    default_ice_gatherer_state_change_handler(state, arg);
+
+    // Complete?
+    if (state == RAWRTC_ICE_GATHERER_COMPLETE) {
+        client->complete = true;
+        check_done();
+    }
+}
+
+static void ice_gatherer_local_candidate_handler(
+        struct rawrtc_ice_candidate* const candidate,
+        char const * const url, // read-only
+        void* const arg
+) {
+    struct pool_client* const client = arg;
+    enum rawrtc_ice_candidate_type type;
+
+    // Print local candidate
+    default_ice_gatherer_local_candidate_handler(candidate, url, arg);
+
+    // Server reflexive candidate?
+    if (candidate) {
+        EOE(rawrtc_ice_candidate_get_type(&type, candidate));
+        if (type == RAWRTC_ICE_CANDIDATE_TYPE_SRFLX) {
+            ++client->n_srflx_candidates;
+        }
+    }
+}
+
+int main(int argc, char* argv[argc + 1]) {
+    char* ice_candidate_types[] = {"host", "srflx"};
+    char* const names[POOL_SIZE] = {"A", "B"};
+    char const* hostname = "localhost";
+    char url[128];
+    char* urls[] = {url};
+    struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_ice_gatherer_pool* pool;
+    size_t i;
+
+    // Hostname of the STUN server stand-in (must resolve to 127.0.0.1)
+    if (argc > 1) {
+        hostname = argv[1];
+    }
+
+    // Initialise
+    EOE(rawrtc_init());
+
+    // Debug
+    dbg_init(DBG_DEBUG, DBG_ALL);
+    DEBUG_PRINTF("Init\n");
+
+    // Start STUN server stand-in
+    server_start();
+    re_snprintf(url, sizeof(url), "stun:%s:%u", hostname, sa_port(&server.address));
+
+    // Create ICE gather options & add the stand-in as ICE server (by hostname)
+    // Note: All pooled gatherers share the options and therefore the ICE server URL.
+    EOE(rawrtc_ice_gather_options_create(&gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+    EOE(rawrtc_ice_gather_options_add_server(
+            gather_options, urls, ARRAY_SIZE(urls), NULL, NULL,
+            RAWRTC_ICE_CREDENTIAL_TYPE_NONE));
+
+    // Create pool (starts gathering on all pooled gatherers)
+    EOE(rawrtc_ice_gatherer_pool_create(&pool, gather_options, POOL_SIZE));
+
+    // Claim pooled gatherers
+    for (i = 0; i < ARRAY_SIZE(clients); ++i) {
+        clients[i].name = names[i];
+        clients[i].ice_candidate_types = ice_candidate_types;
+        clients[i].n_ice_candidate_types = ARRAY_SIZE(ice_candidate_types);
+        EOE(rawrtc_ice_gatherer_pool_claim(
+                &clients[i].gatherer, pool, ice_gatherer_state_change_handler,
+                default_ice_gatherer_error_handler, ice_gatherer_local_candidate_handler,
+                &clients[i]));
+    }
+
+    // Start timeout & main loop
+    tmr_init(&timeout_timer);
+    tmr_start(&timeout_timer, TIMEOUT, timeout_handler, NULL);
+    EOR(re_main(default_signal_handler));
+    tmr_cancel(&timeout_timer);
+
+    // Close gatherers
+    for (i = 0; i < ARRAY_SIZE(clients); ++i) {
+        EOE(rawrtc_ice_gatherer_close(clients[i].gatherer));
+        clients[i].gatherer = mem_deref(clients[i].gatherer);
+    }
+
+    // Stop STUN server stand-in & free
+    mem_deref(pool);
+    server_stop();
+    mem_deref(gather_options);
+
+    // Bye
+    before_exit();
+    if (exit_code) {
+        DEBUG_WARNING("ICE gatherer pool test failed\n");
+    }
+    return exit_code;
+}
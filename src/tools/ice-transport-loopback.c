@@ -1,3 +1,5 @@
+#include <stdlib.h> // getenv
+#include <time.h> // clock_gettime
 #include <rawrtc.h>
 #include "helper/utils.h"
 #include "helper/handler.h"
@@ -17,8 +19,39 @@ struct ice_transport_client {
     struct rawrtc_ice_gatherer* gatherer;
     struct rawrtc_ice_transport* ice_transport;
     struct ice_transport_client* other_client;
+    uint64_t setup_start;
+    uint64_t setup_cpu_start;
 };
 
+/*
+ * Get a timestamp in nanoseconds of a specific clock.
+ */
+static uint64_t get_nanoseconds(
+        clockid_t const clock
+) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+static void ice_transport_state_change_handler(
+        enum rawrtc_ice_transport_state const state,
+        void* const arg
+) {
+    struct ice_transport_client* const client = arg;
+
+    // Print state
+    default_ice_transport_state_change_handler(state, arg);
+
+    // Connected? Print setup duration and CPU time (of the whole process)
+    if (state == RAWRTC_ICE_TRANSPORT_STATE_CONNECTED) {
+        DEBUG_INFO("(%s) ICE connection established in %"PRIu64" us (CPU: %"PRIu64" us)\n",
+                   client->name,
+                   (get_nanoseconds(CLOCK_MONOTONIC) - client->setup_start) / 1000,
+                   (get_nanoseconds(CLOCK_PROCESS_CPUTIME_ID) - client->setup_cpu_start) / 1000);
+    }
+}
+
 static void ice_gatherer_local_candidate_handler(
         struct rawrtc_ice_candidate* const candidate,
         char const * const url, // read-only
@@ -46,7 +79,7 @@ static void client_init(
     // Create ICE transport
     EOE(rawrtc_ice_transport_create(
             &local->ice_transport, local->gatherer,
-            default_ice_transport_state_change_handler,
+            ice_transport_state_change_handler,
             default_ice_transport_candidate_pair_change_handler, local));
 }
 
@@ -58,6 +91,10 @@ static void client_start(
     EOE(rawrtc_ice_gatherer_get_local_parameters(
             &local->ice_parameters, remote->gatherer));
 
+    // Start measuring setup duration
+    local->setup_start = get_nanoseconds(CLOCK_MONOTONIC);
+    local->setup_cpu_start = get_nanoseconds(CLOCK_PROCESS_CPUTIME_ID);
+
     // Start gathering
     EOE(rawrtc_ice_gatherer_gather(local->gatherer, NULL));
 
@@ -88,6 +125,7 @@ int main(int argc, char* argv[argc + 1]) {
     char** ice_candidate_types = NULL;
     size_t n_ice_candidate_types = 0;
     struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_ice_gather_options* lite_gather_options = NULL;
     char* const stun_google_com_urls[] = {"stun:stun.l.google.com:19302",
                                           "stun:stun1.l.google.com:19302"};
     char* const turn_threema_ch_urls[] = {"turn:turn.threema.ch:443"};
@@ -121,6 +159,12 @@ int main(int argc, char* argv[argc + 1]) {
             "threema-angular", "Uv0LcCq3kyx6EiRwQW5jVigkhzbp70CjN2CJqzmRxG3UGIdJHSJV6tpo7Gj7YnGB",
             RAWRTC_ICE_CREDENTIAL_TYPE_PASSWORD));
 
+    // Let client B be an ICE lite agent (if requested)
+    if (getenv("ICE_LITE")) {
+        EOE(rawrtc_ice_gather_options_create(&lite_gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+        EOE(rawrtc_ice_gather_options_set_ice_lite(lite_gather_options, true));
+    }
+
     // Setup client A
     a.name = "A";
     a.ice_candidate_types = ice_candidate_types;
@@ -133,7 +177,7 @@ int main(int argc, char* argv[argc + 1]) {
     b.name = "B";
     b.ice_candidate_types = ice_candidate_types;
     b.n_ice_candidate_types = n_ice_candidate_types;
-    b.gather_options = gather_options;
+    b.gather_options = lite_gather_options ? lite_gather_options : gather_options;
     b.role = RAWRTC_ICE_ROLE_CONTROLLED;
     b.other_client = &a;
 
@@ -154,6 +198,7 @@ int main(int argc, char* argv[argc + 1]) {
     client_stop(&b);
 
     // Free
+    mem_deref(lite_gather_options);
     mem_deref(gather_options);
 
     // Bye
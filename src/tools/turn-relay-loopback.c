@@ -0,0 +1,662 @@
+#include <netinet/in.h> // htons, ntohs
+#include <rawrtc.h>
+#include "../librawrtc/dtls_transport.h" /* TODO: Replace with <rawrtc_internal/dtls_transport.h> */
+#include "helper/utils.h"
+#include "helper/handler.h"
+
+#define DEBUG_MODULE "turn-relay-loopback-app"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    TURN_MAX_PERMISSIONS = 16,
+    TURN_MAX_CHANNELS = 16,
+    TURN_CHANNEL_DATA_HEADER_SIZE = 4,
+    TIMEOUT = 15000, // in milliseconds
+};
+
+static char* const turn_username = "rawrtc";
+static char* const turn_password = "loopback";
+static char const turn_realm[] = "rawrtc.org";
+static char const turn_nonce[] = "c0ffee0123456789";
+
+/*
+ * Minimal TURN server stand-in (RFC 5766) for loopback testing.
+ * Supports long-term credentials, allocations, permissions, channels
+ * and send/data indications over UDP. Allocations never expire.
+ */
+struct turn_server {
+    struct udp_sock* socket;
+    struct sa address;
+    uint8_t key[MD5_SIZE];
+    struct list allocations;
+    uint64_t n_relayed_to_peer;
+    uint64_t n_relayed_to_client;
+    uint64_t n_channel_data; // relayed as ChannelData (both directions)
+};
+
+struct turn_channel {
+    uint16_t number;
+    struct sa peer;
+};
+
+struct turn_allocation {
+    struct le le;
+    struct sa client_address;
+    struct udp_sock* relay_socket;
+    struct sa relay_address;
+    struct sa permissions[TURN_MAX_PERMISSIONS]; // address only, port is ignored
+    size_t n_permissions;
+    struct turn_channel channels[TURN_MAX_CHANNELS];
+    size_t n_channels;
+};
+
+// Note: Shadows struct client
+struct turn_client {
+    char* name;
+    char** ice_candidate_types;
+    size_t n_ice_candidate_types;
+    struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_ice_parameters* ice_parameters;
+    struct rawrtc_dtls_parameters* dtls_parameters;
+    enum rawrtc_ice_role role;
+    struct rawrtc_certificate* certificate;
+    struct rawrtc_ice_gatherer* gatherer;
+    struct rawrtc_ice_transport* ice_transport;
+    struct rawrtc_dtls_transport* dtls_transport;
+    struct turn_client* other_client;
+    bool relay_candidate_gathered;
+    bool relay_pair_selected;
+    bool dtls_connected;
+    bool data_received;
+};
+
+static struct turn_server server = {0};
+static struct tmr timeout_timer;
+static int exit_code = 1;
+
+static struct turn_allocation* allocation_lookup(
+        struct sa const* const client_address
+) {
+    struct le* le;
+    for (le = list_head(&server.allocations); le != NULL; le = le->next) {
+        struct turn_allocation* const allocation = le->data;
+        if (sa_cmp(&allocation->client_address, client_address, SA_ALL)) {
+            return allocation;
+        }
+    }
+    return NULL;
+}
+
+static bool allocation_has_permission(
+        struct turn_allocation* const allocation,
+        struct sa const* const peer
+) {
+    size_t i;
+    for (i = 0; i < allocation->n_permissions; ++i) {
+        if (sa_cmp(&allocation->permissions[i], peer, SA_ADDR)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void allocation_add_permission(
+        struct turn_allocation* const allocation,
+        struct sa const* const peer
+) {
+    if (allocation_has_permission(allocation, peer)
+            || allocation->n_permissions >= TURN_MAX_PERMISSIONS) {
+        return;
+    }
+    allocation->permissions[allocation->n_permissions++] = *peer;
+}
+
+static struct turn_channel* allocation_channel_by_number(
+        struct turn_allocation* const allocation,
+        uint16_t const number
+) {
+    size_t i;
+    for (i = 0; i < allocation->n_channels; ++i) {
+        if (allocation->channels[i].number == number) {
+            return &allocation->channels[i];
+        }
+    }
+    return NULL;
+}
+
+static struct turn_channel* allocation_channel_by_peer(
+        struct turn_allocation* const allocation,
+        struct sa const* const peer
+) {
+    size_t i;
+    for (i = 0; i < allocation->n_channels; ++i) {
+        if (sa_cmp(&allocation->channels[i].peer, peer, SA_ALL)) {
+            return &allocation->channels[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Relay data from a peer to the client (ChannelData if a channel is
+ * bound, Data indication otherwise).
+ */
+static void relay_receive_handler(
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct turn_allocation* const allocation = arg;
+    struct turn_channel* channel;
+    struct mbuf* channel_data;
+    size_t const length = mbuf_get_left(buffer);
+
+    // Permitted?
+    if (!allocation_has_permission(allocation, source)) {
+        DEBUG_NOTICE("(TURN) Dropping data from %J, no permission\n", source);
+        return;
+    }
+
+    // Channel bound?
+    channel = allocation_channel_by_peer(allocation, source);
+    if (channel) {
+        channel_data = mbuf_alloc(TURN_CHANNEL_DATA_HEADER_SIZE + length);
+        if (!channel_data) {
+            return;
+        }
+        mbuf_write_u16(channel_data, htons(channel->number));
+        mbuf_write_u16(channel_data, htons((uint16_t) length));
+        mbuf_write_mem(channel_data, mbuf_buf(buffer), length);
+        channel_data->pos = 0;
+        udp_send(server.socket, &allocation->client_address, channel_data);
+        mem_deref(channel_data);
+        ++server.n_channel_data;
+    } else {
+        stun_indication(IPPROTO_UDP, server.socket, &allocation->client_address, 0,
+                        STUN_METHOD_DATA, NULL, 0, false, 2,
+                        STUN_ATTR_XOR_PEER_ADDR, source,
+                        STUN_ATTR_DATA, buffer);
+    }
+    ++server.n_relayed_to_client;
+}
+
+static void allocation_destroy(
+        void* arg
+) {
+    struct turn_allocation* const allocation = arg;
+    list_unlink(&allocation->le);
+    mem_deref(allocation->relay_socket);
+}
+
+static struct turn_allocation* allocation_create(
+        struct sa const* const client_address
+) {
+    struct turn_allocation* allocation;
+    struct sa relay_address;
+
+    // Allocate
+    allocation = mem_zalloc(sizeof(*allocation), allocation_destroy);
+    if (!allocation) {
+        return NULL;
+    }
+    allocation->client_address = *client_address;
+
+    // Bind relay socket on the server's address
+    sa_cpy(&relay_address, &server.address);
+    sa_set_port(&relay_address, 0);
+    if (udp_listen(&allocation->relay_socket, &relay_address, relay_receive_handler, allocation)
+            || udp_local_get(allocation->relay_socket, &allocation->relay_address)) {
+        mem_deref(allocation);
+        return NULL;
+    }
+
+    // Add to server
+    list_append(&server.allocations, &allocation->le, allocation);
+    DEBUG_PRINTF("(TURN) Allocated %J for %J\n", &allocation->relay_address, client_address);
+    return allocation;
+}
+
+static bool permission_attribute_handler(
+        struct stun_attr const* attribute,
+        void* arg
+) {
+    struct turn_allocation* const allocation = arg;
+    if (attribute->type == STUN_ATTR_XOR_PEER_ADDR) {
+        allocation_add_permission(allocation, &attribute->v.xor_peer_addr);
+    }
+    return false;
+}
+
+static void request_handler(
+        struct sa const* const source,
+        struct stun_msg* const message
+) {
+    struct turn_allocation* allocation = allocation_lookup(source);
+    struct stun_attr* attribute;
+    struct stun_attr* peer_attribute;
+    uint32_t lifetime = 600;
+
+    // Authenticate (long-term credentials)
+    if (!stun_msg_attr(message, STUN_ATTR_MSG_INTEGRITY)
+            || stun_msg_chk_mi(message, server.key, sizeof(server.key))) {
+        stun_ereply(IPPROTO_UDP, server.socket, source, 0, message, 401, "Unauthorized",
+                    NULL, 0, false, 2,
+                    STUN_ATTR_REALM, turn_realm,
+                    STUN_ATTR_NONCE, turn_nonce);
+        return;
+    }
+
+    // Allocation required for anything but allocate requests
+    if (!allocation && stun_msg_method(message) != STUN_METHOD_ALLOCATE) {
+        stun_ereply(IPPROTO_UDP, server.socket, source, 0, message, 437, "Allocation Mismatch",
+                    server.key, sizeof(server.key), false, 0);
+        return;
+    }
+
+    switch (stun_msg_method(message)) {
+        case STUN_METHOD_ALLOCATE:
+            if (!allocation) {
+                allocation = allocation_create(source);
+                if (!allocation) {
+                    stun_ereply(IPPROTO_UDP, server.socket, source, 0, message, 508,
+                                "Insufficient Capacity", server.key, sizeof(server.key),
+                                false, 0);
+                    return;
+                }
+            }
+            stun_reply(IPPROTO_UDP, server.socket, source, 0, message,
+                       server.key, sizeof(server.key), false, 3,
+                       STUN_ATTR_XOR_RELAY_ADDR, &allocation->relay_address,
+                       STUN_ATTR_XOR_MAPPED_ADDR, source,
+                       STUN_ATTR_LIFETIME, &lifetime);
+            break;
+        case STUN_METHOD_REFRESH:
+            attribute = stun_msg_attr(message, STUN_ATTR_LIFETIME);
+            if (attribute && attribute->v.lifetime == 0) {
+                lifetime = 0;
+                mem_deref(allocation);
+            }
+            stun_reply(IPPROTO_UDP, server.socket, source, 0, message,
+                       server.key, sizeof(server.key), false, 1,
+                       STUN_ATTR_LIFETIME, &lifetime);
+            break;
+        case STUN_METHOD_CREATEPERM:
+            stun_msg_attr_apply(message, permission_attribute_handler, allocation);
+            stun_reply(IPPROTO_UDP, server.socket, source, 0, message,
+                       server.key, sizeof(server.key), false, 0);
+            break;
+        case STUN_METHOD_CHANBIND:
+            attribute = stun_msg_attr(message, STUN_ATTR_CHANNEL_NUMBER);
+            peer_attribute = stun_msg_attr(message, STUN_ATTR_XOR_PEER_ADDR);
+            if (!attribute || !peer_attribute
+                    || (!allocation_channel_by_number(allocation, attribute->v.channel_number)
+                        && allocation->n_channels >= TURN_MAX_CHANNELS)) {
+                stun_ereply(IPPROTO_UDP, server.socket, source, 0, message, 400, "Bad Request",
+                            server.key, sizeof(server.key), false, 0);
+                return;
+            }
+            if (!allocation_channel_by_number(allocation, attribute->v.channel_number)) {
+                struct turn_channel* const channel =
+                        &allocation->channels[allocation->n_channels++];
+                channel->number = attribute->v.channel_number;
+                channel->peer = peer_attribute->v.xor_peer_addr;
+            }
+            allocation_add_permission(allocation, &peer_attribute->v.xor_peer_addr);
+            stun_reply(IPPROTO_UDP, server.socket, source, 0, message,
+                       server.key, sizeof(server.key), false, 0);
+            break;
+        default:
+            stun_ereply(IPPROTO_UDP, server.socket, source, 0, message, 400, "Bad Request",
+                        server.key, sizeof(server.key), false, 0);
+            break;
+    }
+}
+
+static void send_indication_handler(
+        struct turn_allocation* const allocation,
+        struct stun_msg* const message
+) {
+    struct stun_attr* const peer_attribute = stun_msg_attr(message, STUN_ATTR_XOR_PEER_ADDR);
+    struct stun_attr* const data_attribute = stun_msg_attr(message, STUN_ATTR_DATA);
+
+    // Permitted?
+    if (!allocation || !peer_attribute || !data_attribute
+            || !allocation_has_permission(allocation, &peer_attribute->v.xor_peer_addr)) {
+        return;
+    }
+
+    // Relay to peer
+    udp_send(allocation->relay_socket, &peer_attribute->v.xor_peer_addr,
+             &data_attribute->v.data);
+    ++server.n_relayed_to_peer;
+}
+
+static void channel_data_handler(
+        struct turn_allocation* const allocation,
+        struct mbuf* const buffer
+) {
+    uint16_t const number = ntohs(mbuf_read_u16(buffer));
+    uint16_t const length = ntohs(mbuf_read_u16(buffer));
+    struct turn_channel* const channel =
+            allocation ? allocation_channel_by_number(allocation, number) : NULL;
+
+    // Bound?
+    if (!channel || length > mbuf_get_left(buffer)) {
+        return;
+    }
+
+    // Relay to peer
+    buffer->end = buffer->pos + length;
+    udp_send(allocation->relay_socket, &channel->peer, buffer);
+    ++server.n_relayed_to_peer;
+    ++server.n_channel_data;
+}
+
+static void server_receive_handler(
+        struct sa const* source,
+        struct mbuf* buffer,
+        void* arg
+) {
+    struct stun_msg* message = NULL;
+    (void) arg;
+
+    // ChannelData (RFC 5766, section 11.4)
+    if (mbuf_get_left(buffer) >= TURN_CHANNEL_DATA_HEADER_SIZE
+            && (mbuf_buf(buffer)[0] & 0xc0) == 0x40) {
+        channel_data_handler(allocation_lookup(source), buffer);
+        return;
+    }
+
+    // STUN
+    if (stun_msg_decode(&message, buffer, NULL)) {
+        return;
+    }
+    switch (stun_msg_class(message)) {
+        case STUN_CLASS_REQUEST:
+            request_handler(source, message);
+            break;
+        case STUN_CLASS_INDICATION:
+            if (stun_msg_method(message) == STUN_METHOD_SEND) {
+                send_indication_handler(allocation_lookup(source), message);
+            }
+            break;
+        default:
+            break;
+    }
+    mem_deref(message);
+}
+
+static void server_start(void) {
+    struct sa address;
+
+    // Derive long-term credential key (RFC 5389, section 15.4)
+    EOR(md5_printf(server.key, "%s:%s:%s", turn_username, turn_realm, turn_password));
+
+    // Bind on loopback
+    list_init(&server.allocations);
+    EOR(sa_set_str(&address, "127.0.0.1", 0));
+    EOR(udp_listen(&server.socket, &address, server_receive_handler, NULL));
+    EOR(udp_local_get(server.socket, &server.address));
+    DEBUG_INFO("(TURN) Listening on %J\n", &server.address);
+}
+
+static void server_stop(void) {
+    list_flush(&server.allocations);
+    server.socket = mem_deref(server.socket);
+}
+
+/*
+ * Stop once both clients selected a candidate pair using a relay
+ * candidate, exchanged DTLS application data over it and the stand-in
+ * relayed ChannelData frames.
+ */
+static void check_done(
+        struct turn_client* const client
+) {
+    struct turn_client* const other = client->other_client;
+    if (!client->relay_candidate_gathered || !client->relay_pair_selected
+            || !client->dtls_connected || !client->data_received
+            || !other->relay_pair_selected
+            || !other->dtls_connected || !other->data_received
+            || server.n_relayed_to_peer == 0 || server.n_relayed_to_client == 0
+            || server.n_channel_data == 0) {
+        return;
+    }
+    DEBUG_INFO("(%s) Relay candidate carried data (%"PRIu64" packets to peers, "
+               "%"PRIu64" packets to clients, %"PRIu64" ChannelData frames)\n",
+               client->name, server.n_relayed_to_peer, server.n_relayed_to_client,
+               server.n_channel_data);
+    exit_code = 0;
+    re_cancel();
+}
+
+static void timeout_handler(
+        void* arg
+) {
+    (void) arg;
+    DEBUG_WARNING("Timeout: No data over a relay candidate pair (%"PRIu64" packets to peers, "
+                  "%"PRIu64" packets to clients, %"PRIu64" ChannelData frames)\n",
+                  server.n_relayed_to_peer, server.n_relayed_to_client, server.n_channel_data);
+    re_cancel();
+}
+
+static void ice_gatherer_local_candidate_handler(
+        struct rawrtc_ice_candidate* const candidate,
+        char const * const url, // read-only
+        void* const arg
+) {
+    struct turn_client* const client = arg;
+    enum rawrtc_ice_candidate_type type;
+
+    // Print local candidate
+    default_ice_gatherer_local_candidate_handler(candidate, url, arg);
+
+    // Relay candidate?
+    if (candidate) {
+        EOE(rawrtc_ice_candidate_get_type(&type, candidate));
+        if (type == RAWRTC_ICE_CANDIDATE_TYPE_RELAY) {
+            client->relay_candidate_gathered = true;
+        }
+    }
+
+    // Add to other client as remote candidate (relay only)
+    add_to_other_if_ice_candidate_type_enabled(
+            arg, candidate, client->other_client->ice_transport);
+}
+
+static void ice_transport_candidate_pair_change_handler(
+        struct rawrtc_ice_candidate* const local, // read-only
+        struct rawrtc_ice_candidate* const remote, // read-only
+        void* const arg
+) {
+    struct turn_client* const client = arg;
+    enum rawrtc_ice_candidate_type local_type;
+    enum rawrtc_ice_candidate_type remote_type;
+
+    // Print candidate pair
+    default_ice_transport_candidate_pair_change_handler(local, remote, arg);
+
+    // Using a relay candidate?
+    EOE(rawrtc_ice_candidate_get_type(&local_type, local));
+    EOE(rawrtc_ice_candidate_get_type(&remote_type, remote));
+    client->relay_pair_selected = local_type == RAWRTC_ICE_CANDIDATE_TYPE_RELAY
+            || remote_type == RAWRTC_ICE_CANDIDATE_TYPE_RELAY;
+    check_done(client);
+}
+
+static void dtls_transport_receive_handler(
+        struct mbuf* const buffer,
+        void* const arg
+) {
+    struct turn_client* const client = arg;
+    DEBUG_PRINTF("(%s) Received %zu bytes\n", client->name, mbuf_get_left(buffer));
+    client->data_received = true;
+    check_done(client);
+}
+
+static void dtls_transport_state_change_handler(
+        enum rawrtc_dtls_transport_state const state, // read-only
+        void* const arg
+) {
+    struct turn_client* const client = arg;
+    struct mbuf* buffer;
+
+    // Print state
+    default_dtls_transport_state_change_handler(state, arg);
+
+    // Connected? Send a message
+    if (state == RAWRTC_DTLS_TRANSPORT_STATE_CONNECTED) {
+        client->dtls_connected = true;
+        buffer = mbuf_alloc(64);
+        EOR(mbuf_printf(buffer, "Hello from %s!", client->name));
+        mbuf_set_pos(buffer, 0);
+        EOE(rawrtc_dtls_transport_send(client->dtls_transport, buffer));
+        mem_deref(buffer);
+        check_done(client);
+    }
+}
+
+static void client_init(
+        struct turn_client* const local
+) {
+    struct rawrtc_certificate* certificates[1];
+
+    // Generate certificates
+    EOE(rawrtc_certificate_generate(&local->certificate, NULL));
+    certificates[0] = local->certificate;
+
+    // Create ICE gatherer
+    EOE(rawrtc_ice_gatherer_create(
+            &local->gatherer, local->gather_options,
+            default_ice_gatherer_state_change_handler, default_ice_gatherer_error_handler,
+            ice_gatherer_local_candidate_handler, local));
+
+    // Create ICE transport
+    EOE(rawrtc_ice_transport_create(
+            &local->ice_transport, local->gatherer,
+            default_ice_transport_state_change_handler,
+            ice_transport_candidate_pair_change_handler, local));
+
+    // Create DTLS transport & receive application data
+    EOE(rawrtc_dtls_transport_create(
+            &local->dtls_transport, local->ice_transport, certificates, ARRAY_SIZE(certificates),
+            dtls_transport_state_change_handler, default_dtls_transport_error_handler, local));
+    EOE(rawrtc_dtls_transport_set_data_transport(
+            local->dtls_transport, dtls_transport_receive_handler, local));
+}
+
+static void client_start(
+        struct turn_client* const local,
+        struct turn_client* const remote
+) {
+    // Get & set ICE parameters
+    EOE(rawrtc_ice_gatherer_get_local_parameters(
+            &local->ice_parameters, remote->gatherer));
+
+    // Start gathering
+    EOE(rawrtc_ice_gatherer_gather(local->gatherer, NULL));
+
+    // Start ICE transport
+    EOE(rawrtc_ice_transport_start(
+            local->ice_transport, local->gatherer, local->ice_parameters, local->role));
+
+    // Get & set DTLS parameters
+    EOE(rawrtc_dtls_transport_get_local_parameters(
+            &local->dtls_parameters, remote->dtls_transport));
+
+    // Start DTLS transport
+    EOE(rawrtc_dtls_transport_start(
+            local->dtls_transport, local->dtls_parameters));
+}
+
+static void client_stop(
+        struct turn_client* const client
+) {
+    // Stop transports & close gatherer
+    EOE(rawrtc_dtls_transport_stop(client->dtls_transport));
+    EOE(rawrtc_ice_transport_stop(client->ice_transport));
+    EOE(rawrtc_ice_gatherer_close(client->gatherer));
+
+    // Un-reference & close
+    client->dtls_parameters = mem_deref(client->dtls_parameters);
+    client->ice_parameters = mem_deref(client->ice_parameters);
+    client->dtls_transport = mem_deref(client->dtls_transport);
+    client->ice_transport = mem_deref(client->ice_transport);
+    client->gatherer = mem_deref(client->gatherer);
+    client->certificate = mem_deref(client->certificate);
+}
+
+int main(int argc, char* argv[argc + 1]) {
+    // Note: Only relay candidates are exchanged, so data can only flow through the stand-in.
+    char* ice_candidate_types[] = {"relay"};
+    char url[64];
+    char* urls[] = {url};
+    struct rawrtc_ice_gather_options* gather_options;
+    struct turn_client a = {0};
+    struct turn_client b = {0};
+    (void) argc; (void) argv;
+
+    // Initialise
+    EOE(rawrtc_init());
+
+    // Debug
+    dbg_init(DBG_DEBUG, DBG_ALL);
+    DEBUG_PRINTF("Init\n");
+
+    // Start TURN server stand-in
+    server_start();
+    re_snprintf(url, sizeof(url), "turn:%j:%u?transport=udp",
+                &server.address, sa_port(&server.address));
+
+    // Create ICE gather options & add the stand-in as ICE server
+    EOE(rawrtc_ice_gather_options_create(&gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+    EOE(rawrtc_ice_gather_options_add_server(
+            gather_options, urls, ARRAY_SIZE(urls), turn_username, turn_password,
+            RAWRTC_ICE_CREDENTIAL_TYPE_PASSWORD));
+
+    // Setup client A
+    a.name = "A";
+    a.ice_candidate_types = ice_candidate_types;
+    a.n_ice_candidate_types = ARRAY_SIZE(ice_candidate_types);
+    a.gather_options = gather_options;
+    a.role = RAWRTC_ICE_ROLE_CONTROLLING;
+    a.other_client = &b;
+
+    // Setup client B
+    b.name = "B";
+    b.ice_candidate_types = ice_candidate_types;
+    b.n_ice_candidate_types = ARRAY_SIZE(ice_candidate_types);
+    b.gather_options = gather_options;
+    b.role = RAWRTC_ICE_ROLE_CONTROLLED;
+    b.other_client = &a;
+
+    // Initialise clients
+    client_init(&a);
+    client_init(&b);
+
+    // Start clients
+    client_start(&a, &b);
+    client_start(&b, &a);
+
+    // Start timeout & main loop
+    tmr_init(&timeout_timer);
+    tmr_start(&timeout_timer, TIMEOUT, timeout_handler, NULL);
+    EOR(re_main(default_signal_handler));
+    tmr_cancel(&timeout_timer);
+
+    // Stop clients
+    client_stop(&a);
+    client_stop(&b);
+
+    // Stop TURN server stand-in & free
+    server_stop();
+    mem_deref(gather_options);
+
+    // Bye
+    before_exit();
+    if (exit_code) {
+        DEBUG_WARNING("Relay candidate test failed\n");
+    }
+    return exit_code;
+}
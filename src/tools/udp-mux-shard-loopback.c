@@ -0,0 +1,420 @@
+#include <errno.h> // errno
+#include <netinet/in.h> // struct sockaddr_in, htons, ntohs
+#include <sys/socket.h> // socket, bind, getsockname
+#include <sys/wait.h> // waitpid, WIFEXITED, WEXITSTATUS
+#include <unistd.h> // fork, pipe, read, write, close
+#include <rawrtc.h>
+#include "../librawrtc/dtls_transport.h" /* TODO: Replace with <rawrtc_internal/dtls_transport.h> */
+#include "helper/utils.h"
+#include "helper/handler.h"
+
+#define DEBUG_MODULE "udp-mux-shard-loopback-app"
+#define DEBUG_LEVEL 7
+#include <re_dbg.h>
+
+enum {
+    N_SHARDS = 2,
+    PEER_SHARD = 1, // shard of the gatherer the peer connects to
+    TIMEOUT = 15000, // in milliseconds
+    WAIT_INTERVAL = 100, // in milliseconds
+};
+
+/*
+ * Two processes share a UDP mux port as shards. Shard 0 only binds its
+ * mux socket. Shard 1 runs a gatherer on the mux (A) and a peer on its
+ * own sockets (B). The test passes if A and B exchange DTLS application
+ * data through shard 1's mux socket, which requires that the peer's
+ * packets are steered to shard 1.
+ */
+
+// Note: Shadows struct client
+struct shard_client {
+    char* name;
+    char** ice_candidate_types;
+    size_t n_ice_candidate_types;
+    struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_ice_parameters* ice_parameters;
+    struct rawrtc_dtls_parameters* dtls_parameters;
+    enum rawrtc_ice_role role;
+    struct rawrtc_certificate* certificate;
+    struct rawrtc_ice_gatherer* gatherer;
+    struct rawrtc_ice_transport* ice_transport;
+    struct rawrtc_dtls_transport* dtls_transport;
+    struct shard_client* other_client;
+    uint16_t mux_port; // 0 if not using the mux
+    bool mux_pair_selected;
+    bool dtls_connected;
+    bool data_received;
+};
+
+static char* ice_candidate_types[] = {"host"};
+static struct tmr timer;
+static int write_fd = -1;
+static pid_t child = 0;
+static int exit_code = 1;
+
+/*
+ * Get a UDP port that is currently unused.
+ */
+static uint16_t get_unused_port(void) {
+    struct sockaddr_in address = {0};
+    socklen_t length = sizeof(address);
+    int fd;
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    EOP(fd);
+    address.sin_family = AF_INET;
+    EOP(bind(fd, (struct sockaddr*) &address, sizeof(address)));
+    EOP(getsockname(fd, (struct sockaddr*) &address, &length));
+    close(fd);
+    return ntohs(address.sin_port);
+}
+
+/*
+ * Stop once both clients are connected, have received data and the
+ * mux client's selected candidate pair uses the mux socket.
+ */
+static void check_done(
+        struct shard_client* const client
+) {
+    struct shard_client* const other = client->other_client;
+    struct shard_client* const mux_client = client->mux_port ? client : other;
+    if (!client->dtls_connected || !client->data_received
+            || !other->dtls_connected || !other->data_received
+            || !mux_client->mux_pair_selected) {
+        return;
+    }
+    DEBUG_INFO("(%s) Peer connected through shard %u of %u\n",
+               mux_client->name, PEER_SHARD, N_SHARDS);
+    exit_code = 0;
+    re_cancel();
+}
+
+static void timeout_handler(
+        void* arg
+) {
+    (void) arg;
+    DEBUG_WARNING("Timeout: Peer did not connect through the sharded UDP mux\n");
+    re_cancel();
+}
+
+static void ice_gatherer_local_candidate_handler(
+        struct rawrtc_ice_candidate* const candidate,
+        char const * const url, // read-only
+        void* const arg
+) {
+    struct shard_client* const client = arg;
+    enum rawrtc_ice_protocol protocol;
+
+    // Print local candidate
+    default_ice_gatherer_local_candidate_handler(candidate, url, arg);
+
+    // Add to other client as remote candidate (UDP host only, TCP does not use the mux)
+    if (candidate) {
+        EOE(rawrtc_ice_candidate_get_protocol(&protocol, candidate));
+        if (protocol != RAWRTC_ICE_PROTOCOL_UDP) {
+            return;
+        }
+    }
+    add_to_other_if_ice_candidate_type_enabled(
+            arg, candidate, client->other_client->ice_transport);
+}
+
+static void ice_transport_candidate_pair_change_handler(
+        struct rawrtc_ice_candidate* const local, // read-only
+        struct rawrtc_ice_candidate* const remote, // read-only
+        void* const arg
+) {
+    struct shard_client* const client = arg;
+    uint16_t port;
+
+    // Print candidate pair
+    default_ice_transport_candidate_pair_change_handler(local, remote, arg);
+
+    // Using the mux socket?
+    if (client->mux_port) {
+        EOE(rawrtc_ice_candidate_get_port(&port, local));
+        client->mux_pair_selected = port == client->mux_port;
+        check_done(client);
+    }
+}
+
+static void dtls_transport_receive_handler(
+        struct mbuf* const buffer,
+        void* const arg
+) {
+    struct shard_client* const client = arg;
+    DEBUG_PRINTF("(%s) Received %zu bytes\n", client->name, mbuf_get_left(buffer));
+    client->data_received = true;
+    check_done(client);
+}
+
+static void dtls_transport_state_change_handler(
+        enum rawrtc_dtls_transport_state const state, // read-only
+        void* const arg
+) {
+    struct shard_client* const client = arg;
+    struct mbuf* buffer;
+
+    // Print state
+    default_dtls_transport_state_change_handler(state, arg);
+
+    // Connected? Send a message
+    if (state == RAWRTC_DTLS_TRANSPORT_STATE_CONNECTED) {
+        client->dtls_connected = true;
+        buffer = mbuf_alloc(64);
+        EOR(mbuf_printf(buffer, "Hello from %s!", client->name));
+        mbuf_set_pos(buffer, 0);
+        EOE(rawrtc_dtls_transport_send(client->dtls_transport, buffer));
+        mem_deref(buffer);
+        check_done(client);
+    }
+}
+
+static void client_init(
+        struct shard_client* const local
+) {
+    struct rawrtc_certificate* certificates[1];
+
+    // Generate certificates
+    EOE(rawrtc_certificate_generate(&local->certificate, NULL));
+    certificates[0] = local->certificate;
+
+    // Create ICE gatherer
+    EOE(rawrtc_ice_gatherer_create(
+            &local->gatherer, local->gather_options,
+            default_ice_gatherer_state_change_handler, default_ice_gatherer_error_handler,
+            ice_gatherer_local_candidate_handler, local));
+
+    // Create ICE transport
+    EOE(rawrtc_ice_transport_create(
+            &local->ice_transport, local->gatherer,
+            default_ice_transport_state_change_handler,
+            ice_transport_candidate_pair_change_handler, local));
+
+    // Create DTLS transport & receive application data
+    EOE(rawrtc_dtls_transport_create(
+            &local->dtls_transport, local->ice_transport, certificates, ARRAY_SIZE(certificates),
+            dtls_transport_state_change_handler, default_dtls_transport_error_handler, local));
+    EOE(rawrtc_dtls_transport_set_data_transport(
+            local->dtls_transport, dtls_transport_receive_handler, local));
+}
+
+static void client_start(
+        struct shard_client* const local,
+        struct shard_client* const remote
+) {
+    // Get & set ICE parameters
+    EOE(rawrtc_ice_gatherer_get_local_parameters(
+            &local->ice_parameters, remote->gatherer));
+
+    // Start gathering
+    EOE(rawrtc_ice_gatherer_gather(local->gatherer, NULL));
+
+    // Start ICE transport
+    EOE(rawrtc_ice_transport_start(
+            local->ice_transport, local->gatherer, local->ice_parameters, local->role));
+
+    // Get & set DTLS parameters
+    EOE(rawrtc_dtls_transport_get_local_parameters(
+            &local->dtls_parameters, remote->dtls_transport));
+
+    // Start DTLS transport
+    EOE(rawrtc_dtls_transport_start(
+            local->dtls_transport, local->dtls_parameters));
+}
+
+static void client_stop(
+        struct shard_client* const client
+) {
+    // Stop transports & close gatherer
+    EOE(rawrtc_dtls_transport_stop(client->dtls_transport));
+    EOE(rawrtc_ice_transport_stop(client->ice_transport));
+    EOE(rawrtc_ice_gatherer_close(client->gatherer));
+
+    // Un-reference & close
+    client->dtls_parameters = mem_deref(client->dtls_parameters);
+    client->ice_parameters = mem_deref(client->ice_parameters);
+    client->dtls_transport = mem_deref(client->dtls_transport);
+    client->ice_transport = mem_deref(client->ice_transport);
+    client->gatherer = mem_deref(client->gatherer);
+    client->certificate = mem_deref(client->certificate);
+}
+
+/*
+ * Let the peer shard start once all mux sockets of this shard have been
+ * bound (shards must bind in the order of their index).
+ */
+static void idle_gatherer_state_change_handler(
+        enum rawrtc_ice_gatherer_state const state, // read-only
+        void* const arg
+) {
+    uint8_t const ready = 1;
+
+    // Print state
+    default_ice_gatherer_state_change_handler(state, arg);
+
+    // Gathered?
+    if (state == RAWRTC_ICE_GATHERER_COMPLETE && write_fd != -1) {
+        EOP(write(write_fd, &ready, sizeof(ready)));
+        close(write_fd);
+        write_fd = -1;
+    }
+}
+
+/*
+ * Wait for the peer shard's process to exit and take its exit code.
+ */
+static void wait_handler(
+        void* arg
+) {
+    int status;
+    pid_t pid;
+    (void) arg;
+
+    // Exited?
+    pid = waitpid(child, &status, WNOHANG);
+    if (pid == 0) {
+        tmr_start(&timer, WAIT_INTERVAL, wait_handler, NULL);
+        return;
+    }
+    exit_code = (pid == child && WIFEXITED(status)) ? WEXITSTATUS(status) : 1;
+    re_cancel();
+}
+
+/*
+ * Shard 0: Bind the mux socket with a gatherer nobody connects to.
+ */
+static void run_idle_shard(
+        uint16_t const port
+) {
+    struct rawrtc_ice_gather_options* gather_options;
+    struct rawrtc_ice_gatherer* gatherer;
+    struct client client = {
+        .name = "Shard 0",
+        .ice_candidate_types = ice_candidate_types,
+        .n_ice_candidate_types = ARRAY_SIZE(ice_candidate_types),
+    };
+
+    // Initialise
+    EOE(rawrtc_init());
+    dbg_init(DBG_DEBUG, DBG_ALL);
+
+    // Create ICE gather options (sharded mux)
+    EOE(rawrtc_ice_gather_options_create(&gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+    EOE(rawrtc_ice_gather_options_set_udp_mux_port(gather_options, port));
+    EOE(rawrtc_ice_gather_options_set_udp_mux_shards(gather_options, N_SHARDS, 0));
+
+    // Create ICE gatherer & gather
+    EOE(rawrtc_ice_gatherer_create(
+            &gatherer, gather_options,
+            idle_gatherer_state_change_handler, default_ice_gatherer_error_handler,
+            default_ice_gatherer_local_candidate_handler, &client));
+    EOE(rawrtc_ice_gatherer_gather(gatherer, NULL));
+
+    // Run until the peer shard exits
+    tmr_init(&timer);
+    tmr_start(&timer, WAIT_INTERVAL, wait_handler, NULL);
+    EOR(re_main(default_signal_handler));
+    tmr_cancel(&timer);
+
+    // Close & free
+    EOE(rawrtc_ice_gatherer_close(gatherer));
+    mem_deref(gatherer);
+    mem_deref(gather_options);
+    before_exit();
+}
+
+/*
+ * Shard 1: Connect a peer to a gatherer on the mux.
+ */
+static void run_peer_shard(
+        uint16_t const port
+) {
+    struct rawrtc_ice_gather_options* mux_gather_options;
+    struct rawrtc_ice_gather_options* gather_options;
+    struct shard_client a = {0};
+    struct shard_client b = {0};
+
+    // Initialise
+    EOE(rawrtc_init());
+    dbg_init(DBG_DEBUG, DBG_ALL);
+
+    // Create ICE gather options (sharded mux for A, own sockets for B)
+    EOE(rawrtc_ice_gather_options_create(&mux_gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+    EOE(rawrtc_ice_gather_options_set_udp_mux_port(mux_gather_options, port));
+    EOE(rawrtc_ice_gather_options_set_udp_mux_shards(mux_gather_options, N_SHARDS, PEER_SHARD));
+    EOE(rawrtc_ice_gather_options_create(&gather_options, RAWRTC_ICE_GATHER_POLICY_ALL));
+
+    // Setup client A
+    a.name = "A";
+    a.ice_candidate_types = ice_candidate_types;
+    a.n_ice_candidate_types = ARRAY_SIZE(ice_candidate_types);
+    a.gather_options = mux_gather_options;
+    a.role = RAWRTC_ICE_ROLE_CONTROLLED;
+    a.other_client = &b;
+    a.mux_port = port;
+
+    // Setup client B
+    b.name = "B";
+    b.ice_candidate_types = ice_candidate_types;
+    b.n_ice_candidate_types = ARRAY_SIZE(ice_candidate_types);
+    b.gather_options = gather_options;
+    b.role = RAWRTC_ICE_ROLE_CONTROLLING;
+    b.other_client = &a;
+
+    // Initialise & start clients
+    client_init(&a);
+    client_init(&b);
+    client_start(&a, &b);
+    client_start(&b, &a);
+
+    // Start timeout & main loop
+    tmr_init(&timer);
+    tmr_start(&timer, TIMEOUT, timeout_handler, NULL);
+    EOR(re_main(default_signal_handler));
+    tmr_cancel(&timer);
+
+    // Stop clients & free
+    client_stop(&a);
+    client_stop(&b);
+    mem_deref(gather_options);
+    mem_deref(mux_gather_options);
+    before_exit();
+}
+
+int main(int argc, char* argv[argc + 1]) {
+    int fds[2];
+    uint8_t ready;
+    uint16_t port;
+    (void) argc; (void) argv;
+
+    // Pick the shared port & fork the peer shard
+    port = get_unused_port();
+    EOP(pipe(fds));
+    child = fork();
+    EOP(child);
+
+    // Peer shard: Wait until shard 0 has bound its mux sockets
+    if (child == 0) {
+        close(fds[1]);
+        if (read(fds[0], &ready, sizeof(ready)) != sizeof(ready)) {
+            return 1;
+        }
+        close(fds[0]);
+        run_peer_shard(port);
+        if (exit_code) {
+            DEBUG_WARNING("UDP mux shard test failed\n");
+        }
+        return exit_code;
+    }
+
+    // Shard 0
+    close(fds[0]);
+    write_fd = fds[1];
+    run_idle_shard(port);
+    if (exit_code) {
+        DEBUG_WARNING("UDP mux shard test failed\n");
+    }
+    return exit_code;
+}